@@ -1,13 +1,22 @@
 #ifndef WORLDCUP2022_H
 #define WORLDCUP2022_H
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <list>
 #include <memory>
+#include <stop_token>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "worldcup.h"
+#include "worldcup_ledger.h"
 class TooManyDiceException : public std::exception {};
 
 class TooFewDiceException : public std::exception {};
@@ -32,21 +41,43 @@ class Dice {
 
     constexpr int size() const { return dice.size(); }
 
-    int roll() const {
+    // Rzuca wyjątek, jeśli liczba kostek nie pozwala na grę.
+    void validate() const {
         if (dice.size() < diceCount) {
             throw TooFewDiceException();
         }
         if (dice.size() > diceCount) {
             throw TooManyDiceException();
         }
+    }
+
+    int roll() const {
+        validate();
+        return rollUnchecked();
+    }
+
+    // Rzut bez sprawdzania liczby kostek - do użycia w pętli gry, gdy
+    // poprawność sprawdzono wcześniej.
+    int rollUnchecked() const {
         int sum = 0;
-        for (auto die : dice) {
+        for (auto const &die : dice) {
             sum += die->roll();
         }
         return sum;
     }
 };
 
+// Zmienna część stanu gracza (bez nazwy). Pozwala zapamiętać i odtworzyć
+// rozgrywkę, np. w narzędziach analizujących wiele wariantów gry.
+struct PlayerState {
+    unsigned int money;
+    unsigned int field;
+    unsigned int suspension;
+    bool bankrupted;
+
+    constexpr bool operator==(PlayerState const &) const = default;
+};
+
 class Player {
    private:
     std::string const name;
@@ -56,8 +87,33 @@ class Player {
     bool bankrupted;
 
    public:
+    static constexpr unsigned int startingMoney = 1000;
+
     constexpr Player(std::string const &name)
-        : name(name), money(1000), field(0), suspension(0), bankrupted(false) {}
+        : name(name),
+          money(startingMoney),
+          field(0),
+          suspension(0),
+          bankrupted(false) {}
+
+    constexpr Player(std::string const &name, PlayerState const &state)
+        : name(name),
+          money(state.money),
+          field(state.field),
+          suspension(state.suspension),
+          bankrupted(state.bankrupted) {}
+
+    constexpr PlayerState getState() const {
+        return {money, field, suspension, bankrupted};
+    }
+
+    // Przywraca zapamiętany stan bez tworzenia gracza od nowa.
+    constexpr void restore(PlayerState const &state) {
+        money = state.money;
+        field = state.field;
+        suspension = state.suspension;
+        bankrupted = state.bankrupted;
+    }
 
     constexpr bool bankrupt() const { return bankrupted; }
 
@@ -77,6 +133,9 @@ class Player {
 
     constexpr std::string getName() const { return name; }
 
+    // Nazwa bez kopiowania (np. do skrótów w pętli gry).
+    constexpr std::string_view getNameView() const { return name; }
+
     constexpr unsigned int getField() const { return field; }
 
     constexpr void waitIfNeeded() {
@@ -125,6 +184,15 @@ class BoardField {
 
     virtual constexpr void landOnField(Player *player) { (void)player; }
 
+    // Pola mogą mieć zmienny stan (np. pula pieniędzy meczu). Domyślnie
+    // pole jest bezstanowe.
+    virtual constexpr unsigned int getState() const { return 0; }
+
+    virtual constexpr void setState(unsigned int state) { (void)state; }
+
+    // Kopia pola razem z jego stanem (wzorzec prototypu).
+    virtual std::shared_ptr<BoardField> clone() const = 0;
+
     constexpr std::string getName() const { return name; }
 };
 
@@ -135,9 +203,24 @@ class Beginning : public BoardField {
    public:
     constexpr Beginning(std::string const &name) : BoardField(name), gift(50) {}
 
-    constexpr void passField(Player *player) override { player->take(gift); }
+    constexpr Beginning(std::string const &name, unsigned int gift)
+        : BoardField(name), gift(gift) {}
+
+    constexpr void passField(Player *player) override {
+        if (player->take(gift)) {
+            ledger::bankToPlayer(gift);
+        }
+    }
+
+    constexpr void landOnField(Player *player) override {
+        if (player->take(gift)) {
+            ledger::bankToPlayer(gift);
+        }
+    }
 
-    constexpr void landOnField(Player *player) override { player->take(gift); }
+    std::shared_ptr<BoardField> clone() const override {
+        return std::make_shared<Beginning>(*this);
+    }
 };
 
 class Goal : public BoardField {
@@ -148,7 +231,15 @@ class Goal : public BoardField {
     constexpr Goal(std::string const &name, unsigned int bonus)
         : BoardField(name), bonus(bonus) {}
 
-    constexpr void landOnField(Player *player) override { player->take(bonus); }
+    constexpr void landOnField(Player *player) override {
+        if (player->take(bonus)) {
+            ledger::bankToPlayer(bonus);
+        }
+    }
+
+    std::shared_ptr<BoardField> clone() const override {
+        return std::make_shared<Goal>(*this);
+    }
 };
 
 class Penalty : public BoardField {
@@ -159,7 +250,13 @@ class Penalty : public BoardField {
     constexpr Penalty(std::string const &name, unsigned int fee)
         : BoardField(name), fee(fee) {}
 
-    constexpr void landOnField(Player *player) override { player->pay(fee); }
+    constexpr void landOnField(Player *player) override {
+        ledger::playerToBank(player->pay(fee));
+    }
+
+    std::shared_ptr<BoardField> clone() const override {
+        return std::make_shared<Penalty>(*this);
+    }
 };
 
 class YellowCard : public BoardField {
@@ -173,6 +270,10 @@ class YellowCard : public BoardField {
     constexpr void landOnField(Player *player) override {
         player->suspend(suspension);
     }
+
+    std::shared_ptr<BoardField> clone() const override {
+        return std::make_shared<YellowCard>(*this);
+    }
 };
 
 class Bookmaker : public BoardField {
@@ -187,12 +288,22 @@ class Bookmaker : public BoardField {
 
     constexpr void landOnField(Player *player) override {
         if (players == 0) {
-            player->take(bet);
+            if (player->take(bet)) {
+                ledger::bankToPlayer(bet);
+            }
         } else {
-            player->pay(bet);
+            ledger::playerToBank(player->pay(bet));
         }
         players = (players + 1) % cycle;
     }
+
+    constexpr unsigned int getState() const override { return players; }
+
+    constexpr void setState(unsigned int state) override { players = state; }
+
+    std::shared_ptr<BoardField> clone() const override {
+        return std::make_shared<Bookmaker>(*this);
+    }
 };
 
 class Match : public BoardField {
@@ -207,65 +318,397 @@ class Match : public BoardField {
 
     // Przechodzenie przez pole bez zatrzymania
     constexpr void passField(Player *player) override {
-        howMuchMoney += player->pay(fee);
+        unsigned int paid = player->pay(fee);
+        howMuchMoney += paid;
+        ledger::playerToPot(paid);
     }
 
     // Zatrzymanie na polu
     constexpr void landOnField(Player *player) override {
-        if (player->take(howMuchMoney * weight)) howMuchMoney = 0;
+        int prize = howMuchMoney * weight;
+        if (player->take(prize)) {
+            ledger::matchPrize(howMuchMoney, prize);
+            howMuchMoney = 0;
+        }
+    }
+
+    constexpr unsigned int getState() const override { return howMuchMoney; }
+
+    constexpr void setState(unsigned int state) override {
+        howMuchMoney = state;
+    }
+
+    std::shared_ptr<BoardField> clone() const override {
+        return std::make_shared<Match>(*this);
     }
 };
 
 class EmptyField : public BoardField {
    public:
     constexpr EmptyField(std::string const &name) : BoardField(name) {}
+
+    std::shared_ptr<BoardField> clone() const override {
+        return std::make_shared<EmptyField>(*this);
+    }
+};
+
+enum class FieldType {
+    Beginning,
+    Goal,
+    Penalty,
+    YellowCard,
+    Bookmaker,
+    Match,
+    Empty
 };
 
-class Board {
+// Opis pola planszy: rodzaj, nazwa i parametry (kwota lub liczba rund
+// zawieszenia oraz waga meczu). Pozwala budować plansze o innym układzie
+// i zmieniać parametry pojedynczych pól bez pisania nowych klas.
+struct FieldSpec {
+    FieldType type;
+    std::string name;
+    unsigned int value;
+    double weight;
+};
+
+// Fabryka pól na podstawie opisu.
+inline std::shared_ptr<BoardField> makeField(FieldSpec const &spec) {
+    switch (spec.type) {
+        case FieldType::Beginning:
+            return std::make_shared<Beginning>(spec.name, spec.value);
+        case FieldType::Goal:
+            return std::make_shared<Goal>(spec.name, spec.value);
+        case FieldType::Penalty:
+            return std::make_shared<Penalty>(spec.name, spec.value);
+        case FieldType::YellowCard:
+            return std::make_shared<YellowCard>(spec.name, spec.value);
+        case FieldType::Bookmaker:
+            return std::make_shared<Bookmaker>(spec.name, spec.value);
+        case FieldType::Match:
+            return std::make_shared<Match>(spec.name, spec.value, spec.weight);
+        case FieldType::Empty:
+            break;
+    }
+    return std::make_shared<EmptyField>(spec.name);
+}
+
+// Przybliżony rozmiar pola utworzonego przez makeField: obiekt, blok
+// kontrolny shared_ptr (dwa liczniki) i nazwa, jeśli nie mieści się
+// w buforze wewnętrznym std::string.
+inline size_t fieldFootprint(FieldSpec const &spec) {
+    size_t object = sizeof(EmptyField);
+    switch (spec.type) {
+        case FieldType::Beginning:
+            object = sizeof(Beginning);
+            break;
+        case FieldType::Goal:
+            object = sizeof(Goal);
+            break;
+        case FieldType::Penalty:
+            object = sizeof(Penalty);
+            break;
+        case FieldType::YellowCard:
+            object = sizeof(YellowCard);
+            break;
+        case FieldType::Bookmaker:
+            object = sizeof(Bookmaker);
+            break;
+        case FieldType::Match:
+            object = sizeof(Match);
+            break;
+        case FieldType::Empty:
+            break;
+    }
+    size_t name = spec.name.size() > std::string().capacity()
+                      ? spec.name.size() + 1
+                      : 0;
+    return object + 2 * sizeof(long) + name;
+}
+
+// Układ planszy z treści zadania.
+inline std::vector<FieldSpec> defaultLayout() {
+    return {{FieldType::Beginning, "Początek sezonu", 50, 0.0},
+            {FieldType::Match, "Mecz z San Marino", 160, 1.0},
+            {FieldType::Empty, "Dzień wolny od treningu", 0, 0.0},
+            {FieldType::Match, "Mecz z Liechtensteinem", 220, 1.0},
+            {FieldType::YellowCard, "Żółta kartka", 3, 0.0},
+            {FieldType::Match, "Mecz z Meksykiem", 300, 2.5},
+            {FieldType::Match, "Mecz z Arabią Saudyjską", 280, 2.5},
+            {FieldType::Bookmaker, "Bukmacher", 100, 0.0},
+            {FieldType::Match, "Mecz z Argentyną", 250, 2.5},
+            {FieldType::Goal, "Gol", 120, 0.0},
+            {FieldType::Match, "Mecz z Francją", 400, 4.0},
+            {FieldType::Penalty, "Rzut karny", 180, 0.0}};
+}
+
+// Obserwator akcji pól. Plansza powiadamia go po każdym przejściu przez pole
+// i zatrzymaniu się na nim, przekazując stan konta gracza sprzed akcji.
+// Dzięki temu narzędzia mogą śledzić przebieg gry bez zmieniania pól.
+class FieldObserver {
+   public:
+    virtual ~FieldObserver() = default;
+
+    virtual void onFieldAction(unsigned int field, unsigned int moneyBefore,
+                               Player const &player) = 0;
+};
+
+// Obserwator tur. Gra powiadamia go po każdej turze gracza (po onTurn
+// tablicy wyników), przekazując sumę oczek (0, jeśli gracz pauzował).
+class TurnObserver {
+   public:
+    virtual ~TurnObserver() = default;
+
+    virtual void onTurnEnd(Player const &player, unsigned int roll) = 0;
+};
+
+// Stany kolejnych pól planszy.
+using BoardState = std::vector<unsigned int>;
+
+// Zużycie pamięci przez reprezentację planszy (bez obserwatora).
+struct MemoryReport {
+    size_t fields;
+    size_t bytes;
+
+    double bytesPerField() const {
+        return fields == 0 ? 0.0 : static_cast<double>(bytes) / fields;
+    }
+};
+
+// Interfejs planszy używany przez grę. Podstawową implementacją jest Board
+// z polimorficznymi polami; inne implementacje (np. dla bardzo dużych plansz)
+// mogą inaczej przechowywać pola, zachowując tę samą semantykę ruchu.
+class GameBoard {
+   public:
+    virtual ~GameBoard() = default;
+
+    // Przesuwa gracza o i pól, wykonując akcje mijanych pól i pola docelowego.
+    virtual void playerMove(Player *player, unsigned int i) = 0;
+
+    virtual std::string getFieldName(unsigned int i) const = 0;
+
+    virtual unsigned int size() const = 0;
+
+    virtual BoardState getState() const = 0;
+
+    virtual void setState(BoardState const &state) = 0;
+
+    // Obserwator nie jest własnością planszy; nullptr wyłącza powiadomienia.
+    virtual void setObserver(FieldObserver *fieldObserver) = 0;
+
+    virtual MemoryReport memoryUsage() const = 0;
+
+    // Niezależna kopia planszy razem z jej stanem (bez obserwatora).
+    virtual std::shared_ptr<GameBoard> clone() const = 0;
+};
+
+class Board : public GameBoard {
    private:
     std::vector<std::shared_ptr<BoardField>> fields;
+    FieldObserver *observer;
+    size_t fieldBytes;
+
+    void notify(unsigned int field, unsigned int moneyBefore,
+                Player const *player) const {
+        if (observer != nullptr) {
+            observer->onFieldAction(field, moneyBefore, *player);
+        }
+    }
 
    public:
-    Board() : fields() {
-        fields.push_back(std::make_shared<Beginning>("Początek sezonu"));
-        fields.push_back(
-            std::make_shared<Match>("Mecz z San Marino", 160, 1.0));
-        fields.push_back(
-            std::make_shared<EmptyField>("Dzień wolny od treningu"));
-        fields.push_back(
-            std::make_shared<Match>("Mecz z Liechtensteinem", 220, 1.0));
-        fields.push_back(std::make_shared<YellowCard>("Żółta kartka", 3));
-        fields.push_back(std::make_shared<Match>("Mecz z Meksykiem", 300, 2.5));
-        fields.push_back(
-            std::make_shared<Match>("Mecz z Arabią Saudyjską", 280, 2.5));
-        fields.push_back(std::make_shared<Bookmaker>("Bukmacher", 100));
-        fields.push_back(std::make_shared<Match>("Mecz z Argentyną", 250, 2.5));
-        fields.push_back(std::make_shared<Goal>("Gol", 120));
-        fields.push_back(std::make_shared<Match>("Mecz z Francją", 400, 4.0));
-        fields.push_back(std::make_shared<Penalty>("Rzut karny", 180));
-    }
-
-    void playerMove(Player *player, unsigned int i) const {
+    Board() : Board(defaultLayout()) {}
+
+    explicit Board(std::vector<FieldSpec> const &layout)
+        : fields(), observer(nullptr), fieldBytes(0) {
+        for (auto const &spec : layout) {
+            fields.push_back(makeField(spec));
+            fieldBytes += fieldFootprint(spec);
+        }
+    }
+
+    void setObserver(FieldObserver *fieldObserver) override {
+        observer = fieldObserver;
+    }
+
+    void playerMove(Player *player, unsigned int i) override {
         int currentField = player->getField();
         int nextField = (currentField + i) % fields.size();
         unsigned int counter = 0;
         while (counter + 1 < i) {
-            fields[(currentField + counter + 1) % fields.size()]->passField(
-                player);
+            unsigned int field = (currentField + counter + 1) % fields.size();
+            unsigned int moneyBefore = player->getMoney();
+            ledger::atField(field);
+            fields[field]->passField(player);
+            notify(field, moneyBefore, player);
             counter++;
         }
         player->move(nextField);
+        unsigned int moneyBefore = player->getMoney();
+        ledger::atField(nextField);
         fields[nextField]->landOnField(player);
+        notify(nextField, moneyBefore, player);
     }
 
-    std::string getFieldName(unsigned int i) const {
+    std::string getFieldName(unsigned int i) const override {
         return fields[i]->getName();
     }
+
+    unsigned int size() const override { return fields.size(); }
+
+    BoardState getState() const override {
+        BoardState state;
+        state.reserve(fields.size());
+        for (auto const &field : fields) {
+            state.push_back(field->getState());
+        }
+        return state;
+    }
+
+    void setState(BoardState const &state) override {
+        for (size_t i = 0; i < fields.size() && i < state.size(); i++) {
+            fields[i]->setState(state[i]);
+        }
+    }
+
+    std::shared_ptr<GameBoard> clone() const override {
+        auto copy = std::make_shared<Board>(*this);
+        for (auto &field : copy->fields) {
+            field = field->clone();
+        }
+        copy->observer = nullptr;
+        return copy;
+    }
+
+    MemoryReport memoryUsage() const override {
+        return {fields.size(),
+                sizeof(*this) +
+                    fields.capacity() * sizeof(std::shared_ptr<BoardField>) +
+                    fieldBytes};
+    }
+};
+
+// Stan całej rozgrywki: gracze pozostający w grze (w kolejności ruchów),
+// stan planszy i numer następnej rundy (niezerowy tylko w przerwanej grze).
+// Nie obejmuje kostek ani tablicy wyników.
+struct GameState {
+    std::vector<std::pair<std::string, PlayerState>> players;
+    BoardState board;
+    unsigned int round = 0;
+};
+
+// Warunek przerwania rozgrywki: żądanie zatrzymania lub upływ terminu.
+// Sprawdzany tylko na granicy rund, więc przerwana gra ma spójny stan.
+// Zegar jest droższy od odczytu flagi zatrzymania, więc odczytujemy go przed
+// pierwszą rundą, a potem na pierwszej granicy rund po co najmniej
+// clockTurns turach. Po upływie terminu gra rozgrywa więc co najwyżej
+// clockTurns + maxPlayers - 1 tur, niezależnie od liczby graczy.
+class PlayInterrupt {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr unsigned int clockTurns = 32;
+
+    PlayInterrupt(std::stop_token token, Clock::time_point deadline)
+        : token(std::move(token)),
+          deadline(deadline),
+          timed(deadline != Clock::time_point::max()) {}
+
+    // Wywoływane przed każdą rundą z liczbą graczy, którzy ją rozegrają.
+    bool requested(size_t players) const {
+        if (token.stop_requested()) {
+            return true;
+        }
+        if (!timed) {
+            return false;
+        }
+        if (turns >= clockTurns || !clockRead) {
+            if (Clock::now() >= deadline) {
+                return true;
+            }
+            clockRead = true;
+            turns = 0;
+        }
+        turns += players;
+        return false;
+    }
+
+   private:
+    std::stop_token token;
+    Clock::time_point deadline;
+    bool timed;
+    // Tury rozegrane (lub rozpoczęte) od ostatniego odczytu zegara.
+    mutable size_t turns = 0;
+    mutable bool clockRead = false;
+};
+
+// Skrót kroczący przebiegu gry: po każdej turze dołącza nazwę gracza, jego
+// stan (z którego wynika status), numer pola i stan konta. Dwie gry o tym
+// samym skrócie mają (z dokładnością do kolizji 64-bitowych) ten sam
+// przebieg, co pozwala porównywać wersje silnika bez zapisu pełnych
+// dzienników. Mieszanie nie zależy od biblioteki standardowej, więc skróty
+// są stałe między kompilacjami (na maszynach little-endian).
+class TrajectoryHash {
+   public:
+    void addTurn(Player const &player) {
+        std::string_view name = player.getNameView();
+        size_t i = 0;
+        for (; i + sizeof(std::uint64_t) <= name.size();
+             i += sizeof(std::uint64_t)) {
+            std::uint64_t chunk;
+            std::memcpy(&chunk, name.data() + i, sizeof(chunk));
+            mix(chunk);
+        }
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, name.data() + i, name.size() - i);
+        mix(tail ^ std::uint64_t{name.size()} << 56);
+        PlayerState state = player.getState();
+        mix(std::uint64_t{state.field} << 32 | state.money);
+        mix(std::uint64_t{state.suspension} << 1 | state.bankrupted);
+    }
+
+    std::uint64_t digest() const { return value; }
+
+   private:
+    std::uint64_t value = 0x243f6a8885a308d3u;
+
+    void mix(std::uint64_t word) {
+        value = (value ^ word) * 0x9e3779b97f4a7c15u;
+        value ^= value >> 29;
+    }
+};
+
+// Wynik (być może częściowej) rozgrywki: liczba rozegranych rund i to, czy
+// rozgrywkę przerwano. Po przerwaniu nie ma zwycięzcy (onWin nie jest
+// wywoływane), a kolejne play() kontynuuje grę od przerwanej rundy.
+struct PlayResult {
+    unsigned int rounds;
+    bool stopped;
 };
 
+class PreparedGame;
+
 class WorldCup2022 : public WorldCup {
    public:
-    WorldCup2022() : scoreboard(), dice(2), players(), board() {}
+    static constexpr size_t maxPlayers = 11;
+
+    WorldCup2022()
+        : scoreboard(), dice(2), players(), board(std::make_shared<Board>()) {}
+
+    // Gra na planszy o podanym układzie.
+    explicit WorldCup2022(std::vector<FieldSpec> const &layout)
+        : scoreboard(),
+          dice(2),
+          players(),
+          board(std::make_shared<Board>(layout)) {}
+
+    // Gra na dowolnej implementacji planszy (pusty wskaźnik oznacza planszę
+    // domyślną).
+    explicit WorldCup2022(std::shared_ptr<GameBoard> board)
+        : scoreboard(),
+          dice(2),
+          players(),
+          board(board != nullptr ? std::move(board)
+                                 : std::make_shared<Board>()) {}
 
     // destruktor
     ~WorldCup2022() {}
@@ -292,6 +735,32 @@ class WorldCup2022 : public WorldCup {
         }
     }
 
+    // Obserwator akcji pól planszy (np. do analiz); nullptr wyłącza.
+    void setFieldObserver(FieldObserver *observer) {
+        board->setObserver(observer);
+    }
+
+    // Obserwator tur (np. dziennik zapisu); nullptr wyłącza.
+    void setTurnObserver(TurnObserver *observer) { turnObserver = observer; }
+
+    GameState getState() const {
+        GameState state{{}, board->getState(), firstRound};
+        for (auto const &player : players) {
+            state.players.emplace_back(player->getName(), player->getState());
+        }
+        return state;
+    }
+
+    // Odtwarza wcześniej zapamiętany stan rozgrywki.
+    void setState(GameState const &state) {
+        firstRound = state.round;
+        players.clear();
+        for (auto const &[name, playerState] : state.players) {
+            players.push_back(std::make_shared<Player>(name, playerState));
+        }
+        board->setState(state.board);
+    }
+
     // Przeprowadza rozgrywkę co najwyżej podanej liczby rund (rozgrywka może
     // skończyć się wcześniej).
     // Jedna runda obejmuje po jednym ruchu każdego gracza.
@@ -305,33 +774,209 @@ class WorldCup2022 : public WorldCup {
     // Rzuca TooFewPlayersException, jeśli liczba graczy nie pozwala na
     // rozpoczęcie gry.
     // Wyjątki powinny dziedziczyć po std::exception.
+    //
+    // Wszystkie warunki są sprawdzane przed pierwszą rundą, więc wyjątek
+    // nigdy nie przerywa rozgrywki w połowie rundy.
     void play(unsigned int rounds) {
-        if (players.size() > 11) {
+        validate();
+        run(rounds, nullptr);
+    }
+
+    using Deadline = PlayInterrupt::Clock::time_point;
+
+    // Jak play(rounds), ale rozgrywka kończy się też (na granicy rund) po
+    // żądaniu zatrzymania lub po upływie terminu. Przerwana gra zachowuje
+    // stan; kolejne wywołanie play() kontynuuje ją, numerując rundy dalej.
+    PlayResult play(unsigned int rounds, std::stop_token token,
+                    Deadline deadline = Deadline::max()) {
+        validate();
+        PlayInterrupt interrupt(std::move(token), deadline);
+        return run(rounds, &interrupt);
+    }
+
+    // Rozgrywa co najwyżej rounds kolejnych rund jak po przerwaniu: zwycięzca
+    // jest ogłaszany (onWin) dopiero wtedy, gdy w grze zostanie jeden gracz.
+    // Pole stopped wyniku mówi, czy gra toczy się dalej. Wyjątki jak w play().
+    PlayResult step(unsigned int rounds) {
+        validate();
+        return run(rounds, nullptr, true);
+    }
+
+    // Numer następnej rundy (niezerowy tylko w przerwanej grze).
+    unsigned int getRound() const { return firstRound; }
+
+    // Rozgrywka w osobnym wątku. Wyjątki z play() są przekazywane przez
+    // future. Gra musi istnieć do zakończenia rozgrywki i w tym czasie nie
+    // wolno jej modyfikować.
+    std::future<PlayResult> playAsync(unsigned int rounds,
+                                      std::stop_token token = {},
+                                      Deadline deadline = Deadline::max()) {
+        return std::async(std::launch::async,
+                          [this, rounds, token = std::move(token), deadline] {
+                              return play(rounds, token, deadline);
+                          });
+    }
+
+    // Sprawdza poprawność gry i zamraża ją w obiekcie, który można
+    // rozgrywać wielokrotnie bez ponownych sprawdzeń (definicja poniżej).
+    PreparedGame prepare() const;
+
+    // Włącza liczenie skrótu przebiegu (TrajectoryHash) przez silnik.
+    // Skrót obejmuje grę od pierwszej rundy, także po wznowieniach
+    // przerwanej rozgrywki; getTrajectoryHash() zwraca go po play().
+    // Wyłączony kosztuje jedno sprawdzenie flagi na turę.
+    void hashTrajectory(bool enabled) { trajectoryEnabled = enabled; }
+
+    std::uint64_t getTrajectoryHash() const { return trajectory.digest(); }
+
+   private:
+    friend class PreparedGame;
+
+    std::shared_ptr<ScoreBoard> scoreboard;
+    Dice dice;
+    std::vector<std::shared_ptr<Player>> players;
+    std::shared_ptr<GameBoard> board;
+    // Numer pierwszej rundy kolejnego play() - różny od zera tylko po
+    // przerwanej rozgrywce.
+    unsigned int firstRound = 0;
+    TurnObserver *turnObserver = nullptr;
+    bool trajectoryEnabled = false;
+    TrajectoryHash trajectory;
+    [[no_unique_address]] ledger::Ledger moneyLedger;
+
+    void validate() const {
+        if (players.size() > maxPlayers) {
             throw TooManyPlayersException();
-            return;
         }
         if (players.size() < 2) {
             throw TooFewPlayersException();
-            return;
         }
+        dice.validate();
+    }
 
+    // Nowa gra (nie wznowienie) zaczyna skrót przebiegu od nowa.
+    void startTrajectory() {
+        if (firstRound == 0) {
+            trajectory = TrajectoryHash();
+        }
+    }
+
+    // Księga przepływów pieniędzy (tylko z -DWORLDCUP_LEDGER): salda
+    // otwarcia na początku play() lub step(), strona przelewów w każdej
+    // turze i sprawdzenie zasady zachowania na każdej granicy rund.
+    void openLedger() {
+#ifdef WORLDCUP_LEDGER
+        std::vector<std::int64_t> money;
+        std::vector<Player const *> seats;
+        for (auto const &player : players) {
+            seats.push_back(player.get());
+            money.push_back(player->getMoney());
+        }
+        moneyLedger.open(std::move(money), board->getState(),
+                         std::move(seats));
+#endif
+    }
+
+    void ledgerTurn(Player const *player) {
+#ifdef WORLDCUP_LEDGER
+        moneyLedger.beginTurn(moneyLedger.seatOf(player));
+#else
+        (void)player;
+#endif
+    }
+
+    // Gracze usunięci po bankructwie mają saldo 0.
+    void checkLedger(unsigned int round) {
+#ifdef WORLDCUP_LEDGER
+        std::vector<std::int64_t> money(moneyLedger.seatCount(), 0);
+        for (auto const &player : players) {
+            money[moneyLedger.seatOf(player.get())] = player->getMoney();
+        }
+        moneyLedger.check(round, money, board->getState());
+#else
+        (void)round;
+#endif
+    }
+
+    // Rozgrywka bez sprawdzania warunków - wywoływana po validate(). Przy
+    // untilWinner gra kończy się (finish()) tylko wtedy, gdy został jeden
+    // gracz, a po wyczerpaniu rund czeka na kolejne jak przerwana (step()).
+    PlayResult run(unsigned int rounds, PlayInterrupt const *interrupt,
+                   bool untilWinner = false) {
+        startTrajectory();
+        ledger::Ledger::Scope ledgerScope(moneyLedger);
+        openLedger();
+        PlayResult result = playRounds(rounds, interrupt);
+        checkLedger(firstRound + result.rounds);
+        if (untilWinner) {
+            result.stopped = players.size() > 1;
+        }
+        if (result.stopped) {
+            firstRound += result.rounds;
+        } else {
+            finish();
+        }
+        return result;
+    }
+
+    // Ogłasza zwycięzcę zakończonej gry.
+    void finish() {
+        firstRound = 0;
+
+        // Sprawdzenie kto wygrał w przypadku gdy po rozegraniu wszystkich rund
+        // został więcej niż jeden gracz
+        Player *winner = players[0].get();
+
+        for (auto player : players) {
+            if (player->getMoney() > winner->getMoney()) {
+                winner = player.get();
+            }
+        }
+
+        scoreboard->onWin(winner->getName());
+    }
+
+    // Jedno sprawdzenie wskaźnika na rundę, gdy nie ma warunku przerwania.
+    static bool interrupted(PlayInterrupt const *interrupt, size_t players) {
+        return interrupt != nullptr && interrupt->requested(players);
+    }
+
+    // Tura jednego gracza. Zwraca true, jeśli gracz zbankrutował.
+    bool playTurn(Player *player) {
+        ledgerTurn(player);
+        player->waitIfNeeded();
+        // Sprawdzenie czy gracz nie pauzuje
+        unsigned int diceResult = 0;
+        if (!player->waiting()) {
+            diceResult = dice.rollUnchecked();
+            board->playerMove(player, diceResult);
+        }
+        scoreboard->onTurn(player->getName(), player->getStatus(),
+                           board->getFieldName(player->getField()),
+                           player->getMoney());
+        if (trajectoryEnabled) {
+            trajectory.addTurn(*player);
+        }
+        if (turnObserver != nullptr) {
+            turnObserver->onTurnEnd(*player, diceResult);
+        }
+        return player->bankrupt();
+    }
+
+    // Pętla gry. Zbankrutowany gracz jest usuwany z players od razu, więc
+    // getState() wywołane przez obserwatorów w trakcie gry go nie zawiera.
+    PlayResult playRounds(unsigned int rounds,
+                          PlayInterrupt const *interrupt) {
         unsigned int roundNumber = 0;
 
         while (roundNumber < rounds && players.size() > 1) {
-            scoreboard->onRound(roundNumber);
-            //
+            if (interrupted(interrupt, players.size())) {
+                return {roundNumber, true};
+            }
+            checkLedger(firstRound + roundNumber);
+            scoreboard->onRound(firstRound + roundNumber);
             for (size_t i = 0; i < players.size();) {
-                Player *player = players[i].get();
-                player->waitIfNeeded();
-                // Sprawdzenie czy gracz nie pauzuje
-                if (!player->waiting()) {
-                    int diceResult = dice.roll();
-                    board.playerMove(player, diceResult);
-                }
-                scoreboard->onTurn(player->getName(), player->getStatus(),
-                                   board.getFieldName(player->getField()),
-                                   player->getMoney());
-                if (player->bankrupt()) {
+                if (playTurn(players[i].get())) {
                     players.erase(players.begin() + i);
                     // Jeśli pozostał tylko jeden gracz, następuje zakończenie
                     // gry
@@ -344,25 +989,58 @@ class WorldCup2022 : public WorldCup {
             }
             roundNumber++;
         }
+        return {roundNumber, false};
+    }
+};
 
-        // Sprawdzenie kto wygrał w przypadku gdy po rozegraniu wszystkich rund
-        // został więcej niż jeden gracz
-        Player *winner = players[0].get();
-
-        for (auto player : players) {
-            if (player->getMoney() > winner->getMoney()) {
-                winner = player.get();
-            }
+// Gra sprawdzona i zamrożona przez WorldCup2022::prepare(): liczba kostek
+// i graczy jest sprawdzana raz, a każde play() zaczyna od stanu z chwili
+// przygotowania, bez żadnych sprawdzeń i ścieżek wyjątków w pętli gry.
+// Plansza i gracze są kopiami niezależnymi od gry źródłowej; kostki
+// i tablica wyników są współdzielone.
+class PreparedGame {
+   public:
+    // Przywraca stan gry z chwili przygotowania: pola graczy i planszy są
+    // nadpisywane w miejscu, bez przydziałów pamięci (lista graczy gry
+    // mieści wszystkich, bo zbankrutowanych tylko z niej usuwamy).
+    void reset() {
+        for (size_t seat = 0; seat < seats.size(); seat++) {
+            seats[seat]->restore(initial.players[seat].second);
         }
+        game.players.assign(seats.begin(), seats.end());
+        game.board->setState(initial.board);
+        game.firstRound = initial.round;
+    }
 
-        scoreboard->onWin(winner->getName());
+    void play(unsigned int rounds) {
+        reset();
+        game.run(rounds, nullptr);
     }
 
+    GameState getState() const { return game.getState(); }
+
    private:
-    std::shared_ptr<ScoreBoard> scoreboard;
-    Dice dice;
-    std::vector<std::shared_ptr<Player>> players;
-    Board board;
+    friend class WorldCup2022;
+
+    WorldCup2022 game;
+    GameState const initial;
+    // Wszyscy gracze w kolejności ruchów, także zbankrutowani w ostatniej
+    // grze.
+    std::vector<std::shared_ptr<Player>> seats;
+
+    explicit PreparedGame(WorldCup2022 const &source)
+        : game(source), initial(source.getState()) {
+        game.board = source.board->clone();
+        // Własne obiekty graczy (kopia gry współdzieli je ze źródłem);
+        // kolejne reset() tylko je nadpisują.
+        game.setState(initial);
+        seats = game.players;
+    }
 };
 
+inline PreparedGame WorldCup2022::prepare() const {
+    validate();
+    return PreparedGame(*this);
+}
+
 #endif
\ No newline at end of file
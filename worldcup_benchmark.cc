@@ -0,0 +1,189 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stop_token>
+#include <string>
+
+#include "worldcup_hugeboard.h"
+#include "worldcup_profiler.h"
+#include "worldcup_simulation.h"
+
+// Benchmark: worldcup_benchmark [liczba gier] [liczba rund]
+//            [liczba pól dużej planszy]
+// Mierzy czas gry dla liczby graczy 2 - 11, koszt sprawdzania warunku
+// przerwania (zatrzymanie i odległy termin) i koszt profilowania
+// PlayProfiler przy domyślnym próbkowaniu (te same ziarna we wszystkich
+// wariantach).
+// Z trzecim argumentem mierzy też grę na HugeBoard o podanej liczbie pól
+// przy każdej polityce dużych stron: czas ruchu, chybienia TLB (jeśli
+// procesor udostępnia licznik) i błędy stron.
+namespace {
+    // Kostka o dużym zakresie, żeby ruchy rozrzucały graczy po planszy.
+    class LongDie : public Die {
+       private:
+        std::shared_ptr<std::mt19937_64> const engine;
+        unsigned short const faces;
+
+       public:
+        LongDie(std::shared_ptr<std::mt19937_64> engine, unsigned short faces)
+            : engine(std::move(engine)), faces(faces) {}
+
+        [[nodiscard]] unsigned short roll() const override {
+            return (*engine)() % faces + 1;
+        }
+    };
+
+    // Dokłada do skrótu stan końcowy gry (gracze, pola), liczbę rund
+    // i zwycięzcę, więc warianty muszą się zgadzać w każdej grze, a nie
+    // tylko w sumie.
+    void hashFinalState(std::uint64_t &hash, GameState const &state,
+                        OutcomeScoreBoard const &outcome) {
+        auto mix = [&](std::uint64_t value) {
+            hash = (hash ^ value) * 0x100000001b3ULL;
+        };
+        for (auto const &[name, player] : state.players) {
+            mix(player.money);
+            mix(player.field);
+            mix(player.suspension);
+            mix(player.bankrupted);
+        }
+        for (unsigned int field : state.board) {
+            mix(field);
+        }
+        mix(outcome.getRounds());
+        for (char c : outcome.getWinner()) {
+            mix(static_cast<unsigned char>(c));
+        }
+    }
+
+    void hugeBoardPages(size_t fields, unsigned int rounds) {
+        constexpr unsigned int players = 4;
+        std::cout << "\nHugeBoard " << fields << " fields\n"
+                  << "pages\tmove[ns]\tdTLB misses/move\tpage faults"
+                     "\thuge[MiB]\n";
+        for (auto [policy, name] :
+             {std::pair{hugepages::Policy::Off, "4k"},
+              std::pair{hugepages::Policy::Transparent, "thp"},
+              std::pair{hugepages::Policy::Explicit, "hugetlb"}}) {
+            hugepages::setPolicy(policy);
+            PerfCounter faults = PerfCounter::pageFaults();
+            PerfCounter tlb = PerfCounter::dtlbLoadMisses();
+            std::vector<FieldSpec> layout;
+            layout.reserve(fields);
+            layout.push_back({FieldType::Beginning, "Start", 0, 0.0});
+            for (size_t i = 1; i < fields; i++) {
+                layout.push_back(i % 97 == 0
+                                     ? FieldSpec{FieldType::Goal, "Gol", 1, 0.0}
+                                     : FieldSpec{FieldType::Match, "Mecz", 0,
+                                                 1.0});
+            }
+            // Liczymy błędy stron buforów planszy, nie tymczasowego układu.
+            faults.start();
+            auto board = std::make_shared<HugeBoard>(layout);
+            layout = {};
+            auto engine = std::make_shared<std::mt19937_64>(1);
+            WorldCup2022 worldCup(board);
+            worldCup.addDie(std::make_shared<LongDie>(engine, 65535));
+            worldCup.addDie(std::make_shared<LongDie>(engine, 65535));
+            for (unsigned int seat = 0; seat < players; seat++) {
+                worldCup.addPlayer(seatName(seat));
+            }
+            worldCup.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+            std::uint64_t huge =
+                hugepages::usage().transparentBytes.load() +
+                hugepages::usage().explicitBytes.load();
+
+            auto start = std::chrono::steady_clock::now();
+            tlb.start();
+            worldCup.play(rounds);
+            std::uint64_t misses = tlb.stop();
+            std::chrono::duration<double, std::nano> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::uint64_t faultCount = faults.stop();
+            double moves = static_cast<double>(rounds) * players;
+            std::cout << name << '\t' << elapsed.count() / moves << '\t';
+            if (tlb.available()) {
+                std::cout << misses / moves;
+            } else {
+                std::cout << "n/a";
+            }
+            std::cout << '\t' << faultCount << '\t' << (huge >> 20) << '\n';
+        }
+    }
+
+    enum class Variant { Plain, Interruptible, Profiled };
+
+    double secondsPerGame(unsigned int players, Variant variant,
+                          std::uint64_t games, unsigned int rounds,
+                          std::uint64_t &checksum) {
+        std::stop_source source;
+        auto deadline = WorldCup2022::Deadline::clock::now() +
+                        std::chrono::hours(24);
+        PlayProfiler profiler;
+        bool profiled = variant == Variant::Profiled;
+        auto start = std::chrono::steady_clock::now();
+        for (std::uint64_t seed = 0; seed < games; seed++) {
+            auto engine = std::make_shared<std::mt19937_64>(seed);
+            auto scoreboard = std::make_shared<OutcomeScoreBoard>();
+            WorldCup2022 worldCup;
+            for (int die = 0; die < 2; die++) {
+                std::shared_ptr<Die> random =
+                    std::make_shared<RandomDie>(engine);
+                worldCup.addDie(profiled ? profiler.wrap(random) : random);
+            }
+            for (unsigned int seat = 0; seat < players; seat++) {
+                worldCup.addPlayer(seatName(seat));
+            }
+            worldCup.setScoreBoard(profiled ? profiler.wrap(scoreboard)
+                                            : scoreboard);
+            if (variant == Variant::Interruptible) {
+                worldCup.play(rounds, source.get_token(), deadline);
+            } else if (profiled) {
+                profiler.play(worldCup, rounds);
+            } else {
+                worldCup.play(rounds);
+            }
+            hashFinalState(checksum, worldCup.getState(), *scoreboard);
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return elapsed.count() / games;
+    }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::uint64_t games = argc > 1 ? std::stoull(argv[1]) : 20000;
+    unsigned int rounds = argc > 2 ? std::stoul(argv[2]) : 1000;
+    size_t hugeFields = argc > 3 ? std::stoull(argv[3]) : 0;
+
+    std::cout << "players\tplain[us]\tinterruptible[us]\toverhead"
+                 "\tprofiled[us]\toverhead\n"
+              << std::fixed << std::setprecision(3);
+    for (unsigned int players = 2; players <= 11; players++) {
+        std::uint64_t plainChecksum = 0xcbf29ce484222325ULL;
+        std::uint64_t interruptibleChecksum = plainChecksum;
+        std::uint64_t profiledChecksum = plainChecksum;
+        double plain = secondsPerGame(players, Variant::Plain, games, rounds,
+                                      plainChecksum);
+        double interruptible =
+            secondsPerGame(players, Variant::Interruptible, games, rounds,
+                           interruptibleChecksum);
+        double profiled = secondsPerGame(players, Variant::Profiled, games,
+                                         rounds, profiledChecksum);
+        if (plainChecksum != interruptibleChecksum ||
+            plainChecksum != profiledChecksum) {
+            std::cerr << "variants disagree for " << players << " players\n";
+            return 1;
+        }
+        std::cout << players << '\t' << plain * 1e6 << '\t'
+                  << interruptible * 1e6 << '\t' << interruptible / plain
+                  << '\t' << profiled * 1e6 << '\t' << profiled / plain
+                  << '\n';
+    }
+    if (hugeFields > 0) {
+        hugeBoardPages(hugeFields, rounds);
+    }
+    return 0;
+}
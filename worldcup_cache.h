@@ -0,0 +1,203 @@
+#ifndef WORLDCUP_CACHE_H
+#define WORLDCUP_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "worldcup_simulation.h"
+
+// Dyskowa pamięć podręczna wyników symulacji adresowana treścią.
+//
+// Kluczem jest skrót kanonicznego opisu konfiguracji (wersja silnika, układ
+// planszy, liczba graczy i rund) - bez zakresu ziaren. Plik o nazwie
+// skrótu przechowuje zagregowane wyniki dla zakresów ziaren, które już
+// policzono. Zapytanie o dowolny zakres składa wynik z zapisanych zakresów,
+// które się w nim mieszczą, a liczy tylko brakujące luki (i je zapisuje).
+// Luki zapisujemy w kawałkach wyrównanych do blockSize ziaren, żeby
+// zakresy częściowo pokrywające się z wcześniejszymi mogły je wykorzystać.
+// Wykorzystanie ma jednak ziarnistość kawałka: zapis jest sumą po całym
+// kawałku, więc część zapytania pokrywająca tylko fragment zapisanego
+// kawałka (na brzegach zakresu) jest liczona od nowa.
+//
+// Wiersze pliku, które nie są spójnym wynikiem (urwane lub uszkodzone:
+// liczba gier różna od liczby ziaren, liczba zwycięstw różna od liczby
+// graczy lub ich suma różna od liczby gier), są pomijane.
+class SimulationCache {
+   public:
+    struct Statistics {
+        std::uint64_t cachedGames = 0;
+        std::uint64_t computedGames = 0;
+    };
+
+   private:
+    struct Entry {
+        std::uint64_t firstSeed;
+        std::uint64_t lastSeed;
+        SimulationAggregate aggregate;
+    };
+
+    std::filesystem::path directory;
+    unsigned int threads;
+    std::uint64_t blockSize;
+    Statistics statistics;
+
+    std::filesystem::path pathFor(std::string const &key) const {
+        return directory / (key + ".cache");
+    }
+
+    std::vector<Entry> load(std::string const &canonical,
+                            std::string const &key,
+                            unsigned int players) const {
+        std::vector<Entry> entries;
+        std::ifstream in(pathFor(key));
+        std::string line;
+        // Pierwszy wiersz to pełny opis konfiguracji - chroni przed kolizją
+        // skrótów.
+        if (!std::getline(in, line) || line != canonical) {
+            return entries;
+        }
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            Entry entry{0, 0, {}};
+            fields >> entry.firstSeed >> entry.lastSeed >>
+                entry.aggregate.games >> entry.aggregate.totalRounds;
+            std::uint64_t wins;
+            std::uint64_t total = 0;
+            while (fields >> wins) {
+                entry.aggregate.wins.push_back(wins);
+                total += wins;
+            }
+            if (fields.eof() && entry.firstSeed < entry.lastSeed &&
+                entry.aggregate.games == entry.lastSeed - entry.firstSeed &&
+                entry.aggregate.wins.size() == players &&
+                total == entry.aggregate.games) {
+                entries.push_back(std::move(entry));
+            }
+        }
+        return entries;
+    }
+
+    void store(std::string const &canonical, std::string const &key,
+               Entry const &entry) const {
+        std::filesystem::create_directories(directory);
+        bool fresh = !std::filesystem::exists(pathFor(key));
+        std::ofstream out(pathFor(key), std::ios::app);
+        if (fresh) {
+            out << canonical << '\n';
+        }
+        out << entry.firstSeed << ' ' << entry.lastSeed << ' '
+            << entry.aggregate.games << ' ' << entry.aggregate.totalRounds;
+        for (auto wins : entry.aggregate.wins) {
+            out << ' ' << wins;
+        }
+        out << '\n';
+    }
+
+    SimulationAggregate compute(SimulationConfig config,
+                                std::uint64_t firstSeed,
+                                std::uint64_t lastSeed,
+                                std::string const &canonical,
+                                std::string const &key) {
+        SimulationAggregate result;
+        result.wins.assign(config.players, 0);
+        while (firstSeed < lastSeed) {
+            config.firstSeed = firstSeed;
+            config.lastSeed =
+                std::min(lastSeed, (firstSeed / blockSize + 1) * blockSize);
+            SimulationAggregate aggregate = runSimulation(config, threads);
+            statistics.computedGames += aggregate.games;
+            store(canonical, key,
+                  {config.firstSeed, config.lastSeed, aggregate});
+            result.merge(aggregate);
+            firstSeed = config.lastSeed;
+        }
+        return result;
+    }
+
+   public:
+    SimulationCache(std::filesystem::path directory, unsigned int threads,
+                    std::uint64_t blockSize = 4096)
+        : directory(std::move(directory)),
+          threads(threads),
+          blockSize(std::max<std::uint64_t>(1, blockSize)),
+          statistics() {}
+
+    // Kanoniczny opis konfiguracji bez zakresu ziaren. Wagi zapisujemy
+    // szesnastkowo, żeby opis był dokładny.
+    static std::string canonicalDescription(SimulationConfig const &config) {
+        std::ostringstream out;
+        out << "engine=" << engineVersion << ";players=" << config.players
+            << ";rounds=" << config.rounds << ";dice=2;fields=";
+        for (auto const &field : config.layout) {
+            out << static_cast<int>(field.type) << ','
+                << std::quoted(field.name) << ',' << field.value << ','
+                << std::hexfloat << field.weight << std::defaultfloat << ';';
+        }
+        return out.str();
+    }
+
+    // 64-bitowy skrót FNV-1a opisu zapisany szesnastkowo.
+    static std::string key(std::string const &canonical) {
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char c : canonical) {
+            hash = (hash ^ c) * 0x100000001b3ULL;
+        }
+        std::ostringstream out;
+        out << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return out.str();
+    }
+
+    SimulationAggregate run(SimulationConfig const &config) {
+        std::string canonical = canonicalDescription(config);
+        std::string hash = key(canonical);
+        std::vector<Entry> entries = load(canonical, hash, config.players);
+        std::sort(entries.begin(), entries.end(),
+                  [](Entry const &a, Entry const &b) {
+                      return a.firstSeed < b.firstSeed ||
+                             (a.firstSeed == b.firstSeed &&
+                              a.lastSeed > b.lastSeed);
+                  });
+
+        SimulationAggregate result;
+        result.wins.assign(config.players, 0);
+        std::uint64_t cursor = config.firstSeed;
+        while (cursor < config.lastSeed) {
+            // Najdłuższy zapisany zakres zaczynający się w cursor (lista jest
+            // posortowana malejąco po końcu dla równych początków) albo
+            // najbliższy zakres zaczynający się dalej.
+            Entry const *usable = nullptr;
+            std::uint64_t nextStart = config.lastSeed;
+            for (auto const &entry : entries) {
+                if (entry.firstSeed < cursor ||
+                    entry.lastSeed > config.lastSeed) {
+                    continue;
+                }
+                if (entry.firstSeed == cursor) {
+                    usable = &entry;
+                    break;
+                }
+                nextStart = std::min(nextStart, entry.firstSeed);
+            }
+            if (usable != nullptr) {
+                result.merge(usable->aggregate);
+                statistics.cachedGames += usable->aggregate.games;
+                cursor = usable->lastSeed;
+            } else {
+                result.merge(
+                    compute(config, cursor, nextStart, canonical, hash));
+                cursor = nextStart;
+            }
+        }
+        return result;
+    }
+
+    Statistics const &getStatistics() const { return statistics; }
+};
+
+#endif
@@ -0,0 +1,23 @@
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "worldcup_cashflow.h"
+
+// Narzędzie: worldcup_cashflow [liczba gier] [liczba graczy] [liczba rund]
+//            [liczba wątków]
+// Wypisuje macierz średnich przepływów pieniędzy na grę: wiersz na pole
+// planszy domyślnej, kolumna na miejsce gracza w kolejności ruchów.
+int main(int argc, char *argv[]) {
+    std::uint64_t games = argc > 1 ? std::stoull(argv[1]) : 100000;
+    unsigned int players = argc > 2 ? std::stoul(argv[2]) : 4;
+    unsigned int rounds = argc > 3 ? std::stoul(argv[3]) : 100;
+    unsigned int threads =
+        argc > 4 ? std::stoul(argv[4]) : std::thread::hardware_concurrency();
+
+    SimulationConfig config{defaultLayout(), players, rounds, 0, games};
+    CashFlow flow(players, config.layout.size());
+    runSimulation(config, threads, flow);
+    flow.report(std::cout, config.layout);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#ifndef WORLDCUP_CASHFLOW_H
+#define WORLDCUP_CASHFLOW_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "worldcup_simulation.h"
+
+// Przepływy pieniędzy w rozbiciu na gracza (miejsce w kolejności ruchów)
+// i pole: ile każde pole dało graczowi, a ile mu zabrało. Osobno saldo
+// zmian konta, których nie da się przypisać polu (np. opłaty za przejście
+// na HugeBoard). Sumy z wielu gier (także liczonych równolegle) łączy się
+// dodawaniem.
+class CashFlow {
+   private:
+    size_t seats;
+    size_t fields;
+    std::uint64_t games;
+    // [seat * fields + field]
+    std::vector<std::uint64_t> gains;
+    std::vector<std::uint64_t> losses;
+    // [seat]
+    std::vector<std::int64_t> unassigned;
+
+   public:
+    CashFlow(size_t seats, size_t fields)
+        : seats(seats),
+          fields(fields),
+          games(0),
+          gains(seats * fields, 0),
+          losses(seats * fields, 0),
+          unassigned(seats, 0) {}
+
+    size_t getSeats() const { return seats; }
+
+    size_t getFields() const { return fields; }
+
+    std::uint64_t getGames() const { return games; }
+
+    void addGame() { games++; }
+
+    void add(size_t seat, size_t field, std::int64_t delta) {
+        size_t cell = seat * fields + field;
+        if (delta >= 0) {
+            gains[cell] += delta;
+        } else {
+            losses[cell] -= delta;
+        }
+    }
+
+    void addUnattributed(size_t seat, std::int64_t delta) {
+        unassigned[seat] += delta;
+    }
+
+    std::uint64_t gained(size_t seat, size_t field) const {
+        return gains[seat * fields + field];
+    }
+
+    std::uint64_t lost(size_t seat, size_t field) const {
+        return losses[seat * fields + field];
+    }
+
+    std::int64_t net(size_t seat, size_t field) const {
+        return static_cast<std::int64_t>(gained(seat, field)) -
+               static_cast<std::int64_t>(lost(seat, field));
+    }
+
+    // Saldo zmian konta gracza poza powiadomionymi akcjami pól.
+    std::int64_t unattributed(size_t seat) const { return unassigned[seat]; }
+
+    void merge(CashFlow const &other) {
+        games += other.games;
+        for (size_t cell = 0; cell < gains.size(); cell++) {
+            gains[cell] += other.gains[cell];
+            losses[cell] += other.losses[cell];
+        }
+        for (size_t seat = 0; seat < seats; seat++) {
+            unassigned[seat] += other.unassigned[seat];
+        }
+    }
+
+    // Macierz średnich na grę (TSV): wiersz na pole, kolumna na miejsce
+    // (saldo pola dla gracza) oraz łączne wpływy i wydatki wszystkich
+    // graczy na tym polu. Jeśli część zmian kont nie została przypisana
+    // polom (HugeBoard nie powiadamia o przejściach), ostatni wiersz
+    // "(unattributed)" podaje ich saldo - wiersze pól nie obejmują wtedy
+    // opłat za przejście.
+    void report(std::ostream &out,
+                std::vector<FieldSpec> const &layout) const {
+        double const perGame = games == 0 ? 0.0 : 1.0 / games;
+        out << "field";
+        for (size_t seat = 0; seat < seats; seat++) {
+            out << '\t' << seatName(seat);
+        }
+        out << "\tgained\tlost\n" << std::fixed << std::setprecision(2);
+        for (size_t field = 0; field < fields; field++) {
+            out << (field < layout.size() ? layout[field].name
+                                          : std::to_string(field));
+            std::uint64_t gainedTotal = 0;
+            std::uint64_t lostTotal = 0;
+            for (size_t seat = 0; seat < seats; seat++) {
+                out << '\t' << net(seat, field) * perGame;
+                gainedTotal += gained(seat, field);
+                lostTotal += lost(seat, field);
+            }
+            out << '\t' << gainedTotal * perGame << '\t'
+                << lostTotal * perGame << '\n';
+        }
+        if (std::any_of(unassigned.begin(), unassigned.end(),
+                        [](std::int64_t value) { return value != 0; })) {
+            out << "(unattributed)";
+            for (size_t seat = 0; seat < seats; seat++) {
+                out << '\t' << unassigned[seat] * perGame;
+            }
+            out << "\t\t\n";
+        }
+        out << std::defaultfloat;
+    }
+};
+
+// Obserwator pól przypisujący zmianę stanu konta po każdej akcji pola
+// graczowi i polu. Gracza rozpoznaje po adresie obiektu; nazwę (names[seat],
+// nazwy muszą być różne) porównuje tylko przy pierwszej akcji gracza
+// w grze. Zwykle kolejne akcje dotyczą tego samego gracza, więc najpierw
+// sprawdza poprzedniego. Akcja gracza, którego nie ma w names (albo
+// którego miejsce zajął już inny obiekt), rzuca std::invalid_argument
+// z onFieldAction, a więc i z rozgrywki.
+//
+// HugeBoard powiadamia tylko o zatrzymaniu na polu, więc opłaty i premie
+// za przejście nie trafiają do żadnego pola. Obserwator pamięta stan konta
+// każdego gracza po jego ostatniej akcji, a różnicę do stanu przed kolejną
+// akcją zapisuje jako nieprzypisaną (na Board jest zawsze zerowa).
+class CashFlowObserver : public FieldObserver {
+   private:
+    CashFlow &flow;
+    std::vector<std::string> names;
+    std::vector<Player const *> players;
+    std::vector<std::int64_t> balance;
+    size_t lastSeat;
+
+    size_t seatOf(Player const &player) {
+        if (lastSeat < players.size() && players[lastSeat] == &player) {
+            return lastSeat;
+        }
+        for (size_t seat = 0; seat < players.size(); seat++) {
+            if (players[seat] == &player) {
+                return lastSeat = seat;
+            }
+        }
+        for (size_t seat = 0; seat < names.size(); seat++) {
+            if (players[seat] == nullptr &&
+                names[seat] == player.getNameView()) {
+                players[seat] = &player;
+                return lastSeat = seat;
+            }
+        }
+        throw std::invalid_argument("cash flow: unknown player " +
+                                    std::string(player.getNameView()));
+    }
+
+   public:
+    CashFlowObserver(CashFlow &flow, std::vector<std::string> names)
+        : flow(flow), names(std::move(names)), lastSeat(0) {
+        beginGame();
+    }
+
+    // Przed każdą kolejną grą obserwowaną tym samym obiektem: gracze są
+    // nowymi obiektami (adresy mogą się powtórzyć) i zaczynają z money.
+    void beginGame(unsigned int money = Player::startingMoney) {
+        players.assign(names.size(), nullptr);
+        balance.assign(names.size(), money);
+        lastSeat = 0;
+    }
+
+    void onFieldAction(unsigned int field, unsigned int moneyBefore,
+                       Player const &player) override {
+        size_t seat = seatOf(player);
+        if (moneyBefore != balance[seat]) {
+            flow.addUnattributed(seat, moneyBefore - balance[seat]);
+        }
+        std::int64_t delta = static_cast<std::int64_t>(player.getMoney()) -
+                             static_cast<std::int64_t>(moneyBefore);
+        if (delta != 0) {
+            flow.add(seat, field, delta);
+        }
+        balance[seat] = player.getMoney();
+    }
+};
+
+// Seria symulacji jak runSimulation(config, threads), która dodatkowo
+// sumuje do flow przepływy pieniędzy wszystkich gier. Każdy wątek ma
+// własną macierz, łączoną na końcu.
+inline SimulationAggregate runSimulation(SimulationConfig const &config,
+                                         unsigned int threads,
+                                         CashFlow &flow) {
+    std::vector<std::string> names;
+    for (unsigned int seat = 0; seat < config.players; seat++) {
+        names.push_back(seatName(seat));
+    }
+    std::vector<CashFlow> local(std::max(1u, threads),
+                                CashFlow(flow.getSeats(), flow.getFields()));
+    std::vector<CashFlowObserver> observers;
+    for (auto &cashFlow : local) {
+        observers.emplace_back(cashFlow, names);
+    }
+    SimulationAggregate result =
+        runSimulation(config, threads, [&](unsigned int id) {
+            local[id].addGame();
+            observers[id].beginGame();
+            return &observers[id];
+        });
+    for (auto const &cashFlow : local) {
+        flow.merge(cashFlow);
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,592 @@
+#ifndef WORLDCUP_CODEC_H
+#define WORLDCUP_CODEC_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "worldcup_tracesink.h"
+
+// Kodek bloków rekordów tur (TurnRecord) do archiwizacji śladów.
+//
+// Blok jest kodowany kolumnami (game, turn, money, field, roll). W każdej
+// kolumnie wartość zastępuje różnica względem poprzedniej w kodzie zigzag
+// (małe różnice obu znaków dają małe liczby), a różnice są pakowane
+// bitowo w grupach po 128 z osobną szerokością dla każdej grupy. Na
+// spakowanych kolumnach działa szybki kompresor słownikowy (LZ77 w stylu
+// LZ4: sekwencje literałów i dopasowań z 16-bitowym przesunięciem); blok
+// zachowuje wynik LZ tylko wtedy, gdy jest krótszy.
+//
+// Bloki dekodują się niezależnie, więc plik skompresowanego śladu (patrz
+// compressTrace()) ma indeks bloków na końcu i pozwala czytać dowolny
+// blok bez dekodowania poprzednich.
+namespace codec {
+
+inline constexpr size_t groupSize = 128;
+
+constexpr std::uint32_t zigzag(std::int32_t value) {
+    return (static_cast<std::uint32_t>(value) << 1) ^
+           static_cast<std::uint32_t>(value >> 31);
+}
+
+constexpr std::int32_t unzigzag(std::uint32_t value) {
+    return static_cast<std::int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+// Uszkodzony lub ucięty blok.
+class CodecError : public std::runtime_error {
+   public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+    inline void putU32(std::string &out, std::uint32_t value) {
+        char bytes[4];
+        std::memcpy(bytes, &value, 4);
+        out.append(bytes, 4);
+    }
+
+    // Czytelnik danych bloku ze sprawdzaniem granic.
+    class Input {
+       private:
+        char const *position;
+        char const *end;
+
+       public:
+        explicit Input(std::string_view data)
+            : position(data.data()), end(data.data() + data.size()) {}
+
+        size_t left() const { return end - position; }
+
+        char const *take(size_t size) {
+            if (size > left()) {
+                throw CodecError("truncated block");
+            }
+            char const *result = position;
+            position += size;
+            return result;
+        }
+
+        std::uint8_t byte() { return *take(1); }
+
+        std::uint32_t u32() {
+            std::uint32_t value;
+            std::memcpy(&value, take(4), 4);
+            return value;
+        }
+
+        std::uint16_t u16() {
+            std::uint16_t value;
+            std::memcpy(&value, take(2), 2);
+            return value;
+        }
+    };
+
+    // Pakuje count wartości po width bitów (od najmłodszych bitów).
+    inline void pack(std::uint32_t const *values, size_t count,
+                     unsigned width, std::string &out) {
+        std::uint64_t buffer = 0;
+        unsigned bits = 0;
+        for (size_t i = 0; i < count; i++) {
+            buffer |= static_cast<std::uint64_t>(values[i]) << bits;
+            bits += width;
+            while (bits >= 8) {
+                out.push_back(static_cast<char>(buffer));
+                buffer >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0) {
+            out.push_back(static_cast<char>(buffer));
+        }
+    }
+
+    // Odwrotność pack() połączona z dekodowaniem różnic: count wartości
+    // o stałej szerokości trafia wprost do pola field kolejnych rekordów.
+    // Wartości są czytane 64-bitowymi odczytami od bajtu, w którym się
+    // zaczynają; size - bajty dostępne od data (także za grupą), przy końcu
+    // danych odczyt jest dopełniany zerami.
+    template <auto field, unsigned width>
+    void decodeGroup(char const *data, size_t size, size_t count,
+                     TurnRecord *records, std::uint32_t &previous) {
+        using Field = std::remove_reference_t<decltype(records->*field)>;
+        constexpr std::uint64_t mask = (std::uint64_t(1) << width) - 1;
+        std::uint32_t value = previous;
+        if constexpr (width == 0) {
+            for (size_t i = 0; i < count; i++) {
+                records[i].*field = static_cast<Field>(value);
+            }
+            return;
+        }
+        size_t bit = 0;
+        size_t i = 0;
+        if ((count * width + 7) / 8 + 8 <= size) {
+            for (; i < count; i++, bit += width) {
+                std::uint64_t word;
+                std::memcpy(&word, data + (bit >> 3), 8);
+                value += static_cast<std::uint32_t>(unzigzag(
+                    static_cast<std::uint32_t>((word >> (bit & 7)) & mask)));
+                records[i].*field = static_cast<Field>(value);
+            }
+        }
+        for (; i < count; i++, bit += width) {
+            size_t at = bit >> 3;
+            std::uint64_t word = 0;
+            std::memcpy(&word, data + at, std::min<size_t>(8, size - at));
+            value += static_cast<std::uint32_t>(unzigzag(
+                static_cast<std::uint32_t>((word >> (bit & 7)) & mask)));
+            records[i].*field = static_cast<Field>(value);
+        }
+        previous = value;
+    }
+
+    template <auto field, unsigned... widths>
+    void decodeGroup(char const *data, size_t size, size_t count,
+                     unsigned width, TurnRecord *records,
+                     std::uint32_t &previous,
+                     std::integer_sequence<unsigned, widths...>) {
+        using Decode = void (*)(char const *, size_t, size_t, TurnRecord *,
+                                std::uint32_t &);
+        static constexpr Decode table[] = {&decodeGroup<field, widths>...};
+        table[width](data, size, count, records, previous);
+    }
+
+    inline void encodeColumn(std::vector<std::uint32_t> &values,
+                             std::string &out) {
+        std::uint32_t previous = 0;
+        for (auto &value : values) {
+            std::uint32_t current = value;
+            value = zigzag(static_cast<std::int32_t>(current - previous));
+            previous = current;
+        }
+        for (size_t first = 0; first < values.size(); first += groupSize) {
+            size_t count = std::min(groupSize, values.size() - first);
+            std::uint32_t any = 0;
+            for (size_t i = 0; i < count; i++) {
+                any |= values[first + i];
+            }
+            unsigned width = std::bit_width(any);
+            out.push_back(static_cast<char>(width));
+            pack(values.data() + first, count, width, out);
+        }
+    }
+
+    // Dekoduje kolumnę i wpisuje ją do pola field rekordów.
+    template <auto field>
+    void decodeColumn(Input &in, std::vector<TurnRecord> &records) {
+        std::uint32_t previous = 0;
+        for (size_t first = 0; first < records.size(); first += groupSize) {
+            size_t count = std::min(groupSize, records.size() - first);
+            unsigned width = in.byte();
+            if (width > 32) {
+                throw CodecError("bad bit width");
+            }
+            size_t available = in.left();
+            char const *data = in.take((count * width + 7) / 8);
+            decodeGroup<field>(data, available, count, width,
+                               records.data() + first, previous,
+                               std::make_integer_sequence<unsigned, 33>());
+        }
+    }
+
+    inline void putLength(std::string &out, size_t length) {
+        for (; length >= 255; length -= 255) {
+            out.push_back(static_cast<char>(255));
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    // Największy rozmiar spakowanych kolumn count rekordów: w każdej
+    // z pięciu kolumn bajt szerokości na grupę i najwyżej 32 bity na
+    // wartość.
+    constexpr size_t packedBound(size_t count) {
+        return 5 * ((count + groupSize - 1) / groupSize + count * 4);
+    }
+
+    inline size_t getLength(Input &in, size_t length) {
+        if (length == 15) {
+            std::uint8_t more;
+            do {
+                more = in.byte();
+                length += more;
+            } while (more == 255);
+        }
+        return length;
+    }
+}  // namespace detail
+
+inline constexpr size_t minMatch = 4;
+
+// Kompresja słownikowa: sekwencje [znacznik: długość literałów (4 bity)
+// i dopasowania minus 4 (4 bity)] [dłuższe długości literałów] [literały]
+// [przesunięcie u16] [dłuższe długości dopasowania]; ostatnia sekwencja ma
+// same literały.
+inline std::string lzCompress(std::string_view in) {
+    constexpr unsigned hashBits = 12;
+    std::vector<std::uint32_t> table(size_t(1) << hashBits, 0);
+    auto load = [&in](size_t at) {
+        std::uint32_t value;
+        std::memcpy(&value, in.data() + at, 4);
+        return value;
+    };
+    auto hash = [](std::uint32_t value) {
+        return (value * 2654435761u) >> (32 - hashBits);
+    };
+    std::string out;
+    out.reserve(in.size() / 2 + 16);
+    size_t literal = 0;
+    auto emit = [&](size_t end, size_t offset, size_t match) {
+        size_t literals = end - literal;
+        size_t extra = match >= minMatch ? match - minMatch : 0;
+        out.push_back(static_cast<char>((std::min<size_t>(literals, 15) << 4) |
+                                        std::min<size_t>(extra, 15)));
+        if (literals >= 15) {
+            detail::putLength(out, literals - 15);
+        }
+        out.append(in.data() + literal, literals);
+        if (match >= minMatch) {
+            out.push_back(static_cast<char>(offset));
+            out.push_back(static_cast<char>(offset >> 8));
+            if (extra >= 15) {
+                detail::putLength(out, extra - 15);
+            }
+        }
+    };
+    size_t position = 0;
+    while (in.size() >= minMatch && position + minMatch <= in.size()) {
+        std::uint32_t value = load(position);
+        std::uint32_t &slot = table[hash(value)];
+        size_t candidate = slot;
+        slot = static_cast<std::uint32_t>(position + 1);
+        if (candidate == 0 || position + 1 - candidate > 65535 ||
+            load(candidate - 1) != value) {
+            position++;
+            continue;
+        }
+        candidate--;
+        size_t match = minMatch;
+        while (position + match < in.size() &&
+               in[candidate + match] == in[position + match]) {
+            match++;
+        }
+        emit(position, position - candidate, match);
+        position += match;
+        literal = position;
+    }
+    emit(in.size(), 0, 0);
+    return out;
+}
+
+// Odwrotność lzCompress() do out (bufor jest używany ponownie); size -
+// długość danych po dekompresji. Krótkie literały i dopasowania są
+// kopiowane stałymi porcjami po 16 bajtów (bufor ma zapas).
+inline void lzDecompress(std::string_view data, size_t size,
+                         std::string &out) {
+    // Bajt wejścia rozwija się w mniej niż 255 bajtów wyniku, więc
+    // niemożliwy rozmiar odrzucamy przed przydziałem bufora.
+    if (size / 255 > data.size()) {
+        throw CodecError("corrupted block");
+    }
+    constexpr size_t slack = 16;
+    out.resize(size + slack);
+    char *target = out.data();
+    size_t written = 0;
+    detail::Input in(data);
+    while (in.left() > 0) {
+        std::uint8_t token = in.byte();
+        size_t literals = detail::getLength(in, token >> 4);
+        if (literals > size - written) {
+            throw CodecError("corrupted block");
+        }
+        char const *source = in.take(literals);
+        if (literals <= slack && in.left() >= slack - literals) {
+            std::memcpy(target + written, source, slack);
+        } else {
+            std::memcpy(target + written, source, literals);
+        }
+        written += literals;
+        if (in.left() == 0) {
+            break;
+        }
+        size_t offset = in.u16();
+        size_t match = detail::getLength(in, token & 15) + minMatch;
+        if (offset == 0 || offset > written || match > size - written) {
+            throw CodecError("corrupted block");
+        }
+        char *to = target + written;
+        if (offset >= slack && match <= slack) {
+            std::memcpy(to, to - offset, slack);
+        } else {
+            // Dopasowanie zachodzące na siebie powtarza wzór o okresie
+            // offset; każde kopiowanie podwaja odtworzony fragment.
+            size_t period = offset;
+            for (size_t done = 0; done < match;) {
+                size_t chunk = std::min(period, match - done);
+                std::memcpy(to + done, to + done - period, chunk);
+                done += chunk;
+                period = (done + offset) / offset * offset;
+            }
+        }
+        written += match;
+    }
+    if (written != size) {
+        throw CodecError("corrupted block");
+    }
+    out.resize(size);
+}
+
+inline std::string lzDecompress(std::string_view data, size_t size) {
+    std::string out;
+    lzDecompress(data, size, out);
+    return out;
+}
+
+// Blok: liczba rekordów (u32), czy użyto LZ (u8), długość kolumn po
+// spakowaniu (u32), a po nich kolumny (po LZ, jeśli użyto).
+inline std::string encodeBlock(TurnRecord const *records, size_t count) {
+    std::string packed;
+    packed.reserve(count * 4);
+    std::vector<std::uint32_t> column(count);
+    auto addColumn = [&](auto TurnRecord::*field) {
+        for (size_t i = 0; i < count; i++) {
+            column[i] = records[i].*field;
+        }
+        detail::encodeColumn(column, packed);
+    };
+    addColumn(&TurnRecord::game);
+    addColumn(&TurnRecord::turn);
+    addColumn(&TurnRecord::money);
+    addColumn(&TurnRecord::field);
+    addColumn(&TurnRecord::roll);
+
+    std::string compressed = lzCompress(packed);
+    bool lz = compressed.size() < packed.size();
+    std::string out;
+    detail::putU32(out, static_cast<std::uint32_t>(count));
+    out.push_back(lz ? 1 : 0);
+    detail::putU32(out, static_cast<std::uint32_t>(packed.size()));
+    out += lz ? compressed : packed;
+    return out;
+}
+
+// Dekoduje blok do records (bufor jest używany ponownie). Rzuca CodecError
+// przy uszkodzonym bloku.
+inline void decodeBlock(std::string_view block,
+                        std::vector<TurnRecord> &records) {
+    detail::Input header(block);
+    std::uint32_t count = header.u32();
+    bool lz = header.byte() != 0;
+    std::uint32_t size = header.u32();
+    std::string_view body = block.substr(9);
+    // Kolumny count rekordów zajmują po spakowaniu co najwyżej
+    // packedBound(count) bajtów - sprawdzamy to przed przydziałem bufora.
+    if (size > detail::packedBound(count)) {
+        throw CodecError("corrupted block");
+    }
+    thread_local std::string unpacked;
+    if (lz) {
+        lzDecompress(body, size, unpacked);
+        body = unpacked;
+    } else if (body.size() != size) {
+        throw CodecError("corrupted block");
+    }
+    // Każda grupa zajmuje co najmniej bajt szerokości w każdej kolumnie.
+    if (count / groupSize * 5 > body.size()) {
+        throw CodecError("corrupted block");
+    }
+    records.resize(count);
+    detail::Input in(body);
+    detail::decodeColumn<&TurnRecord::game>(in, records);
+    detail::decodeColumn<&TurnRecord::turn>(in, records);
+    detail::decodeColumn<&TurnRecord::money>(in, records);
+    detail::decodeColumn<&TurnRecord::field>(in, records);
+    detail::decodeColumn<&TurnRecord::roll>(in, records);
+}
+
+inline std::vector<TurnRecord> decodeBlock(std::string_view block) {
+    std::vector<TurnRecord> records;
+    decodeBlock(block, records);
+    return records;
+}
+
+}  // namespace codec
+
+// Skompresowany ślad: bloki codec::encodeBlock() (po jednym na blok śladu
+// TraceSink), indeks bloków i stopka: położenie indeksu (u64), liczba
+// bloków (u64), rozmiar bloku pierwotnego śladu (u32) i znacznik "WCZ1".
+class CompressedTrace {
+   public:
+    struct IndexEntry {
+        std::uint64_t offset;
+        std::uint32_t size;
+        std::uint32_t records;
+        std::uint32_t writer;
+        std::uint32_t reserved;
+    };
+
+   private:
+    std::ifstream in;
+    std::vector<IndexEntry> index;
+    std::uint32_t blockSize;
+
+   public:
+    // Rzuca std::runtime_error, jeśli plik nie jest skompresowanym śladem.
+    explicit CompressedTrace(std::filesystem::path const &path)
+        : in(path, std::ios::binary), blockSize(0) {
+        struct {
+            std::uint64_t indexOffset;
+            std::uint64_t blocks;
+            std::uint32_t blockSize;
+            char magic[4];
+        } footer;
+        in.seekg(0, std::ios::end);
+        auto const fileSize = static_cast<std::uint64_t>(in.tellg());
+        if (!in || fileSize < sizeof(footer)) {
+            throw std::runtime_error("not a compressed trace");
+        }
+        in.seekg(-static_cast<std::streamoff>(sizeof(footer)), std::ios::end);
+        in.read(reinterpret_cast<char *>(&footer), sizeof(footer));
+        if (!in || std::memcmp(footer.magic, "WCZ1", 4) != 0) {
+            throw std::runtime_error("not a compressed trace");
+        }
+        // Indeks wypełnia dokładnie miejsce między blokami a stopką, a każdy
+        // blok leży przed indeksem i ma nie więcej rekordów, niż mieści blok
+        // śladu - inaczej plik jest uszkodzony (sprawdzamy przed
+        // przydziałami, których rozmiar pochodzi z pliku). Pusty ślad nie
+        // ma bloków ani rozmiaru bloku (0).
+        std::uint64_t const indexEnd = fileSize - sizeof(footer);
+        if (footer.indexOffset > indexEnd ||
+            (indexEnd - footer.indexOffset) % sizeof(IndexEntry) != 0 ||
+            (indexEnd - footer.indexOffset) / sizeof(IndexEntry) !=
+                footer.blocks ||
+            (footer.blocks > 0 &&
+             footer.blockSize <= sizeof(TraceBlockHeader))) {
+            throw std::runtime_error("corrupted compressed trace");
+        }
+        blockSize = footer.blockSize;
+        index.resize(footer.blocks);
+        in.seekg(footer.indexOffset);
+        in.read(reinterpret_cast<char *>(index.data()),
+                index.size() * sizeof(IndexEntry));
+        if (!in) {
+            throw std::runtime_error("truncated compressed trace");
+        }
+        std::uint32_t const maxRecords =
+            (blockSize - sizeof(TraceBlockHeader)) / sizeof(TurnRecord);
+        for (auto const &entry : index) {
+            if (entry.offset > footer.indexOffset ||
+                entry.size > footer.indexOffset - entry.offset ||
+                entry.records > maxRecords) {
+                throw std::runtime_error("corrupted compressed trace");
+            }
+        }
+    }
+
+    size_t blocks() const { return index.size(); }
+
+    IndexEntry const &entry(size_t block) const { return index[block]; }
+
+    // Rozmiar bloku śladu, z którego powstał plik (0 dla pustego śladu).
+    std::uint32_t traceBlockSize() const { return blockSize; }
+
+    // Zakodowany blok (do dekodowania np. na innym wątku).
+    std::string readEncoded(size_t block) {
+        std::string data(index[block].size, '\0');
+        in.seekg(index[block].offset);
+        in.read(data.data(), data.size());
+        if (!in) {
+            throw std::runtime_error("truncated compressed trace");
+        }
+        // Liczba rekordów w nagłówku bloku musi się zgadzać z indeksem
+        // (który ograniczyliśmy przy otwarciu).
+        std::uint32_t records = 0;
+        if (data.size() >= sizeof(records)) {
+            std::memcpy(&records, data.data(), sizeof(records));
+        }
+        if (data.size() < sizeof(records) || records != index[block].records) {
+            throw std::runtime_error("corrupted compressed trace");
+        }
+        return data;
+    }
+
+    std::vector<TurnRecord> readBlock(size_t block) {
+        return codec::decodeBlock(readEncoded(block));
+    }
+};
+
+// Kompresuje ślad TraceSink (input) do pliku output, porcjami bloków
+// kodowanych równolegle na threads wątkach. Zwraca rozmiar wyniku.
+inline std::uint64_t compressTrace(std::filesystem::path const &input,
+                                   std::filesystem::path const &output,
+                                   unsigned int threads) {
+    std::ofstream out(output, std::ios::binary);
+    std::vector<CompressedTrace::IndexEntry> index;
+    std::vector<std::string> payloads;
+    std::vector<std::uint32_t> writers;
+    std::vector<std::string> encoded;
+    std::uint64_t offset = 0;
+    std::uint32_t blockSize = 0;
+    size_t const chunk = std::max(1u, threads) * 16;
+
+    auto flush = [&] {
+        encoded.assign(payloads.size(), {});
+        parallelForSeeds(
+            0, payloads.size(), threads, [&](unsigned int, std::uint64_t i) {
+                std::vector<TurnRecord> records(payloads[i].size() /
+                                                sizeof(TurnRecord));
+                std::memcpy(records.data(), payloads[i].data(),
+                            records.size() * sizeof(TurnRecord));
+                encoded[i] = codec::encodeBlock(records.data(),
+                                                records.size());
+            });
+        for (size_t i = 0; i < payloads.size(); i++) {
+            auto records = static_cast<std::uint32_t>(payloads[i].size() /
+                                                      sizeof(TurnRecord));
+            index.push_back({offset,
+                             static_cast<std::uint32_t>(encoded[i].size()),
+                             records, writers[i], 0});
+            out.write(encoded[i].data(), encoded[i].size());
+            offset += encoded[i].size();
+        }
+        payloads.clear();
+        writers.clear();
+    };
+    std::ifstream in(input, std::ios::binary);
+    TraceBlockHeader header;
+    if (in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        blockSize = header.blockSize;
+    }
+    in.close();
+    readTraceBlocks(input, [&](std::uint32_t writer, std::string_view data) {
+        if (data.size() % sizeof(TurnRecord) != 0) {
+            throw std::runtime_error("trace block is not made of turns");
+        }
+        payloads.emplace_back(data);
+        writers.push_back(writer);
+        if (payloads.size() == chunk) {
+            flush();
+        }
+    });
+    flush();
+    out.write(reinterpret_cast<char const *>(index.data()),
+              index.size() * sizeof(CompressedTrace::IndexEntry));
+    std::uint64_t footer[2] = {offset, index.size()};
+    out.write(reinterpret_cast<char const *>(footer), sizeof(footer));
+    out.write(reinterpret_cast<char const *>(&blockSize), sizeof(blockSize));
+    out.write("WCZ1", 4);
+    if (!out) {
+        throw std::runtime_error("cannot write " + output.string());
+    }
+    return static_cast<std::uint64_t>(out.tellp());
+}
+
+#endif
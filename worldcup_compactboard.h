@@ -0,0 +1,251 @@
+#ifndef WORLDCUP_COMPACTBOARD_H
+#define WORLDCUP_COMPACTBOARD_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "worldcup2022.h"
+#include "worldcup_hugepages.h"
+
+// Zwarta reprezentacja pól dla plansz z milionami pól. Zamiast osobnego
+// obiektu na stercie dla każdego pola (z własną nazwą) trzymamy osobne,
+// ciągłe tablice: rodzaj pola, numer wagi, parametr (kwota lub liczba rund),
+// zmienny stan (pula meczu lub licznik bukmachera) i numer nazwy. Nazwy i
+// wagi są przechowywane raz, w słownikach. Daje to 14 bajtów na pole plus
+// koszt różnych nazw.
+//
+// Tablica implementuje też akcje pól z tą samą semantyką co klasy z
+// worldcup2022.h, żeby korzystające z niej plansze nie musiały jej powielać.
+class FieldTable {
+   private:
+    HugeVector<std::uint8_t> types;
+    HugeVector<std::uint8_t> weightIds;
+    HugeVector<std::uint32_t> values;
+    HugeVector<std::uint32_t> states;
+    HugeVector<std::uint32_t> nameIds;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, std::uint32_t> nameIndex;
+    std::vector<double> weights;
+
+    std::uint8_t weightId(double weight) {
+        for (size_t i = 0; i < weights.size(); i++) {
+            if (weights[i] == weight) {
+                return i;
+            }
+        }
+        if (weights.size() > UINT8_MAX) {
+            throw std::length_error("too many distinct match weights");
+        }
+        weights.push_back(weight);
+        return weights.size() - 1;
+    }
+
+   public:
+    FieldTable() = default;
+
+    explicit FieldTable(std::vector<FieldSpec> const &layout) {
+        reserve(layout.size());
+        for (auto const &spec : layout) {
+            add(spec);
+        }
+    }
+
+    void reserve(size_t count) {
+        types.reserve(count);
+        weightIds.reserve(count);
+        values.reserve(count);
+        states.reserve(count);
+        nameIds.reserve(count);
+    }
+
+    void add(FieldSpec const &spec) {
+        auto [entry, added] = nameIndex.try_emplace(spec.name, names.size());
+        if (added) {
+            names.push_back(spec.name);
+        }
+        types.push_back(static_cast<std::uint8_t>(spec.type));
+        weightIds.push_back(weightId(spec.weight));
+        values.push_back(spec.value);
+        states.push_back(0);
+        nameIds.push_back(entry->second);
+    }
+
+    size_t size() const { return types.size(); }
+
+    FieldType type(size_t i) const { return static_cast<FieldType>(types[i]); }
+
+    unsigned int value(size_t i) const { return values[i]; }
+
+    double weight(size_t i) const { return weights[weightIds[i]]; }
+
+    std::string const &name(size_t i) const { return names[nameIds[i]]; }
+
+    unsigned int state(size_t i) const { return states[i]; }
+
+    void setState(size_t i, unsigned int state) { states[i] = state; }
+
+    FieldSpec spec(size_t i) const {
+        return {type(i), name(i), value(i), weight(i)};
+    }
+
+    void passField(size_t i, Player *player) {
+        switch (type(i)) {
+            case FieldType::Beginning:
+                if (player->take(values[i])) {
+                    ledger::bankToPlayer(values[i]);
+                }
+                break;
+            case FieldType::Match: {
+                unsigned int paid = player->pay(values[i]);
+                states[i] += paid;
+                ledger::playerToPot(paid);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void landOnField(size_t i, Player *player) {
+        switch (type(i)) {
+            case FieldType::Beginning:
+            case FieldType::Goal:
+                if (player->take(values[i])) {
+                    ledger::bankToPlayer(values[i]);
+                }
+                break;
+            case FieldType::Penalty:
+                ledger::playerToBank(player->pay(values[i]));
+                break;
+            case FieldType::YellowCard:
+                player->suspend(values[i]);
+                break;
+            case FieldType::Bookmaker:
+                if (states[i] == 0) {
+                    if (player->take(values[i])) {
+                        ledger::bankToPlayer(values[i]);
+                    }
+                } else {
+                    ledger::playerToBank(player->pay(values[i]));
+                }
+                states[i] = (states[i] + 1) % 3;
+                break;
+            case FieldType::Match: {
+                int prize = states[i] * weight(i);
+                if (player->take(prize)) {
+                    ledger::matchPrize(states[i], prize);
+                    states[i] = 0;
+                }
+                break;
+            }
+            case FieldType::Empty:
+                break;
+        }
+    }
+
+    // Słownik nazw liczymy w przybliżeniu: węzeł mapy to klucz, wartość,
+    // wskaźnik i zapamiętany skrót.
+    MemoryReport memoryUsage() const {
+        size_t bytes = types.capacity() + weightIds.capacity() +
+                       sizeof(std::uint32_t) * (values.capacity() +
+                                                states.capacity() +
+                                                nameIds.capacity()) +
+                       weights.capacity() * sizeof(double);
+        for (auto const &name : names) {
+            size_t heap = name.size() > std::string().capacity()
+                              ? name.capacity() + 1
+                              : 0;
+            // Nazwa występuje w tablicy names i jako klucz słownika.
+            bytes += 2 * (sizeof(std::string) + heap) +
+                     sizeof(std::uint32_t) + 2 * sizeof(void *);
+        }
+        bytes += nameIndex.bucket_count() * sizeof(void *);
+        return {size(), bytes};
+    }
+};
+
+// Plansza o zwartej reprezentacji pól. Zachowuje się dokładnie jak Board
+// (ruch odwiedza kolejno mijane pola), ale zajmuje kilkanaście bajtów na
+// pole zamiast ponad stu.
+class CompactBoard : public GameBoard {
+   private:
+    FieldTable fields;
+    FieldObserver *observer;
+
+    void notify(unsigned int field, unsigned int moneyBefore,
+                Player const *player) const {
+        if (observer != nullptr) {
+            observer->onFieldAction(field, moneyBefore, *player);
+        }
+    }
+
+   public:
+    explicit CompactBoard(FieldTable table)
+        : fields(std::move(table)), observer(nullptr) {
+        if (fields.size() == 0) {
+            throw std::invalid_argument("empty board");
+        }
+    }
+
+    explicit CompactBoard(std::vector<FieldSpec> const &layout)
+        : CompactBoard(FieldTable(layout)) {}
+
+    void playerMove(Player *player, unsigned int i) override {
+        size_t const n = fields.size();
+        size_t currentField = player->getField();
+        for (unsigned int counter = 1; counter < i; counter++) {
+            unsigned int field = (currentField + counter) % n;
+            unsigned int moneyBefore = player->getMoney();
+            ledger::atField(field);
+            fields.passField(field, player);
+            notify(field, moneyBefore, player);
+        }
+        unsigned int nextField = (currentField + i) % n;
+        player->move(nextField);
+        unsigned int moneyBefore = player->getMoney();
+        ledger::atField(nextField);
+        fields.landOnField(nextField, player);
+        notify(nextField, moneyBefore, player);
+    }
+
+    std::string getFieldName(unsigned int i) const override {
+        return fields.name(i);
+    }
+
+    unsigned int size() const override { return fields.size(); }
+
+    BoardState getState() const override {
+        BoardState state(fields.size());
+        for (size_t i = 0; i < fields.size(); i++) {
+            state[i] = fields.state(i);
+        }
+        return state;
+    }
+
+    void setState(BoardState const &state) override {
+        for (size_t i = 0; i < fields.size() && i < state.size(); i++) {
+            fields.setState(i, state[i]);
+        }
+    }
+
+    void setObserver(FieldObserver *fieldObserver) override {
+        observer = fieldObserver;
+    }
+
+    std::shared_ptr<GameBoard> clone() const override {
+        auto copy = std::make_shared<CompactBoard>(*this);
+        copy->observer = nullptr;
+        return copy;
+    }
+
+    MemoryReport memoryUsage() const override {
+        MemoryReport report = fields.memoryUsage();
+        report.bytes += sizeof(*this);
+        return report;
+    }
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "worldcup_protocol.h"
+
+// Demon: worldcup_daemon [ścieżka gniazda] [katalog dziennika]
+//                       [odstęp zatwierdzania w us] [rozmiar dziennika
+//                       wyzwalający migawkę w bajtach] [aktywne gry]
+// Jednoprocesowa usługa prowadząca gry: przyjmuje żądania w protokole
+// z worldcup_protocol.h przez gniazdo uniksowe i obsługuje wszystkich
+// klientów w jednym wątku za pomocą epoll. Żądania z jednego połączenia są
+// obsługiwane w kolejności (można je wysyłać potokowo), a odpowiedzi
+// wysyłane w tej samej kolejności. Kończy się po SIGINT lub SIGTERM.
+//
+// Z katalogiem dziennika gry przetrwają awarię: przy starcie są odtwarzane
+// z migawki i dziennika, a odpowiedzi są wysyłane dopiero po grupowym
+// zatwierdzeniu dziennika (co najwyżej raz na podany odstęp; epoll odmierza
+// czas z dokładnością do milisekundy).
+//
+// Gry ponad limit aktywnych gier (domyślnie 4096) są przechowywane
+// w postaci spakowanej (zob. GameHost).
+namespace {
+    volatile std::sig_atomic_t stopping = 0;
+
+    void onSignal(int) { stopping = 1; }
+
+    struct Connection {
+        std::string input;
+        std::string output;
+        // Odpowiedzi czekające na zatwierdzenie dziennika.
+        std::string held;
+        bool writing = false;
+        // Klient zakończył wysyłanie (półzamknięcie lub zamknięcie);
+        // połączenie trwa do wysłania odpowiedzi na odebrane żądania.
+        bool closed = false;
+
+        std::uint32_t events() const {
+            std::uint32_t result = closed ? 0 : EPOLLIN | EPOLLRDHUP;
+            return writing ? result | EPOLLOUT : result;
+        }
+
+        bool finished() const {
+            return closed && held.empty() && output.empty();
+        }
+    };
+
+    bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    class Daemon {
+       private:
+        int listener;
+        int epoll;
+        GameJournal *journal;
+        std::uint64_t snapshotBytes;
+        GameHost host;
+        std::unordered_map<int, Connection> connections;
+        std::vector<int> holding;
+
+        void watch(int fd, std::uint32_t events, int operation) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = fd;
+            epoll_ctl(epoll, operation, fd, &event);
+        }
+
+        void drop(int fd) {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            connections.erase(fd);
+        }
+
+        void accept() {
+            for (;;) {
+                int fd = accept4(listener, nullptr, nullptr,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    return;
+                }
+                connections[fd];
+                watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+            }
+        }
+
+        // Wysyła ile się da; gdy coś zostanie, czeka na EPOLLOUT.
+        bool flush(int fd, Connection &connection) {
+            size_t sent = 0;
+            while (sent < connection.output.size()) {
+                ssize_t n = send(fd, connection.output.data() + sent,
+                                 connection.output.size() - sent,
+                                 MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    return false;
+                }
+                sent += n;
+            }
+            connection.output.erase(0, sent);
+            bool pending = !connection.output.empty();
+            if (pending != connection.writing) {
+                connection.writing = pending;
+                watch(fd, connection.events(), EPOLL_CTL_MOD);
+            }
+            return true;
+        }
+
+        // Po końcu danych od klienta obsługuje jeszcze wszystkie pełne
+        // ramki z bufora; połączenie jest zamykane dopiero po wysłaniu
+        // odpowiedzi na nie.
+        bool receive(int fd, Connection &connection) {
+            char buffer[1 << 16];
+            for (;;) {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    connection.input.append(buffer, n);
+                    continue;
+                }
+                if (n == 0) {
+                    connection.closed = true;
+                    watch(fd, connection.events(), EPOLL_CTL_MOD);
+                    break;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                return false;
+            }
+            std::string request;
+            size_t offset = 0;
+            std::string &responses =
+                journal != nullptr ? connection.held : connection.output;
+            bool idle = connection.held.empty();
+            try {
+                while (takeFrame(connection.input, request, offset)) {
+                    appendFrame(responses, host.handle(request));
+                }
+            } catch (ProtocolError const &) {
+                return false;
+            }
+            connection.input.erase(0, offset);
+            if (idle && !connection.held.empty()) {
+                holding.push_back(fd);
+            }
+            return true;
+        }
+
+        // Grupowe zatwierdzenie: jedno fdatasync() dla wszystkich żądań od
+        // poprzedniego, potem wysłanie wstrzymanych odpowiedzi.
+        void commit() {
+            journal->commit();
+            for (int fd : holding) {
+                auto it = connections.find(fd);
+                if (it == connections.end()) {
+                    continue;
+                }
+                it->second.output += it->second.held;
+                it->second.held.clear();
+                if (!flush(fd, it->second) || it->second.finished()) {
+                    drop(fd);
+                }
+            }
+            holding.clear();
+            if (journal->size() >= snapshotBytes) {
+                host.snapshot();
+            }
+        }
+
+        int timeout() const {
+            if (journal == nullptr || holding.empty()) {
+                return -1;
+            }
+            auto wait = journal->commitDeadline() - GameJournal::Clock::now();
+            return std::max<long>(
+                0, std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+        }
+
+       public:
+        Daemon(int listener, GameJournal *journal, std::uint64_t snapshotBytes,
+               size_t liveGames)
+            : listener(listener),
+              epoll(epoll_create1(EPOLL_CLOEXEC)),
+              journal(journal),
+              snapshotBytes(snapshotBytes),
+              host(journal, liveGames) {
+            host.recover();
+            watch(listener, EPOLLIN, EPOLL_CTL_ADD);
+        }
+
+        ~Daemon() {
+            for (auto const &[fd, connection] : connections) {
+                close(fd);
+            }
+            close(epoll);
+        }
+
+        void run() {
+            epoll_event events[256];
+            while (!stopping) {
+                int ready = epoll_wait(epoll, events, 256, timeout());
+                for (int i = 0; i < ready; i++) {
+                    int fd = events[i].data.fd;
+                    if (fd == listener) {
+                        accept();
+                        continue;
+                    }
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) {
+                        continue;
+                    }
+                    bool alive = true;
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+                        alive = receive(fd, it->second);
+                    }
+                    if (alive) {
+                        alive = flush(fd, it->second) && !it->second.finished();
+                    }
+                    if (!alive) {
+                        drop(fd);
+                    }
+                }
+                if (timeout() == 0) {
+                    commit();
+                }
+            }
+        }
+    };
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::string path = argc > 1 ? argv[1] : "/tmp/worldcup.sock";
+    std::string directory = argc > 2 ? argv[2] : "";
+    std::chrono::microseconds commitInterval(
+        argc > 3 ? std::stoul(argv[3]) : 1000);
+    std::uint64_t snapshotBytes = argc > 4 ? std::stoull(argv[4]) : 64 << 20;
+    size_t liveGames = argc > 5 ? std::stoul(argv[5]) : 4096;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "cannot create socket\n";
+        return 1;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) < 0 ||
+        listen(listener, SOMAXCONN) < 0 || !setNonBlocking(listener)) {
+        std::cerr << "cannot listen on " << path << ": "
+                  << std::strerror(errno) << '\n';
+        return 1;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    try {
+        std::unique_ptr<GameJournal> journal;
+        if (!directory.empty()) {
+            journal = std::make_unique<GameJournal>(directory, commitInterval);
+        }
+        Daemon daemon(listener, journal.get(), snapshotBytes, liveGames);
+        daemon.run();
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        close(listener);
+        return 1;
+    }
+    close(listener);
+    unlink(path.c_str());
+    return 0;
+}
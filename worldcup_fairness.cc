@@ -0,0 +1,20 @@
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "worldcup_fairness.h"
+
+// Narzędzie: worldcup_fairness [liczba gier] [liczba rund] [liczba wątków]
+// Wypisuje macierz prawdopodobieństw wygranej (wiersz - liczba graczy,
+// kolumna - miejsce w kolejności ruchów) z 95% przedziałami ufności.
+int main(int argc, char *argv[]) {
+    std::uint64_t games = argc > 1 ? std::stoull(argv[1]) : 100000;
+    unsigned int rounds = argc > 2 ? std::stoul(argv[2]) : 1000;
+    unsigned int threads =
+        argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+
+    FairnessAnalyzer analyzer(games, rounds, threads);
+    analyzer.run();
+    analyzer.report(std::cout);
+    return 0;
+}
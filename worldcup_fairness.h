@@ -0,0 +1,102 @@
+#ifndef WORLDCUP_FAIRNESS_H
+#define WORLDCUP_FAIRNESS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include "worldcup_simulation.h"
+
+// Szacuje prawdopodobieństwo wygranej w zależności od miejsca w kolejności
+// ruchów, osobno dla każdej liczby graczy.
+//
+// Gracze są identyczni, więc obrót kolejności przy tych samych rzutach daje
+// tę samą trajektorię - jedyną asymetrią jest miejsce. Dlatego wspólne
+// liczby losowe (te same ziarna) stosujemy między różnymi liczbami graczy:
+// różnice między wierszami macierzy mają wtedy mniejszą wariancję.
+class FairnessAnalyzer {
+   public:
+    static constexpr unsigned int minPlayers = 2;
+    static constexpr unsigned int maxPlayers = 11;
+
+    struct Cell {
+        // Zaobserwowana częstość wygranych.
+        double probability;
+        // Granice 95% przedziału ufności Wilsona. Przedział nie jest
+        // symetryczny względem probability (jego środek jest przesunięty
+        // w stronę 1/2), więc podajemy obie granice.
+        double lower;
+        double upper;
+    };
+
+   private:
+    std::uint64_t games;
+    unsigned int rounds;
+    unsigned int threads;
+    // wins[n][seat] - liczba wygranych gracza na miejscu seat w grach n osób.
+    std::vector<std::vector<std::uint64_t>> wins;
+
+    static Cell wilson(std::uint64_t successes, std::uint64_t trials) {
+        if (trials == 0) {
+            return {0.0, 0.0, 1.0};
+        }
+        constexpr double z = 1.959964;
+        double n = trials;
+        double p = successes / n;
+        double denominator = 1 + z * z / n;
+        double center = (p + z * z / (2 * n)) / denominator;
+        double half =
+            z * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / denominator;
+        return {p, std::max(0.0, center - half), std::min(1.0, center + half)};
+    }
+
+   public:
+    FairnessAnalyzer(std::uint64_t games, unsigned int rounds,
+                     unsigned int threads)
+        : games(games),
+          rounds(rounds),
+          threads(threads),
+          wins(maxPlayers + 1) {}
+
+    void run() {
+        for (unsigned int n = minPlayers; n <= maxPlayers; n++) {
+            std::vector<std::vector<std::uint64_t>> local(
+                std::max(1u, threads), std::vector<std::uint64_t>(n, 0));
+            parallelForSeeds(0, games, threads,
+                             [&](unsigned int id, std::uint64_t seed) {
+                                 GameOutcome outcome =
+                                     simulateGame(n, rounds, seed);
+                                 local[id][outcome.winnerSeat]++;
+                             });
+            wins[n].assign(n, 0);
+            for (auto const &counts : local) {
+                for (unsigned int seat = 0; seat < n; seat++) {
+                    wins[n][seat] += counts[seat];
+                }
+            }
+        }
+    }
+
+    Cell cell(unsigned int players, unsigned int seat) const {
+        return wilson(wins[players][seat], games);
+    }
+
+    // Wiersze: liczba graczy, kolumny: miejsce w kolejności ruchów.
+    void report(std::ostream &out) const {
+        out << std::fixed << std::setprecision(4);
+        for (unsigned int n = minPlayers; n <= maxPlayers; n++) {
+            out << n;
+            for (unsigned int seat = 0; seat < n; seat++) {
+                Cell c = cell(n, seat);
+                out << '\t' << c.probability << " [" << c.lower << ", "
+                    << c.upper << ']';
+            }
+            out << '\n';
+        }
+    }
+};
+
+#endif
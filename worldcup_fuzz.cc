@@ -0,0 +1,56 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "worldcup_fuzz.h"
+
+// Narzędzie: worldcup_fuzz [liczba gier] [liczba wątków] [pierwsze ziarno]
+// Porównuje przebiegi przypadków regresyjnych i losowych gier w silnikach
+// zoptymalizowanych z silnikiem wzorcowym. Dla pierwszej niezgodności wypisuje zmniejszony
+// przypadek i różniące się zdarzenia; kod wyjścia 1 oznacza niezgodność.
+int main(int argc, char *argv[]) {
+    std::uint64_t games = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    unsigned int threads =
+        argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+    std::uint64_t firstSeed = argc > 3 ? std::stoull(argv[3]) : 0;
+
+    auto start = std::chrono::steady_clock::now();
+    bool regressed = false;
+    for (FuzzCase const &regression : regressionCases()) {
+        for (FuzzEngine engine : mismatchedEngines(regression)) {
+            regressed = true;
+            std::cout << "regression case mismatch, engine "
+                      << fuzzEngineName(engine) << '\n';
+            describeCase(regression, std::cout);
+            describeMismatch(regression, engine, std::cout);
+        }
+    }
+    auto failures = fuzzEngines(firstSeed, games, threads);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << games << " games in " << elapsed.count() << " s ("
+              << games / elapsed.count() << " games/s, "
+              << games * fuzzVariants.size() / elapsed.count()
+              << " comparisons/s)\n";
+    if (failures.empty()) {
+        std::cout << (regressed ? "regression case mismatches\n"
+                                : "no mismatches\n");
+        return regressed ? 1 : 0;
+    }
+
+    for (auto const &failure : failures) {
+        std::cout << "mismatch: seed " << failure.seed << ", engine "
+                  << fuzzEngineName(failure.engine) << '\n';
+    }
+    FuzzFailure const first = failures.front();
+    FuzzCase reduced =
+        shrinkCase(randomCase(first.seed), [&](FuzzCase const &candidate) {
+            return !sameRun(candidate, first.engine);
+        });
+    std::cout << "\nreduced case (seed " << first.seed << ", engine "
+              << fuzzEngineName(first.engine) << "):\n";
+    describeCase(reduced, std::cout);
+    describeMismatch(reduced, first.engine, std::cout);
+    return 1;
+}
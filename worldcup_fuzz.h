@@ -0,0 +1,517 @@
+#ifndef WORLDCUP_FUZZ_H
+#define WORLDCUP_FUZZ_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+
+#include "worldcup_compactboard.h"
+#include "worldcup_hugeboard.h"
+#include "worldcup_simulation.h"
+
+// Różnicowe testowanie silników gry: losowe przypadki (układ i parametry
+// pól, liczba graczy i kostek, ciąg rzutów, liczba rund) są rozgrywane
+// silnikiem wzorcowym (ogólna pętla play() na planszy Board) i każdym
+// wariantem zoptymalizowanym, a strumienie zdarzeń tablicy wyników są
+// porównywane przez skróty. Przypadek, dla którego wariant daje inny
+// przebieg, można zmniejszyć do minimalnego przykładu (shrinkCase).
+
+// Przypadek testowy. Kostki zwracają kolejne wartości z rolls (cyklicznie,
+// wspólny ciąg dla wszystkich kostek).
+struct FuzzCase {
+    std::vector<FieldSpec> layout;
+    unsigned int players;
+    unsigned int dice;
+    unsigned int rounds;
+    std::vector<unsigned short> rolls;
+};
+
+enum class FuzzEngine {
+    // Wzorzec.
+    Generic,
+    Prepared,
+    // Gra przerywana co kilka tur (stop_token) i wznawiana.
+    Resumed,
+    Compact,
+    Huge,
+};
+
+inline constexpr std::array<FuzzEngine, 4> fuzzVariants = {
+    FuzzEngine::Prepared, FuzzEngine::Resumed, FuzzEngine::Compact,
+    FuzzEngine::Huge};
+
+inline char const *fuzzEngineName(FuzzEngine engine) {
+    switch (engine) {
+        case FuzzEngine::Generic:
+            return "generic";
+        case FuzzEngine::Prepared:
+            return "prepared";
+        case FuzzEngine::Resumed:
+            return "resumed";
+        case FuzzEngine::Compact:
+            return "compact";
+        case FuzzEngine::Huge:
+            return "huge";
+    }
+    return "?";
+}
+
+// Tablica wyników sprowadzająca strumień zdarzeń do skrótu kroczącego
+// (FNV-1a). Z podanym dziennikiem zapisuje też zdarzenia jako tekst.
+class EventDigest : public ScoreBoard {
+   private:
+    std::uint64_t hash = 0xcbf29ce484222325u;
+    std::uint64_t events = 0;
+    std::vector<std::string> *log;
+
+    void mix(std::string_view bytes) {
+        for (unsigned char c : bytes) {
+            hash = (hash ^ c) * 0x100000001b3u;
+        }
+        hash = (hash ^ 0xff) * 0x100000001b3u;
+    }
+
+    void mix(std::uint64_t value) {
+        mix(std::string_view(reinterpret_cast<char const *>(&value),
+                             sizeof(value)));
+    }
+
+   public:
+    explicit EventDigest(std::vector<std::string> *log = nullptr) : log(log) {}
+
+    void onRound(unsigned int roundNo) override {
+        events++;
+        mix("R");
+        mix(roundNo);
+        if (log != nullptr) {
+            log->push_back("=== Runda: " + std::to_string(roundNo));
+        }
+    }
+
+    void onTurn(std::string const &playerName, std::string const &playerStatus,
+                std::string const &squareName, unsigned int money) override {
+        events++;
+        mix("T");
+        mix(playerName);
+        mix(playerStatus);
+        mix(squareName);
+        mix(money);
+        if (log != nullptr) {
+            log->push_back(playerName + " [" + playerStatus + "] [" +
+                           std::to_string(money) + "] - " + squareName);
+        }
+    }
+
+    void onWin(std::string const &playerName) override {
+        events++;
+        mix("W");
+        mix(playerName);
+        if (log != nullptr) {
+            log->push_back("=== Zwycięzca: " + playerName);
+        }
+    }
+
+    // Wyjątek rzucony przez grę (też jest częścią przebiegu).
+    void onError(std::string_view what) {
+        events++;
+        mix("E");
+        mix(what);
+        if (log != nullptr) {
+            log->push_back("!!! " + std::string(what));
+        }
+    }
+
+    std::uint64_t digest() const { return hash; }
+
+    std::uint64_t count() const { return events; }
+
+    bool operator==(EventDigest const &other) const {
+        return hash == other.hash && events == other.events;
+    }
+};
+
+namespace fuzz_detail {
+    struct RollStream {
+        std::vector<unsigned short> const &rolls;
+        size_t next = 0;
+    };
+
+    class StreamDie : public Die {
+       private:
+        std::shared_ptr<RollStream> stream;
+
+       public:
+        explicit StreamDie(std::shared_ptr<RollStream> stream)
+            : stream(std::move(stream)) {}
+
+        [[nodiscard]] unsigned short roll() const override {
+            auto const &rolls = stream->rolls;
+            return rolls.empty() ? 0 : rolls[stream->next++ % rolls.size()];
+        }
+    };
+
+    // Zgłasza żądanie zatrzymania co every tur.
+    class Interrupter : public TurnObserver {
+       public:
+        std::stop_source source;
+        unsigned int every;
+        unsigned int turns = 0;
+
+        explicit Interrupter(unsigned int every) : every(every) {}
+
+        void onTurnEnd(Player const &player, unsigned int roll) override {
+            (void)player;
+            (void)roll;
+            if (++turns % every == 0) {
+                source.request_stop();
+            }
+        }
+    };
+}  // namespace fuzz_detail
+
+// Przypadek okrążeń: plansza 2 - 4 pól z hojnym Początkiem (pole 0),
+// drogimi meczami i rzutami obejmującymi co najmniej pełne okrążenie -
+// sprawdza zbiorcze rozliczanie okrążeń w HugeBoard, którego zwykłe
+// losowe przypadki prawie nie dotykają.
+inline FuzzCase lapCase(std::mt19937_64 &random) {
+    auto below = [&random](unsigned int n) {
+        return static_cast<unsigned int>(random() % n);
+    };
+    FuzzCase result;
+    unsigned int fields = 2 + below(3);
+    result.layout.push_back(
+        {FieldType::Beginning, "Pole 0", 500 + below(4000), 0.0});
+    for (unsigned int i = 1; i < fields; i++) {
+        FieldSpec spec{FieldType::Match, "Pole " + std::to_string(i),
+                       200 + below(2800), 1.0 + below(4) / 2.0};
+        if (below(3) == 0) {
+            spec.type = static_cast<FieldType>(1 + below(6));
+            spec.value = spec.type == FieldType::YellowCard ? below(6)
+                                                            : below(500);
+        }
+        result.layout.push_back(spec);
+    }
+    result.players = 2 + below(4);
+    result.dice = 2;
+    result.rounds = below(40);
+    result.rolls.resize(1 + below(8));
+    for (auto &roll : result.rolls) {
+        roll = fields + below(3 * fields);
+    }
+    return result;
+}
+
+// Przypadki, w których kiedyś wykryto niezgodność; sprawdzane zawsze.
+inline std::vector<FuzzCase> regressionCases() {
+    return {
+        // Początek wart więcej niż okrążenie nie ratował w HugeBoard
+        // gracza, którego nie stać na pierwsze okrążenie.
+        {{{FieldType::Beginning, "Początek", 2000, 0.0},
+          {FieldType::Match, "Mecz", 1500, 1.0},
+          {FieldType::Empty, "Pusty", 0, 0.0}},
+         2,
+         2,
+         10,
+         {2, 3}},
+    };
+}
+
+// Losowy przypadek. Zwykle poprawny, ale czasem z niedozwoloną liczbą
+// graczy lub kostek (wtedy porównywane są wyjątki); co ósmy to przypadek
+// okrążeń (lapCase).
+inline FuzzCase randomCase(std::uint64_t seed) {
+    std::mt19937_64 random(seed);
+    auto below = [&random](unsigned int n) {
+        return static_cast<unsigned int>(random() % n);
+    };
+    if (below(8) == 0) {
+        return lapCase(random);
+    }
+    FuzzCase result;
+    unsigned int fields = below(8) == 0 ? 1 + below(64) : 1 + below(16);
+    for (unsigned int i = 0; i < fields; i++) {
+        FieldSpec spec;
+        spec.type = static_cast<FieldType>(below(7));
+        // Czasem powtórzona nazwa (plansze ze słownikiem nazw).
+        spec.name = i > 0 && below(8) == 0
+                        ? result.layout[below(i)].name
+                        : "Pole " + std::to_string(i);
+        spec.value = spec.type == FieldType::YellowCard ? below(6) : below(500);
+        std::array<double, 3> const weights = {1.0, 2.5, 4.0};
+        spec.weight = below(4) == 0 ? below(51) / 10.0 : weights[below(3)];
+        result.layout.push_back(spec);
+    }
+    result.players = below(32) == 0 ? below(14) : 2 + below(10);
+    result.dice = below(64) == 0 ? below(4) : 2;
+    result.rounds = below(8) == 0 ? below(400) : below(60);
+    unsigned int maxRoll = below(4) == 0 ? 40 : 6;
+    result.rolls.resize(1 + below(32));
+    for (auto &roll : result.rolls) {
+        roll = below(maxRoll + 1);
+    }
+    return result;
+}
+
+// Czy silnik obsługuje układ przypadku (HugeBoard dopuszcza Początek
+// tylko jako pole 0).
+inline bool supportsCase(FuzzEngine engine, FuzzCase const &fuzzCase) {
+    if (engine != FuzzEngine::Huge) {
+        return true;
+    }
+    for (size_t i = 1; i < fuzzCase.layout.size(); i++) {
+        if (fuzzCase.layout[i].type == FieldType::Beginning) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Rozgrywa przypadek danym silnikiem, przekazując zdarzenia do digest.
+inline void playCase(FuzzCase const &fuzzCase, FuzzEngine engine,
+                     std::shared_ptr<EventDigest> const &digest) {
+    std::shared_ptr<GameBoard> board;
+    switch (engine) {
+        case FuzzEngine::Compact:
+            board = std::make_shared<CompactBoard>(fuzzCase.layout);
+            break;
+        case FuzzEngine::Huge:
+            board = std::make_shared<HugeBoard>(fuzzCase.layout);
+            break;
+        default:
+            board = std::make_shared<Board>(fuzzCase.layout);
+            break;
+    }
+    WorldCup2022 game(board);
+    auto stream = std::make_shared<fuzz_detail::RollStream>(fuzzCase.rolls);
+    for (unsigned int i = 0; i < fuzzCase.dice; i++) {
+        game.addDie(std::make_shared<fuzz_detail::StreamDie>(stream));
+    }
+    for (unsigned int seat = 0; seat < fuzzCase.players; seat++) {
+        game.addPlayer(seatName(seat));
+    }
+    game.setScoreBoard(digest);
+    try {
+        switch (engine) {
+            case FuzzEngine::Prepared:
+                game.prepare().play(fuzzCase.rounds);
+                break;
+            case FuzzEngine::Resumed: {
+                unsigned int rounds = fuzzCase.rounds;
+                for (;;) {
+                    fuzz_detail::Interrupter interrupter(
+                        1 + fuzzCase.rolls.size() % 5);
+                    game.setTurnObserver(&interrupter);
+                    PlayResult result =
+                        game.play(rounds, interrupter.source.get_token());
+                    game.setTurnObserver(nullptr);
+                    if (!result.stopped) {
+                        break;
+                    }
+                    rounds -= result.rounds;
+                }
+                break;
+            }
+            default:
+                game.play(fuzzCase.rounds);
+                break;
+        }
+    } catch (std::exception const &e) {
+        digest->onError(typeid(e).name());
+    }
+}
+
+// Czy wariant rozgrywa przypadek tak jak wzorzec (przypadki, których
+// wariant nie obsługuje, uznajemy za zgodne).
+inline bool sameRun(FuzzCase const &fuzzCase, FuzzEngine engine) {
+    if (!supportsCase(engine, fuzzCase)) {
+        return true;
+    }
+    auto reference = std::make_shared<EventDigest>();
+    auto variant = std::make_shared<EventDigest>();
+    playCase(fuzzCase, FuzzEngine::Generic, reference);
+    playCase(fuzzCase, engine, variant);
+    return *reference == *variant;
+}
+
+// Warianty, których przebieg różni się od wzorca.
+inline std::vector<FuzzEngine> mismatchedEngines(FuzzCase const &fuzzCase) {
+    auto reference = std::make_shared<EventDigest>();
+    playCase(fuzzCase, FuzzEngine::Generic, reference);
+    std::vector<FuzzEngine> result;
+    for (FuzzEngine engine : fuzzVariants) {
+        if (!supportsCase(engine, fuzzCase)) {
+            continue;
+        }
+        auto variant = std::make_shared<EventDigest>();
+        playCase(fuzzCase, engine, variant);
+        if (!(*reference == *variant)) {
+            result.push_back(engine);
+        }
+    }
+    return result;
+}
+
+// Zachłannie upraszcza przypadek, dopóki failing pozostaje prawdziwe:
+// mniej rund, graczy i pól, prostsze pola, krótszy ciąg mniejszych rzutów.
+// Kończy, gdy żadne pojedyncze uproszczenie nie zachowuje błędu.
+inline FuzzCase shrinkCase(
+    FuzzCase current,
+    std::function<bool(FuzzCase const &)> const &failing) {
+    bool progress = true;
+    auto attempt = [&](FuzzCase const &candidate) {
+        if (failing(candidate)) {
+            current = candidate;
+            progress = true;
+        }
+    };
+    while (progress) {
+        progress = false;
+        for (unsigned int rounds : {0u, current.rounds / 2,
+                                    current.rounds > 0 ? current.rounds - 1
+                                                       : 0u}) {
+            if (rounds < current.rounds) {
+                FuzzCase candidate = current;
+                candidate.rounds = rounds;
+                attempt(candidate);
+            }
+        }
+        if (current.players > 0) {
+            FuzzCase candidate = current;
+            candidate.players--;
+            attempt(candidate);
+        }
+        for (size_t i = current.layout.size(); i-- > 0;) {
+            if (current.layout.size() > 1) {
+                FuzzCase candidate = current;
+                candidate.layout.erase(candidate.layout.begin() + i);
+                attempt(candidate);
+            }
+        }
+        for (size_t i = 0; i < current.layout.size(); i++) {
+            FieldSpec const spec = current.layout[i];
+            std::vector<FieldSpec> simpler;
+            if (spec.type != FieldType::Empty) {
+                simpler.push_back({FieldType::Empty, spec.name, 0, 0.0});
+            }
+            if (spec.value > 0) {
+                simpler.push_back({spec.type, spec.name, 0, spec.weight});
+                simpler.push_back(
+                    {spec.type, spec.name, spec.value / 2, spec.weight});
+            }
+            if (spec.weight != 1.0) {
+                simpler.push_back({spec.type, spec.name, spec.value, 1.0});
+            }
+            for (auto const &field : simpler) {
+                FuzzCase candidate = current;
+                candidate.layout[i] = field;
+                attempt(candidate);
+                if (progress) {
+                    break;
+                }
+            }
+        }
+        for (size_t i = current.rolls.size(); i-- > 0;) {
+            if (current.rolls.size() > 1) {
+                FuzzCase candidate = current;
+                candidate.rolls.erase(candidate.rolls.begin() + i);
+                attempt(candidate);
+            }
+        }
+        for (size_t i = 0; i < current.rolls.size(); i++) {
+            if (current.rolls[i] > 0) {
+                FuzzCase candidate = current;
+                candidate.rolls[i] /= 2;
+                attempt(candidate);
+            }
+        }
+    }
+    return current;
+}
+
+// Opis przypadku do odtworzenia błędu.
+inline void describeCase(FuzzCase const &fuzzCase, std::ostream &out) {
+    out << "players=" << fuzzCase.players << " dice=" << fuzzCase.dice
+        << " rounds=" << fuzzCase.rounds << "\nrolls=";
+    for (auto roll : fuzzCase.rolls) {
+        out << ' ' << roll;
+    }
+    out << "\nlayout:\n";
+    for (auto const &spec : fuzzCase.layout) {
+        out << "  {FieldType(" << static_cast<int>(spec.type) << "), \""
+            << spec.name << "\", " << spec.value << ", " << spec.weight
+            << "}\n";
+    }
+}
+
+// Wypisuje przebiegi wzorca i wariantu od pierwszego różniącego się
+// zdarzenia.
+inline void describeMismatch(FuzzCase const &fuzzCase, FuzzEngine engine,
+                             std::ostream &out) {
+    std::vector<std::string> expected;
+    std::vector<std::string> actual;
+    playCase(fuzzCase, FuzzEngine::Generic,
+             std::make_shared<EventDigest>(&expected));
+    playCase(fuzzCase, engine, std::make_shared<EventDigest>(&actual));
+    size_t first = 0;
+    while (first < expected.size() && first < actual.size() &&
+           expected[first] == actual[first]) {
+        first++;
+    }
+    out << "first difference at event " << first << '\n';
+    for (auto const &[name, events] :
+         {std::pair{fuzzEngineName(FuzzEngine::Generic), &expected},
+          std::pair{fuzzEngineName(engine), &actual}}) {
+        out << name << ":\n";
+        for (size_t i = first; i < events->size() && i < first + 8; i++) {
+            out << "  " << (*events)[i] << '\n';
+        }
+    }
+}
+
+struct FuzzFailure {
+    std::uint64_t seed;
+    FuzzEngine engine;
+};
+
+// Sprawdza przypadki o ziarnach z [firstSeed, firstSeed + count) na threads
+// wątkach. Zwraca co najwyżej maxFailures niezgodności o najmniejszych
+// ziarnach.
+inline std::vector<FuzzFailure> fuzzEngines(std::uint64_t firstSeed,
+                                            std::uint64_t count,
+                                            unsigned int threads,
+                                            size_t maxFailures = 16) {
+    std::mutex mutex;
+    std::vector<FuzzFailure> failures;
+    parallelForSeeds(firstSeed, count, threads,
+                     [&](unsigned int, std::uint64_t seed) {
+                         auto found = mismatchedEngines(randomCase(seed));
+                         if (found.empty()) {
+                             return;
+                         }
+                         std::lock_guard lock(mutex);
+                         for (FuzzEngine engine : found) {
+                             failures.push_back({seed, engine});
+                         }
+                     });
+    std::sort(failures.begin(), failures.end(),
+              [](FuzzFailure const &a, FuzzFailure const &b) {
+                  return a.seed < b.seed ||
+                         (a.seed == b.seed && a.engine < b.engine);
+              });
+    if (failures.size() > maxFailures) {
+        failures.resize(maxFailures);
+    }
+    return failures;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "worldcup_golden.h"
+
+// Narzędzie: worldcup_golden generate korpus [liczba gier] [liczba graczy]
+//            [liczba rund] [liczba wątków]
+//            worldcup_golden verify korpus [liczba wątków]
+// Zapisuje złoty korpus skrótów przebiegów gier albo sprawdza bieżącą
+// wersję silnika względem zapisanego korpusu (kod wyjścia 1 oznacza
+// niezgodność).
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0]
+                  << " generate|verify corpus [games players rounds] "
+                     "[threads]\n";
+        return 1;
+    }
+    std::string const mode = argv[1];
+    try {
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t games = 0;
+        if (mode == "generate") {
+            games = argc > 3 ? std::stoull(argv[3]) : 10000000;
+            unsigned int players = argc > 4 ? std::stoul(argv[4]) : 4;
+            unsigned int rounds = argc > 5 ? std::stoul(argv[5]) : 100;
+            unsigned int threads = argc > 6
+                                       ? std::stoul(argv[6])
+                                       : std::thread::hardware_concurrency();
+            std::ofstream out(argv[2], std::ios::binary);
+            generateCorpus(players, rounds, 0, games, threads).write(out);
+        } else if (mode == "verify") {
+            unsigned int threads = argc > 3
+                                       ? std::stoul(argv[3])
+                                       : std::thread::hardware_concurrency();
+            std::ifstream in(argv[2], std::ios::binary);
+            GoldenCorpus corpus = GoldenCorpus::read(in);
+            games = corpus.hashes.size();
+            if (corpus.version != engineVersion) {
+                std::cout << "corpus from engine version " << corpus.version
+                          << ", current " << engineVersion
+                          << " (differences are expected)\n";
+            }
+            auto mismatches = verifyCorpus(corpus, threads);
+            for (auto seed : mismatches) {
+                std::cout << "mismatch: seed " << seed << '\n';
+            }
+            if (!mismatches.empty()) {
+                return 1;
+            }
+        } else {
+            std::cerr << "unknown mode " << mode << '\n';
+            return 1;
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << games << " games in " << elapsed.count() << " s ("
+                  << games / elapsed.count() << " games/s)\n";
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+#ifndef WORLDCUP_GOLDEN_H
+#define WORLDCUP_GOLDEN_H
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "worldcup_hugepages.h"
+#include "worldcup_simulation.h"
+
+// Złoty korpus: skróty przebiegów (TrajectoryHash) gier o kolejnych
+// ziarnach na planszy domyślnej, zapisane przez jedną wersję silnika.
+// Kolejna wersja sprawdza regresję, porównując same skróty - bez
+// zapisywania i porównywania pełnych dzienników gier.
+
+// Skrót przebiegu gry jak w simulateGame().
+inline std::uint64_t trajectoryHash(std::vector<FieldSpec> const &layout,
+                                    unsigned int players, unsigned int rounds,
+                                    std::uint64_t seed) {
+    auto engine = std::make_shared<std::mt19937_64>(seed);
+    WorldCup2022 worldCup(layout);
+    worldCup.addDie(std::make_shared<RandomDie>(engine));
+    worldCup.addDie(std::make_shared<RandomDie>(engine));
+    for (unsigned int seat = 0; seat < players; seat++) {
+        worldCup.addPlayer(seatName(seat));
+    }
+    worldCup.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+    worldCup.hashTrajectory(true);
+    worldCup.play(rounds);
+    return worldCup.getTrajectoryHash();
+}
+
+struct GoldenCorpus {
+    // Wersja silnika, która zapisała korpus.
+    std::uint32_t version = engineVersion;
+    std::uint32_t players = 0;
+    std::uint32_t rounds = 0;
+    std::uint64_t firstSeed = 0;
+    // hashes[i] - skrót gry o ziarnie firstSeed + i.
+    HugeVector<std::uint64_t> hashes;
+
+    // Format binarny (little-endian): "WCG1", wersja, gracze, rundy
+    // (u32), pierwsze ziarno, liczba gier (u64), skróty (u64).
+    void write(std::ostream &out) const {
+        out.write("WCG1", 4);
+        std::uint64_t count = hashes.size();
+        out.write(reinterpret_cast<char const *>(&version), sizeof(version));
+        out.write(reinterpret_cast<char const *>(&players), sizeof(players));
+        out.write(reinterpret_cast<char const *>(&rounds), sizeof(rounds));
+        out.write(reinterpret_cast<char const *>(&firstSeed),
+                  sizeof(firstSeed));
+        out.write(reinterpret_cast<char const *>(&count), sizeof(count));
+        out.write(reinterpret_cast<char const *>(hashes.data()),
+                  hashes.size() * sizeof(std::uint64_t));
+        if (!out) {
+            throw std::runtime_error("cannot write golden corpus");
+        }
+    }
+
+    static GoldenCorpus read(std::istream &in) {
+        char magic[4];
+        GoldenCorpus corpus;
+        std::uint64_t count = 0;
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char *>(&corpus.version),
+                sizeof(corpus.version));
+        in.read(reinterpret_cast<char *>(&corpus.players),
+                sizeof(corpus.players));
+        in.read(reinterpret_cast<char *>(&corpus.rounds),
+                sizeof(corpus.rounds));
+        in.read(reinterpret_cast<char *>(&corpus.firstSeed),
+                sizeof(corpus.firstSeed));
+        in.read(reinterpret_cast<char *>(&count), sizeof(count));
+        if (!in || std::string_view(magic, 4) != "WCG1") {
+            throw std::runtime_error("not a golden corpus");
+        }
+        // Liczbę skrótów z nagłówka sprawdzamy z resztą strumienia przed
+        // przydziałem, żeby uszkodzony plik nie wymusił ogromnego bufora.
+        // Strumień bez pozycjonowania (np. potok) czytamy porcjami.
+        std::streamoff remaining = -1;
+        auto position = in.tellg();
+        if (position != std::istream::pos_type(-1)) {
+            in.seekg(0, std::ios::end);
+            remaining = in.tellg() - position;
+            in.seekg(position);
+        }
+        if (remaining >= 0 &&
+            count > static_cast<std::uint64_t>(remaining) /
+                        sizeof(std::uint64_t)) {
+            throw std::runtime_error("truncated golden corpus");
+        }
+        constexpr std::uint64_t chunk = std::uint64_t(1) << 20;
+        for (std::uint64_t done = 0; done < count;) {
+            std::uint64_t part =
+                remaining >= 0 ? count : std::min(chunk, count - done);
+            corpus.hashes.resize(done + part);
+            in.read(reinterpret_cast<char *>(corpus.hashes.data() + done),
+                    part * sizeof(std::uint64_t));
+            if (!in) {
+                throw std::runtime_error("truncated golden corpus");
+            }
+            done += part;
+        }
+        return corpus;
+    }
+};
+
+inline GoldenCorpus generateCorpus(unsigned int players, unsigned int rounds,
+                                   std::uint64_t firstSeed,
+                                   std::uint64_t count, unsigned int threads) {
+    GoldenCorpus corpus;
+    corpus.players = players;
+    corpus.rounds = rounds;
+    corpus.firstSeed = firstSeed;
+    corpus.hashes.resize(count);
+    auto const layout = defaultLayout();
+    parallelForSeeds(firstSeed, count, threads,
+                     [&](unsigned int, std::uint64_t seed) {
+                         corpus.hashes[seed - firstSeed] =
+                             trajectoryHash(layout, players, rounds, seed);
+                     });
+    return corpus;
+}
+
+// Ziarna (rosnąco, co najwyżej maxMismatches) gier, których przebieg
+// w bieżącej wersji silnika różni się od zapisanego w korpusie.
+inline std::vector<std::uint64_t> verifyCorpus(GoldenCorpus const &corpus,
+                                               unsigned int threads,
+                                               size_t maxMismatches = 16) {
+    std::mutex mutex;
+    std::vector<std::uint64_t> mismatches;
+    auto const layout = defaultLayout();
+    parallelForSeeds(corpus.firstSeed, corpus.hashes.size(), threads,
+                     [&](unsigned int, std::uint64_t seed) {
+                         std::uint64_t hash = trajectoryHash(
+                             layout, corpus.players, corpus.rounds, seed);
+                         if (hash != corpus.hashes[seed - corpus.firstSeed]) {
+                             std::lock_guard lock(mutex);
+                             mismatches.push_back(seed);
+                         }
+                     });
+    std::sort(mismatches.begin(), mismatches.end());
+    if (mismatches.size() > maxMismatches) {
+        mismatches.resize(maxMismatches);
+    }
+    return mismatches;
+}
+
+#endif
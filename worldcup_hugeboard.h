@@ -0,0 +1,274 @@
+#ifndef WORLDCUP_HUGEBOARD_H
+#define WORLDCUP_HUGEBOARD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "worldcup_compactboard.h"
+
+// Drzewo Fenwicka z dodawaniem na przedziale i odczytem pojedynczej wartości
+// (trzyma różnice sąsiednich elementów). Obie operacje działają w O(log n).
+class RangeAddFenwick {
+   private:
+    HugeVector<std::int64_t> tree;
+
+    void add(size_t i, std::int64_t delta) {
+        for (i++; i < tree.size(); i += i & (~i + 1)) {
+            tree[i] += delta;
+        }
+    }
+
+   public:
+    explicit RangeAddFenwick(size_t size) : tree(size + 1, 0) {}
+
+    // Dodaje delta do elementów z przedziału [begin, end).
+    void rangeAdd(size_t begin, size_t end, std::int64_t delta) {
+        if (begin >= end) {
+            return;
+        }
+        add(begin, delta);
+        if (end + 1 < tree.size()) {
+            add(end, -delta);
+        }
+    }
+
+    std::int64_t get(size_t i) const {
+        std::int64_t sum = 0;
+        for (i++; i > 0; i -= i & (~i + 1)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+};
+
+// Plansza dla wariantu z bardzo dużą liczbą pól (10^5 - 10^6) i dużymi
+// rzutami, w którym jeden ruch mija tysiące meczów, a nawet całe okrążenia.
+//
+// Zamiast odwiedzać mijane pola po kolei:
+// - opłaty za przejście trzymamy jako sumy prefiksowe, więc koszt odcinka
+//   liczymy w O(1), a pole, na którym gracz bankrutuje, wyszukujemy binarnie;
+// - pule meczów wyznaczamy z liczby przejść przez pole, trzymanej w drzewie
+//   Fenwicka z dodawaniem na przedziale (pula = opłata * liczba przejść od
+//   ostatniej wypłaty + ewentualna niepełna wpłata bankruta);
+// - pełne okrążenia rozliczamy w postaci zamkniętej.
+// Ruch kosztuje więc O(log n), a semantyka (w tym bankructwo dokładnie na
+// polu, na którym zabrakło pieniędzy) jest taka sama jak w Board.
+//
+// Jedynym polem z akcją przy przejściu poza meczami może być Początek,
+// i to tylko jako pole o numerze 0. Obserwator pól jest powiadamiany tylko
+// o zatrzymaniu na polu, bo przejścia są rozliczane zbiorczo.
+//
+// Pola są trzymane w zwartej tablicy FieldTable; jej stan meczu przechowuje
+// tu tylko tę część puli, która nie wynika z pełnych opłat.
+class HugeBoard : public GameBoard {
+   private:
+    FieldTable fields;
+    // feePrefix[i] - suma opłat za przejście przez pola [0, i).
+    HugeVector<std::uint64_t> feePrefix;
+    RangeAddFenwick passes;
+    // Liczba przejść w chwili ostatniej wypłaty puli.
+    HugeVector<std::int64_t> passBase;
+    FieldObserver *observer;
+
+    bool hasBeginning() const {
+        return fields.type(0) == FieldType::Beginning;
+    }
+
+    std::uint64_t passFee(size_t i) const {
+        return feePrefix[i + 1] - feePrefix[i];
+    }
+
+    std::uint64_t pot(size_t i) const {
+        return passFee(i) * (passes.get(i) - passBase[i]) + fields.state(i);
+    }
+
+    // Gracz przechodzi przez pola [begin, end) (bez pola 0 z Początkiem).
+    // Zwraca false, jeśli zbankrutował - wtedy kolejne przejścia nie mają
+    // już żadnego efektu.
+    bool passSegment(Player *player, size_t begin, size_t end) {
+        std::uint64_t money = player->getMoney();
+        std::uint64_t cost = feePrefix[end] - feePrefix[begin];
+        if (cost <= money) {
+            player->pay(cost);
+            passes.rangeAdd(begin, end, 1);
+            recordPasses(begin, end, 1);
+            return true;
+        }
+        // Pierwsze pole, na którym łączna opłata przekracza stan konta.
+        auto limit = feePrefix[begin] + money;
+        size_t bankrupt =
+            std::upper_bound(feePrefix.begin() + begin + 1,
+                             feePrefix.begin() + end + 1, limit) -
+            feePrefix.begin() - 1;
+        player->pay(feePrefix[bankrupt] - feePrefix[begin]);
+        passes.rangeAdd(begin, bankrupt, 1);
+        recordPasses(begin, bankrupt, 1);
+        unsigned int paid = player->pay(passFee(bankrupt));
+        fields.setState(bankrupt, fields.state(bankrupt) + paid);
+        ledger::atField(bankrupt);
+        ledger::playerToPot(paid);
+        return false;
+    }
+
+    // Księga (tylko z -DWORLDCUP_LEDGER) dostaje osobny przelew do puli
+    // każdego mijanego meczu, więc zbiorcze rozliczenie jest sprawdzane
+    // pole po polu.
+    void recordPasses(size_t begin, size_t end, std::uint64_t times) const {
+#ifdef WORLDCUP_LEDGER
+        for (size_t i = begin; i < end; i++) {
+            ledger::atField(i);
+            ledger::playerToPot(passFee(i) * times);
+        }
+#else
+        (void)begin;
+        (void)end;
+        (void)times;
+#endif
+    }
+
+    void landOnField(Player *player, size_t i) {
+        ledger::atField(i);
+        if (fields.type(i) != FieldType::Match) {
+            fields.landOnField(i, player);
+            return;
+        }
+        unsigned int won = pot(i);
+        int prize = won * fields.weight(i);
+        if (player->take(prize)) {
+            ledger::matchPrize(won, prize);
+            passBase[i] = passes.get(i);
+            fields.setState(i, 0);
+        }
+    }
+
+   public:
+    explicit HugeBoard(FieldTable table)
+        : fields(std::move(table)),
+          feePrefix(fields.size() + 1, 0),
+          passes(fields.size()),
+          passBase(fields.size(), 0),
+          observer(nullptr) {
+        if (fields.size() == 0) {
+            throw std::invalid_argument("empty board");
+        }
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (fields.type(i) == FieldType::Beginning && i != 0) {
+                throw std::invalid_argument("Beginning must be field 0");
+            }
+            std::uint64_t fee =
+                fields.type(i) == FieldType::Match ? fields.value(i) : 0;
+            feePrefix[i + 1] = feePrefix[i] + fee;
+        }
+    }
+
+    explicit HugeBoard(std::vector<FieldSpec> const &layout)
+        : HugeBoard(FieldTable(layout)) {}
+
+    void playerMove(Player *player, unsigned int i) override {
+        size_t const n = fields.size();
+        size_t const lapStart = hasBeginning() ? 1 : 0;
+        std::uint64_t const lapFee = feePrefix[n] - feePrefix[lapStart];
+        std::uint64_t const gift = hasBeginning() ? fields.value(0) : 0;
+
+        size_t position = (player->getField() + 1) % n;
+        std::uint64_t remaining = i > 0 ? i - 1 : 0;
+        bool solvent = !player->bankrupt();
+        while (remaining > 0 && solvent) {
+            if (position == 0 && hasBeginning()) {
+                if (player->take(gift)) {
+                    ledger::atField(0);
+                    ledger::bankToPlayer(gift);
+                }
+                position = 1 % n;
+                remaining--;
+                continue;
+            }
+            if (position == lapStart && remaining >= n) {
+                // Pełne okrążenia: stan konta zmienia się o gift - lapFee na
+                // okrążenie, a okrążenie udaje się, jeśli na jego początku
+                // gracz ma co najmniej lapFee (Początek jest na końcu
+                // okrążenia, więc nawet hojny nie ratuje pierwszego).
+                std::uint64_t laps = remaining / n;
+                std::uint64_t money = player->getMoney();
+                if (money < lapFee) {
+                    laps = 0;
+                } else if (gift < lapFee) {
+                    laps = std::min(laps,
+                                    (money - lapFee) / (lapFee - gift) + 1);
+                }
+                if (laps > 0) {
+                    player->take(laps * gift);
+                    player->pay(laps * lapFee);
+                    passes.rangeAdd(lapStart, n, laps);
+                    ledger::atField(0);
+                    ledger::bankToPlayer(laps * gift);
+                    recordPasses(lapStart, n, laps);
+                    remaining -= laps * n;
+                    continue;
+                }
+            }
+            size_t end = std::min<std::uint64_t>(n, position + remaining);
+            solvent = passSegment(player, position, end);
+            remaining -= end - position;
+            position = end % n;
+        }
+
+        unsigned int destination = (player->getField() + i) % n;
+        player->move(destination);
+        unsigned int moneyBefore = player->getMoney();
+        landOnField(player, destination);
+        if (observer != nullptr) {
+            observer->onFieldAction(destination, moneyBefore, *player);
+        }
+    }
+
+    std::string getFieldName(unsigned int i) const override {
+        return fields.name(i);
+    }
+
+    unsigned int size() const override { return fields.size(); }
+
+    // Stan w tym samym formacie co Board: pula meczu albo licznik
+    // bukmachera. Wymaga przejścia po wszystkich polach.
+    BoardState getState() const override {
+        BoardState state(fields.size(), 0);
+        for (size_t i = 0; i < fields.size(); i++) {
+            state[i] = fields.type(i) == FieldType::Match ? pot(i)
+                                                          : fields.state(i);
+        }
+        return state;
+    }
+
+    void setState(BoardState const &state) override {
+        for (size_t i = 0; i < fields.size() && i < state.size(); i++) {
+            passBase[i] = passes.get(i);
+            fields.setState(i, state[i]);
+        }
+    }
+
+    void setObserver(FieldObserver *fieldObserver) override {
+        observer = fieldObserver;
+    }
+
+    std::shared_ptr<GameBoard> clone() const override {
+        auto copy = std::make_shared<HugeBoard>(*this);
+        copy->observer = nullptr;
+        return copy;
+    }
+
+    // Oprócz tablicy pól: sumy prefiksowe, drzewo Fenwicka i liczniki
+    // przejść z chwili wypłaty - razem 24 bajty na pole.
+    MemoryReport memoryUsage() const override {
+        MemoryReport report = fields.memoryUsage();
+        report.bytes += sizeof(*this) +
+                        feePrefix.capacity() * sizeof(std::uint64_t) +
+                        (fields.size() + 1) * sizeof(std::int64_t) +
+                        passBase.capacity() * sizeof(std::int64_t);
+        return report;
+    }
+};
+
+#endif
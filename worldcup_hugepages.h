@@ -0,0 +1,216 @@
+#ifndef WORLDCUP_HUGEPAGES_H
+#define WORLDCUP_HUGEPAGES_H
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+#include <vector>
+
+// Alokator dużych buforów (kolumny śladów, tablice bardzo dużych plansz,
+// korpusy skrótów) na dużych stronach. Przy buforach rzędu gigabajtów
+// z dostępem swobodnym (np. drzewo Fenwicka HugeBoard) zwykłe strony 4 KiB
+// wyczerpują TLB; strona 2 MiB lub 1 GiB obejmuje ich odpowiednio 512 lub
+// 262144.
+//
+// Małe przydziały (poniżej largeAllocation) idą przez operator new. Duże są
+// zawsze odwzorowywane przez mmap, niezależnie od polityki, więc zwolnienie
+// zależy tylko od rozmiaru, a politykę można zmieniać w trakcie pracy:
+// - Off: zwykłe strony, z madvise(MADV_NOHUGEPAGE), żeby jądro w trybie
+//   always nie podstawiło dużych stron (pomiar porównawczy byłby fałszywy);
+// - Transparent: obszar wyrównany do 2 MiB z madvise(MADV_HUGEPAGE)
+//   (transparent hugepages, jeśli jądro ma je w trybie madvise lub always);
+// - Explicit: MAP_HUGETLB (strony 1 GiB dla buforów od 1 GiB, w pozostałych
+//   przypadkach 2 MiB) z puli zarezerwowanej przez administratora; gdy pula
+//   jest pusta, jak Transparent.
+namespace hugepages {
+
+enum class Policy { Off, Transparent, Explicit };
+
+inline constexpr size_t largePage = size_t(2) << 20;
+inline constexpr size_t gigaPage = size_t(1) << 30;
+inline constexpr size_t largeAllocation = largePage;
+
+// Domyślna polityka ze zmiennej środowiskowej WORLDCUP_HUGEPAGES
+// ("off", "thp", "hugetlb"); bez niej Transparent.
+inline Policy policyFromEnvironment() {
+    char const *value = std::getenv("WORLDCUP_HUGEPAGES");
+    std::string_view name = value != nullptr ? value : "thp";
+    if (name == "off") {
+        return Policy::Off;
+    }
+    return name == "hugetlb" ? Policy::Explicit : Policy::Transparent;
+}
+
+inline std::atomic<Policy> &policy() {
+    static std::atomic<Policy> current(policyFromEnvironment());
+    return current;
+}
+
+inline void setPolicy(Policy value) { policy().store(value); }
+
+// Ile bajtów dużych buforów jest obecnie odwzorowanych w jaki sposób.
+struct Usage {
+    std::atomic<std::uint64_t> explicitBytes{0};
+    std::atomic<std::uint64_t> transparentBytes{0};
+    std::atomic<std::uint64_t> regularBytes{0};
+};
+
+inline Usage &usage() {
+    static Usage current;
+    return current;
+}
+
+// Długość odwzorowania dla przydziału o podanej liczbie bajtów (wielokrotność
+// rozmiaru strony, której mógł użyć MAP_HUGETLB).
+constexpr size_t mappedLength(size_t bytes) {
+    size_t page = bytes >= gigaPage ? gigaPage : largePage;
+    return (bytes + page - 1) / page * page;
+}
+
+namespace detail {
+    // Pierwsze 16 bajtów każdego dużego obszaru nie jest używane przez
+    // bufor: zapamiętujemy w nich sposób odwzorowania, żeby zwolnienie
+    // zmniejszyło właściwy licznik. Przesunięcie zachowuje wyrównanie
+    // max_align_t.
+    inline constexpr size_t headerSize = 16;
+
+    enum class Backing : std::uint8_t { Regular, Transparent, Explicit };
+
+    inline void *mapExplicit(size_t length) {
+#ifdef MAP_HUGETLB
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+        if (length % gigaPage == 0) {
+            void *giga = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                              flags | (30 << MAP_HUGE_SHIFT), -1, 0);
+            if (giga != MAP_FAILED) {
+                return giga;
+            }
+        }
+#endif
+        void *large =
+            mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        return large != MAP_FAILED ? large : nullptr;
+#else
+        (void)length;
+        return nullptr;
+#endif
+    }
+
+    // Obszar wyrównany do 2 MiB: odwzorowujemy o stronę więcej i odcinamy
+    // nadmiar z obu stron, żeby jądro mogło użyć całych dużych stron.
+    // Bez transparent prosimy jądro, żeby dużych stron nie używało.
+    inline void *mapAligned(size_t length, bool transparent) {
+        void *raw = mmap(nullptr, length + largePage, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return nullptr;
+        }
+        auto address = reinterpret_cast<std::uintptr_t>(raw);
+        std::uintptr_t aligned = (address + largePage - 1) & ~(largePage - 1);
+        if (aligned > address) {
+            munmap(raw, aligned - address);
+        }
+        size_t tail = address + largePage - aligned;
+        if (tail > 0) {
+            munmap(reinterpret_cast<void *>(aligned + length), tail);
+        }
+        void *result = reinterpret_cast<void *>(aligned);
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        madvise(result, length, transparent ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#else
+        (void)transparent;
+#endif
+        return result;
+    }
+
+    inline std::atomic<std::uint64_t> &counter(Backing backing) {
+        switch (backing) {
+            case Backing::Explicit:
+                return usage().explicitBytes;
+            case Backing::Transparent:
+                return usage().transparentBytes;
+            default:
+                return usage().regularBytes;
+        }
+    }
+
+    inline void *allocate(size_t bytes) {
+        if (bytes + headerSize < largeAllocation) {
+            return ::operator new(bytes);
+        }
+        size_t length = mappedLength(bytes + headerSize);
+        Policy current = policy().load(std::memory_order_relaxed);
+        Backing backing = Backing::Regular;
+        void *area = nullptr;
+        if (current == Policy::Explicit) {
+            area = mapExplicit(length);
+            backing = Backing::Explicit;
+        }
+        if (area == nullptr) {
+            backing = current == Policy::Off ? Backing::Regular
+                                             : Backing::Transparent;
+            area = mapAligned(length, backing == Backing::Transparent);
+        }
+        if (area == nullptr) {
+            throw std::bad_alloc();
+        }
+        *static_cast<Backing *>(area) = backing;
+        counter(backing).fetch_add(length, std::memory_order_relaxed);
+        return static_cast<char *>(area) + headerSize;
+    }
+
+    inline void deallocate(void *pointer, size_t bytes) {
+        if (bytes + headerSize < largeAllocation) {
+            ::operator delete(pointer);
+            return;
+        }
+        size_t length = mappedLength(bytes + headerSize);
+        void *area = static_cast<char *>(pointer) - headerSize;
+        counter(*static_cast<Backing *>(area))
+            .fetch_sub(length, std::memory_order_relaxed);
+        munmap(area, length);
+    }
+}  // namespace detail
+
+template <class T>
+class Allocator {
+   public:
+    using value_type = T;
+
+    static_assert(alignof(T) <= detail::headerSize);
+
+    Allocator() = default;
+
+    template <class U>
+    constexpr Allocator(Allocator<U> const &) noexcept {}
+
+    [[nodiscard]] T *allocate(size_t count) {
+        if (count > (SIZE_MAX - detail::headerSize) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T *>(detail::allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, size_t count) noexcept {
+        detail::deallocate(pointer, count * sizeof(T));
+    }
+
+    template <class U>
+    constexpr bool operator==(Allocator<U> const &) const noexcept {
+        return true;
+    }
+};
+
+}  // namespace hugepages
+
+// Wektor na duże bufory (duże strony według hugepages::policy()).
+template <class T>
+using HugeVector = std::vector<T, hugepages::Allocator<T>>;
+
+#endif
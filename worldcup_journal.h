@@ -0,0 +1,306 @@
+#ifndef WORLDCUP_JOURNAL_H
+#define WORLDCUP_JOURNAL_H
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Dziennik zapisu z wyprzedzeniem (WAL) z grupowym zatwierdzaniem oraz
+// migawki stanu, na których się opiera. Dziennik nie wie nic o treści
+// rekordów - interpretuje je GameHost.
+//
+// Katalog dziennika zawiera dwa pliki:
+// - "wal": nagłówek z numerem epoki (u64), a po nim rekordy w postaci
+//   długość (u32), skrót FNV-1a treści (u32), treść;
+// - "snapshot": migawka z numerem epoki, od której zaczyna się dziennik
+//   przyrostów po niej (zapisywana do pliku tymczasowego i podmieniana).
+//
+// Rekordy dopisywane przez append() (albo składane w miejscu między
+// beginRecord() i endRecord()) trafiają do bufora; commit() zapisuje bufor
+// jednym write() i wywołuje fdatasync(). Usługa wysyła odpowiedzi dopiero
+// po zatwierdzeniu, więc potwierdzone żądania przetrwają awarię. Odstęp
+// między zatwierdzeniami to co najmniej commitInterval, a przy wolnym
+// dysku tyle, żeby zatwierdzanie zajmowało najwyżej 1/commitShare czasu.
+// Przy odczycie rekordy za pierwszym uszkodzonym (np. urwanym przy awarii)
+// są odrzucane, a plik jest do tego miejsca przycinany.
+class GameJournal {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    // Największy rekord; większe append() odrzuca, bo recover() uznałby
+    // je za uszkodzone i odciął wraz ze wszystkimi następnymi.
+    static constexpr std::uint32_t maxRecord = 1 << 24;
+
+    // Odwrotność największej części czasu pracy usługi, jaką może zająć
+    // zatwierdzanie (zapis i fdatasync()).
+    static constexpr unsigned int commitShare = 20;
+
+   private:
+    std::filesystem::path directory;
+    Clock::duration commitInterval;
+    Clock::time_point lastCommit;
+    // Czas trwania ostatniego zatwierdzenia.
+    Clock::duration commitCost;
+    int fd;
+    std::uint64_t walEpoch;
+    std::uint64_t walBytes;
+    std::string pending;
+    // Początek nagłówka rekordu składanego w miejscu.
+    size_t recordStart;
+    static constexpr size_t headerSize = 2 * sizeof(std::uint32_t);
+
+    // FNV-1a po słowach 8-bajtowych, złożony do 32 bitów. Reszta krótsza
+    // niż słowo jest dopełniana zerami do jednego słowa, a długość wchodzi
+    // do wartości początkowej, więc dopełnienie nie zlewa się z treścią.
+    // Liczony dla każdego rekordu, więc bajt po bajcie był zauważalną
+    // częścią narzutu dziennika.
+    static std::uint32_t checksum(std::string_view data) {
+        constexpr std::uint64_t prime = 0x100000001b3u;
+        std::uint64_t hash = (0xcbf29ce484222325u ^ data.size()) * prime;
+        size_t i = 0;
+        for (; i + sizeof(std::uint64_t) <= data.size();
+             i += sizeof(std::uint64_t)) {
+            std::uint64_t word;
+            std::memcpy(&word, data.data() + i, sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+        if (i < data.size()) {
+            std::uint64_t word = 0;
+            std::memcpy(&word, data.data() + i, data.size() - i);
+            hash = (hash ^ word) * prime;
+        }
+        return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+    }
+
+    static void check(bool ok, char const *what) {
+        if (!ok) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+    }
+
+    void writeAll(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t n = ::write(fd, data.data(), data.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            check(n > 0, "journal write");
+            data.remove_prefix(n);
+        }
+    }
+
+    std::filesystem::path walPath() const { return directory / "wal"; }
+
+    std::filesystem::path snapshotPath() const {
+        return directory / "snapshot";
+    }
+
+    // Zaczyna pusty dziennik podanej epoki.
+    void reset(std::uint64_t epoch) {
+        check(::ftruncate(fd, 0) == 0, "journal truncate");
+        check(::lseek(fd, 0, SEEK_SET) == 0, "journal seek");
+        writeAll({reinterpret_cast<char const *>(&epoch), sizeof(epoch)});
+        check(::fdatasync(fd) == 0, "journal sync");
+        walEpoch = epoch;
+        walBytes = sizeof(epoch);
+    }
+
+   public:
+    GameJournal(std::filesystem::path directory,
+                std::chrono::microseconds commitInterval)
+        : directory(std::move(directory)),
+          commitInterval(commitInterval),
+          lastCommit(Clock::now()),
+          commitCost(0),
+          fd(-1),
+          walEpoch(0),
+          walBytes(0),
+          recordStart(0) {
+        std::filesystem::create_directories(this->directory);
+        fd = ::open(walPath().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        check(fd >= 0, "journal open");
+        std::uint64_t epoch = 0;
+        if (::pread(fd, &epoch, sizeof(epoch), 0) != sizeof(epoch)) {
+            reset(0);
+        } else {
+            walEpoch = epoch;
+            walBytes = ::lseek(fd, 0, SEEK_END);
+        }
+    }
+
+    GameJournal(GameJournal const &) = delete;
+    GameJournal &operator=(GameJournal const &) = delete;
+
+    ~GameJournal() {
+        try {
+            commit();
+        } catch (std::system_error const &) {
+        }
+        ::close(fd);
+    }
+
+    // Otwiera rekord składany w miejscu: treść należy dopisać do
+    // zwróconego bufora (bez zmieniania tego, co już w nim jest), a potem
+    // wywołać endRecord() albo dropRecord(). Oszczędza kopię rekordu
+    // budowanego w każdym kroku gry.
+    std::string &beginRecord() {
+        recordStart = pending.size();
+        pending.append(headerSize, '\0');
+        return pending;
+    }
+
+    // Rzuca std::length_error (i wycofuje rekord), gdy treść jest dłuższa
+    // niż maxRecord.
+    void endRecord() {
+        std::string_view record =
+            std::string_view(pending).substr(recordStart + headerSize);
+        if (record.size() > maxRecord) {
+            dropRecord();
+            throw std::length_error("journal record too large");
+        }
+        std::uint32_t header[2] = {static_cast<std::uint32_t>(record.size()),
+                                   checksum(record)};
+        std::memcpy(pending.data() + recordStart, header, sizeof(header));
+    }
+
+    void dropRecord() { pending.resize(recordStart); }
+
+    // Rzuca std::length_error dla rekordu dłuższego niż maxRecord.
+    void append(std::string_view record) {
+        if (record.size() > maxRecord) {
+            throw std::length_error("journal record too large");
+        }
+        beginRecord().append(record);
+        endRecord();
+    }
+
+    bool hasPending() const { return !pending.empty(); }
+
+    // Chwila, w której należy zatwierdzić oczekujące rekordy: po
+    // commitInterval od poprzedniego zatwierdzenia, ale nie wcześniej, niż
+    // gdy trwało ono 1/commitShare czasu od swojego początku.
+    Clock::time_point commitDeadline() const {
+        return lastCommit +
+               std::max(commitInterval, commitCost * (commitShare - 1));
+    }
+
+    // Zapisuje i utrwala oczekujące rekordy.
+    void commit() {
+        Clock::time_point start = Clock::now();
+        lastCommit = start;
+        if (pending.empty()) {
+            return;
+        }
+        writeAll(pending);
+        check(::fdatasync(fd) == 0, "journal sync");
+        walBytes += pending.size();
+        pending.clear();
+        lastCommit = Clock::now();
+        commitCost = lastCommit - start;
+    }
+
+    std::uint64_t size() const { return walBytes + pending.size(); }
+
+    // Rekordy zapisane po migawce (pusta lista, jeśli dziennik pochodzi
+    // sprzed migawki). Uszkodzony koniec pliku jest odcinany.
+    std::vector<std::string> recover(std::uint64_t snapshotEpoch) {
+        std::vector<std::string> records;
+        if (walEpoch < snapshotEpoch) {
+            reset(snapshotEpoch);
+            return records;
+        }
+        std::ifstream in(walPath(), std::ios::binary);
+        in.seekg(sizeof(std::uint64_t));
+        std::uint64_t valid = sizeof(std::uint64_t);
+        std::uint32_t header[2];
+        while (in.read(reinterpret_cast<char *>(header), sizeof(header)) &&
+               header[0] <= maxRecord) {
+            std::string record(header[0], '\0');
+            if (!in.read(record.data(), record.size()) ||
+                checksum(record) != header[1]) {
+                break;
+            }
+            valid += sizeof(header) + record.size();
+            records.push_back(std::move(record));
+        }
+        if (valid != walBytes) {
+            check(::ftruncate(fd, valid) == 0, "journal truncate");
+            check(::fdatasync(fd) == 0, "journal sync");
+            walBytes = valid;
+        }
+        check(::lseek(fd, 0, SEEK_END) >= 0, "journal seek");
+        return records;
+    }
+
+    // Ostatnia zapisana migawka: epoka i treść (epoka 0 i pusta treść, jeśli
+    // migawki nie ma).
+    std::pair<std::uint64_t, std::string> loadSnapshot() const {
+        std::ifstream in(snapshotPath(), std::ios::binary);
+        std::uint64_t epoch = 0;
+        std::uint32_t header[2];
+        if (!in.read(reinterpret_cast<char *>(&epoch), sizeof(epoch)) ||
+            !in.read(reinterpret_cast<char *>(header), sizeof(header))) {
+            return {0, ""};
+        }
+        std::string data(header[0], '\0');
+        if (!in.read(data.data(), data.size()) ||
+            checksum(data) != header[1]) {
+            throw std::runtime_error("corrupted snapshot");
+        }
+        return {epoch, data};
+    }
+
+    // Zapisuje migawkę stanu obejmującego wszystkie dotychczasowe rekordy
+    // i zaczyna nowy, pusty dziennik. Awaria w dowolnej chwili zostawia
+    // albo starą migawkę ze starym dziennikiem, albo nową migawkę (dziennik
+    // starszej epoki jest wtedy przy odtwarzaniu pomijany).
+    void writeSnapshot(std::string_view state) {
+        commit();
+        std::uint64_t epoch = walEpoch + 1;
+        std::filesystem::path temporary = directory / "snapshot.tmp";
+        int out = ::open(temporary.c_str(),
+                         O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        check(out >= 0, "snapshot open");
+        std::uint32_t header[2] = {static_cast<std::uint32_t>(state.size()),
+                                   checksum(state)};
+        std::string data(reinterpret_cast<char const *>(&epoch),
+                         sizeof(epoch));
+        data.append(reinterpret_cast<char const *>(header), sizeof(header));
+        data.append(state);
+        std::string_view rest = data;
+        while (!rest.empty()) {
+            ssize_t n = ::write(out, rest.data(), rest.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                ::close(out);
+                check(false, "snapshot write");
+            }
+            rest.remove_prefix(n);
+        }
+        bool synced = ::fsync(out) == 0;
+        ::close(out);
+        check(synced, "snapshot sync");
+        std::filesystem::rename(temporary, snapshotPath());
+        int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir >= 0) {
+            ::fsync(dir);
+            ::close(dir);
+        }
+        reset(epoch);
+    }
+};
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef WORLDCUP_LEDGER_H
+#define WORLDCUP_LEDGER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class Player;
+
+// Księga przepływów pieniędzy w podwójnym zapisie, do wyszukiwania błędów
+// rozliczeń (np. obcinania kwot w Player::pay). Pola zapisują każdy
+// przelew między graczem, pulą meczu i bankiem (nagrody, premie, opłaty)
+// jako jedną pozycję, a gra na każdej granicy rund porównuje salda
+// wynikające z księgi ze stanem kont graczy i pul.
+//
+// Księga istnieje tylko w kompilacji z -DWORLDCUP_LEDGER. Bez tej flagi
+// funkcje z przestrzeni ledger są puste, więc silnik kompiluje się do tej
+// samej postaci co bez księgi. Funkcje są constexpr, bo wołają je akcje
+// pól (w obliczeniach stałych księga jest pomijana).
+namespace ledger {
+
+using Account = std::uint32_t;
+
+// Bank: źródło nagród i premii, ujście kar i zakładów.
+inline constexpr Account bank = 0;
+
+inline constexpr Account potFlag = 0x80000000u;
+
+constexpr Account playerAccount(size_t seat) { return 1 + seat; }
+
+constexpr Account potAccount(size_t field) { return potFlag | field; }
+
+// Pozycja księgi: przelew amount z konta from na konto to (12 bajtów).
+struct Entry {
+    Account from;
+    Account to;
+    std::uint32_t amount;
+};
+
+// Niezgodność sald księgi ze stanem gry.
+class LedgerError : public std::logic_error {
+   public:
+    using std::logic_error::logic_error;
+};
+
+#ifdef WORLDCUP_LEDGER
+
+class Ledger {
+   public:
+    // Księga, do której trafiają przelewy pól w bieżącym wątku. Gra ustawia
+    // ją na czas rozgrywki (Scope).
+    static inline thread_local Ledger *current = nullptr;
+
+    class Scope {
+       public:
+        explicit Scope(Ledger &ledger) : previous(current) {
+            current = &ledger;
+        }
+
+        ~Scope() { current = previous; }
+
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+
+       private:
+        Ledger *previous;
+    };
+
+    // Zaczyna rozliczenie od sald otwarcia: players[s] - stan konta gracza
+    // na miejscu s, board - stan planszy (pule meczów), seats[s] - gracz na
+    // miejscu s (dla seatOf()).
+    void open(std::vector<std::int64_t> players,
+              std::vector<unsigned int> board,
+              std::vector<Player const *> seats = {}) {
+        flush();
+        openingPlayers = std::move(players);
+        openingBoard = std::move(board);
+        this->seats = std::move(seats);
+        balances.assign(1 + openingPlayers.size() + openingBoard.size(), 0);
+        usedPots.assign(openingBoard.size(), false);
+        recorded = 0;
+    }
+
+    // Miejsce gracza z chwili otwarcia księgi.
+    size_t seatOf(Player const *player) const {
+        return std::find(seats.begin(), seats.end(), player) - seats.begin();
+    }
+
+    size_t seatCount() const { return seats.size(); }
+
+    // Gracz wykonujący turę - druga strona przelewów pól.
+    void beginTurn(size_t seat) { actor = playerAccount(seat); }
+
+    // Pole, którego akcja jest wykonywana (konto puli meczu).
+    void atField(size_t field) { pot = potAccount(field); }
+
+    Account player() const { return actor; }
+
+    Account fieldPot() const { return pot; }
+
+    // Dopisuje pozycję do bufora; salda są przeliczane porcjami.
+    void transfer(Account from, Account to, std::uint32_t amount) {
+        if (amount == 0) {
+            return;
+        }
+        batch[pending] = {from, to, amount};
+        if (++pending == batch.size()) {
+            flush();
+        }
+    }
+
+    // Sprawdza zasadę zachowania pieniędzy przed rundą round (i po
+    // ostatniej rozegranej): saldo otwarcia
+    // plus przelewy z księgi musi być równe stanowi konta każdego gracza
+    // (players jak w open(), zbankrutowani mają 0) i każdej puli, na którą
+    // były przelewy. Rzuca LedgerError z opisem pierwszej niezgodności.
+    void check(unsigned int round, std::vector<std::int64_t> const &players,
+               std::vector<unsigned int> const &board) {
+        flush();
+        for (size_t seat = 0; seat < players.size(); seat++) {
+            expect(round, playerAccount(seat), openingPlayers[seat],
+                   players[seat]);
+        }
+        for (size_t field = 0; field < usedPots.size(); field++) {
+            if (usedPots[field]) {
+                expect(round, potAccount(field), openingBoard[field],
+                       field < board.size() ? board[field] : 0);
+            }
+        }
+    }
+
+    // Saldo konta od otwarcia (bank: ujemne, gdy wypłacił więcej, niż
+    // przyjął).
+    std::int64_t delta(Account account) {
+        flush();
+        return balances[slot(account)];
+    }
+
+    // Ostatnie (co najwyżej historySize) pozycje od otwarcia, od
+    // najstarszej - do diagnozy niezgodności.
+    std::vector<Entry> recentEntries() {
+        flush();
+        std::vector<Entry> recent;
+        size_t first = recorded > historySize ? recorded - historySize : 0;
+        for (size_t i = first; i < recorded; i++) {
+            recent.push_back(history[i % historySize]);
+        }
+        return recent;
+    }
+
+    // Liczba pozycji od otwarcia.
+    std::uint64_t entryCount() {
+        flush();
+        return recorded;
+    }
+
+    // Do sprawdzenia zasady zachowania wystarczą salda kont (balances), więc
+    // pełnej listy pozycji nie trzymamy - długa gra zajmowałaby pamięć bez
+    // ograniczeń. Zostaje pierścień ostatnich pozycji.
+    static constexpr size_t historySize = 256;
+
+   private:
+    std::array<Entry, 64> batch;
+    size_t pending = 0;
+    Account actor = bank;
+    Account pot = bank;
+    std::array<Entry, historySize> history;
+    std::uint64_t recorded = 0;
+    // Salda kont od otwarcia w jednej tablicy (slot()): bank, gracze według
+    // miejsc, a za nimi pule według pól planszy.
+    std::vector<std::int64_t> balances = {0};
+    // Pola, na których pule były przelewy (sprawdzane w check()).
+    std::vector<bool> usedPots;
+    std::vector<std::int64_t> openingPlayers;
+    std::vector<unsigned int> openingBoard;
+    std::vector<Player const *> seats;
+
+    size_t slot(Account account) const {
+        return (account & potFlag) != 0
+                   ? 1 + openingPlayers.size() + (account & ~potFlag)
+                   : account;
+    }
+
+    void flush() {
+        for (size_t i = 0; i < pending; i++) {
+            Entry const &entry = batch[i];
+            balances[slot(entry.from)] -= entry.amount;
+            balances[slot(entry.to)] += entry.amount;
+            for (Account account : {entry.from, entry.to}) {
+                if ((account & potFlag) != 0) {
+                    usedPots[account & ~potFlag] = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < pending; i++) {
+            history[recorded++ % historySize] = batch[i];
+        }
+        pending = 0;
+    }
+
+    void expect(unsigned int round, Account account, std::int64_t opening,
+                std::int64_t actual) {
+        std::int64_t expected = opening + balances[slot(account)];
+        if (expected != actual) {
+            std::string name =
+                (account & potFlag) != 0
+                    ? "pot " + std::to_string(account & ~potFlag)
+                    : "player " + std::to_string(account - 1);
+            throw LedgerError("ledger: before round " + std::to_string(round) +
+                              ", " + name + ": expected " +
+                              std::to_string(expected) + ", actual " +
+                              std::to_string(actual));
+        }
+    }
+};
+
+constexpr void atField(size_t field) {
+    if (!std::is_constant_evaluated() && Ledger::current != nullptr) {
+        Ledger::current->atField(field);
+    }
+}
+
+constexpr void bankToPlayer(std::uint32_t amount) {
+    if (std::is_constant_evaluated()) {
+        return;
+    }
+    if (Ledger *book = Ledger::current) {
+        book->transfer(bank, book->player(), amount);
+    }
+}
+
+constexpr void playerToBank(std::uint32_t amount) {
+    if (std::is_constant_evaluated()) {
+        return;
+    }
+    if (Ledger *book = Ledger::current) {
+        book->transfer(book->player(), bank, amount);
+    }
+}
+
+constexpr void playerToPot(std::uint32_t amount) {
+    if (std::is_constant_evaluated()) {
+        return;
+    }
+    if (Ledger *book = Ledger::current) {
+        book->transfer(book->player(), book->fieldPot(), amount);
+    }
+}
+
+// Wypłata wygranej meczu: cała pula trafia do gracza, a różnicę między
+// wygraną (pula razy waga) i pulą dopłaca bank (lub przejmuje, gdy waga
+// jest mniejsza od 1).
+constexpr void matchPrize(std::uint32_t pot, std::uint32_t prize) {
+    if (std::is_constant_evaluated()) {
+        return;
+    }
+    if (Ledger *book = Ledger::current) {
+        book->transfer(book->fieldPot(), book->player(), pot);
+        if (prize >= pot) {
+            book->transfer(bank, book->player(), prize - pot);
+        } else {
+            book->transfer(book->player(), bank, pot - prize);
+        }
+    }
+}
+
+#else
+
+// Bez księgi gra trzyma pusty obiekt i pusty zakres.
+class Ledger {
+   public:
+    class Scope {
+       public:
+        explicit Scope(Ledger &) {}
+    };
+};
+
+constexpr void atField(size_t) {}
+
+constexpr void bankToPlayer(std::uint32_t) {}
+
+constexpr void playerToBank(std::uint32_t) {}
+
+constexpr void playerToPot(std::uint32_t) {}
+
+constexpr void matchPrize(std::uint32_t, std::uint32_t) {}
+
+#endif
+
+}  // namespace ledger
+
+#endif
@@ -0,0 +1,35 @@
+#include <iostream>
+#include <string>
+
+#include "worldcup_loadgen.h"
+
+// Generator obciążenia: worldcup_loadgen [ścieżka gniazda lub -] [klienci]
+//                       [kroki na sekundę] [czas w sekundach] [gracze]
+//                       [rundy na krok] [odstępy: poisson lub stale]
+//                       [okres raportu w sekundach]
+// Liczba graczy musi mieścić się w zakresie przyjmowanym przez grę (od 2
+// do WorldCup2022::maxPlayers). Opis planu i pomiarów - worldcup_loadgen.h.
+int main(int argc, char *argv[]) {
+    loadgen::Options options;
+    if (argc > 1) options.path = argv[1];
+    if (argc > 2) options.clients = std::stoul(argv[2]);
+    if (argc > 3) options.rate = std::stod(argv[3]);
+    if (argc > 4) options.seconds = std::stod(argv[4]);
+    if (argc > 5) options.players = std::stoul(argv[5]);
+    if (argc > 6) options.rounds = std::stoul(argv[6]);
+    if (argc > 7) options.poisson = std::string(argv[7]) != "stale";
+    if (argc > 8) options.reportEvery = std::stod(argv[8]);
+    if (options.clients == 0 || options.rate <= 0 || options.players < 2 ||
+        options.players > WorldCup2022::maxPlayers ||
+        options.reportEvery <= 0) {
+        std::cerr << "invalid arguments\n";
+        return 1;
+    }
+
+    loadgen::LoadGenerator generator(options);
+    if (!generator.run(std::cout)) {
+        return 1;
+    }
+    generator.report(std::cout);
+    return 0;
+}
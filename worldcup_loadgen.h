@@ -0,0 +1,513 @@
+#ifndef WORLDCUP_LOADGEN_H
+#define WORLDCUP_LOADGEN_H
+
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worldcup_profiler.h"
+#include "worldcup_protocol.h"
+
+// Generator obciążenia. Każdy klient prowadzi po kolei własne gry: tworzy
+// grę, dodaje graczy, wysyła żądania Step, a po zakończeniu gry zamyka ją
+// i zaczyna nową. Ścieżka "-" oznacza gry prowadzone w tym samym procesie
+// (GameHost bez gniazda), co pozwala zmierzyć samą obsługę żądań bez
+// demona.
+//
+// Plan jest otwarty (open-loop): chwile wysłania kroków są wyznaczane
+// z góry, z odstępami wykładniczymi (proces Poissona) albo stałymi, o
+// średniej dającej łącznie zadaną liczbę kroków na sekundę. Nie zależą od
+// tego, czy poprzednie odpowiedzi już dotarły - żądania jednego klienta
+// idą potokowo. Opóźnienie kroku jest liczone od planowanej chwili
+// wysłania, więc gdy usługa nie nadąża, czas czekania w kolejce trafia do
+// wyników (bez tzw. coordinated omission). Kroki zaplanowane w czasie
+// zakładania nowej gry czekają na nią i ten czas też jest liczony. Osobno
+// podawany jest czas obsługi (od faktycznego wysłania żądania). Kroki
+// zakończone błędem mają własny histogram, żeby szybkie odmowy nie
+// zaniżały percentyli udanych kroków.
+//
+// Co okres raportu wypisuje przepustowość i percentyle opóźnienia z tego
+// okresu, a na koniec rozkład percentyli z całego pomiaru.
+namespace loadgen {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Phase { Creating, Adding, Ready, Closing, Failed };
+
+enum class Kind { Create, AddPlayer, Step, Close };
+
+struct Pending {
+    Kind kind;
+    Clock::time_point intended;
+    Clock::time_point sent;
+};
+
+struct Client {
+    int fd = -1;
+    Phase phase = Phase::Creating;
+    std::uint32_t game = 0;
+    unsigned int added = 0;
+    std::uint64_t seed = 0;
+    // Planowane chwile kroków, które czekają na gotową grę.
+    std::deque<Clock::time_point> due;
+    // Wysłane żądania w kolejności wysłania (i odpowiedzi).
+    std::deque<Pending> inFlight;
+    std::string input;
+    std::string output;
+    bool writing = false;
+};
+
+struct Options {
+    std::string path = "/tmp/worldcup.sock";
+    unsigned int clients = 100;
+    double rate = 10000;
+    double seconds = 10;
+    unsigned int players = 4;
+    unsigned int rounds = 1;
+    bool poisson = true;
+    double reportEvery = 1;
+};
+
+inline int connectTo(std::string const &path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(),
+                 sizeof(address.sun_path) - 1);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr *>(&address),
+                           sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+inline double micros(std::uint64_t nanos) { return nanos / 1e3; }
+
+// Otwarty plan kroków: kolejne planowane chwile wysłania kroków każdego
+// klienta. Plan nie zależy od odpowiedzi usługi.
+class OpenLoopSchedule {
+   public:
+    using Slot = std::pair<Clock::time_point, size_t>;
+
+   private:
+    std::chrono::duration<double> meanInterval;
+    bool poisson;
+    std::mt19937_64 random;
+    std::exponential_distribution<double> exponential;
+    // Następny planowany krok każdego klienta.
+    std::priority_queue<Slot, std::vector<Slot>, std::greater<Slot>> slots;
+
+    Clock::duration think() {
+        double interval = meanInterval.count();
+        if (poisson) {
+            interval *= exponential(random);
+        }
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(interval));
+    }
+
+   public:
+    // Łącznie rate kroków na sekundę od clients klientów, od chwili start.
+    OpenLoopSchedule(size_t clients, double rate, bool poisson,
+                     Clock::time_point start)
+        : meanInterval(clients / rate),
+          poisson(poisson),
+          random(1),
+          exponential(1.0) {
+        for (size_t id = 0; id < clients; id++) {
+            // Przy stałych odstępach klienci są rozłożeni równomiernie
+            // w pierwszym odstępie.
+            Clock::duration first =
+                poisson ? think()
+                        : std::chrono::duration_cast<Clock::duration>(
+                              meanInterval * id / clients);
+            slots.emplace(start + first, id);
+        }
+    }
+
+    // Najbliższy planowany krok.
+    Slot const &next() const { return slots.top(); }
+
+    // Zdejmuje najbliższy krok i planuje następny krok tego klienta.
+    Slot advance() {
+        Slot slot = slots.top();
+        slots.pop();
+        slots.emplace(slot.first + think(), slot.second);
+        return slot;
+    }
+};
+
+// Opóźnienia kroków. Udane trafiają do response i okna raportu (od
+// planowanej chwili wysłania) oraz do service (od faktycznego wysłania),
+// a zakończone błędem tylko do failed (od planowanej chwili wysłania).
+struct StepLatencies {
+    LatencyHistogram response;
+    LatencyHistogram service;
+    LatencyHistogram window;
+    LatencyHistogram failed;
+
+    void record(Pending const &pending, Clock::time_point now, bool ok) {
+        auto nanos = [now](Clock::time_point since) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(now -
+                                                                        since)
+                .count();
+        };
+        if (!ok) {
+            failed.record(nanos(pending.intended));
+            return;
+        }
+        response.record(nanos(pending.intended));
+        window.record(nanos(pending.intended));
+        service.record(nanos(pending.sent));
+    }
+};
+
+class LoadGenerator {
+   private:
+    Options options;
+    std::vector<Client> clients;
+    std::optional<OpenLoopSchedule> schedule;
+    int epoll = -1;
+    // Gry prowadzone w procesie (ścieżka "-") i kolejka żądań do nich.
+    std::unique_ptr<GameHost> local;
+    std::deque<std::pair<size_t, std::string>> localRequests;
+
+    StepLatencies latencies;
+    std::uint64_t errors = 0;
+    std::uint64_t finishedGames = 0;
+
+    // Wysyła ile się da; gdy coś zostanie, czeka na EPOLLOUT.
+    bool flush(Client &client, size_t id) {
+        size_t sent = 0;
+        while (sent < client.output.size()) {
+            ssize_t n = ::send(client.fd, client.output.data() + sent,
+                               client.output.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                return false;
+            }
+            sent += n;
+        }
+        client.output.erase(0, sent);
+        bool pending = !client.output.empty();
+        if (pending != client.writing) {
+            client.writing = pending;
+            epoll_event event{};
+            event.events = EPOLLIN;
+            if (pending) {
+                event.events |= EPOLLOUT;
+            }
+            event.data.u64 = id;
+            epoll_ctl(epoll, EPOLL_CTL_MOD, client.fd, &event);
+        }
+        return true;
+    }
+
+    bool send(size_t id, Kind kind, ProtocolWriter const &request,
+              Clock::time_point intended) {
+        Client &client = clients[id];
+        client.inFlight.push_back({kind, intended, Clock::now()});
+        if (local != nullptr) {
+            localRequests.emplace_back(id, request.payload());
+            return true;
+        }
+        appendFrame(client.output, request.payload());
+        return flush(client, id);
+    }
+
+    bool create(size_t id) {
+        Client &client = clients[id];
+        client.phase = Phase::Creating;
+        return send(id, Kind::Create,
+                    ProtocolWriter().op(Opcode::Create).u64(client.seed++),
+                    Clock::now());
+    }
+
+    // Wysyła zaległe kroki, jeśli gra jest gotowa.
+    bool pump(size_t id) {
+        Client &client = clients[id];
+        for (; client.phase == Phase::Ready && !client.due.empty();
+             client.due.pop_front()) {
+            if (!send(id, Kind::Step,
+                      ProtocolWriter()
+                          .op(Opcode::Step)
+                          .u32(client.game)
+                          .u32(options.rounds),
+                      client.due.front())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool onResponse(size_t id, std::string const &payload) {
+        Client &client = clients[id];
+        if (client.inFlight.empty()) {
+            return false;
+        }
+        Pending pending = client.inFlight.front();
+        client.inFlight.pop_front();
+        Clock::time_point now = Clock::now();
+        ProtocolReader in(payload);
+        bool ok = in.status() == Status::Ok;
+        if (pending.kind == Kind::Step) {
+            latencies.record(pending, now, ok);
+        }
+        // Po błędzie klient czeka na pozostałe odpowiedzi i zaczyna
+        // nową grę.
+        if (!ok) {
+            errors++;
+            client.phase = Phase::Failed;
+        }
+        if (client.phase == Phase::Failed) {
+            return !client.inFlight.empty() || create(id);
+        }
+        switch (pending.kind) {
+            case Kind::Create:
+                client.game = in.u32();
+                client.phase = Phase::Adding;
+                client.added = 0;
+                for (unsigned int seat = 0; seat < options.players;
+                     seat++) {
+                    if (!send(id, Kind::AddPlayer,
+                              ProtocolWriter()
+                                  .op(Opcode::AddPlayer)
+                                  .u32(client.game)
+                                  .str(seatName(seat)),
+                              now)) {
+                        return false;
+                    }
+                }
+                return true;
+            case Kind::AddPlayer:
+                if (++client.added == options.players) {
+                    client.phase = Phase::Ready;
+                    return pump(id);
+                }
+                return true;
+            case Kind::Step:
+                in.u32();
+                if (in.u8() == 0 && client.phase == Phase::Ready) {
+                    finishedGames++;
+                    client.phase = Phase::Closing;
+                    return send(
+                        id, Kind::Close,
+                        ProtocolWriter().op(Opcode::Close).u32(client.game),
+                        now);
+                }
+                return true;
+            case Kind::Close:
+                return create(id);
+        }
+        return false;
+    }
+
+    bool receive(size_t id) {
+        Client &client = clients[id];
+        char buffer[1 << 16];
+        for (;;) {
+            ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                client.input.append(buffer, n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            return false;
+        }
+        std::string payload;
+        size_t offset = 0;
+        while (takeFrame(client.input, payload, offset)) {
+            if (!onResponse(id, payload)) {
+                return false;
+            }
+        }
+        client.input.erase(0, offset);
+        return flush(client, id);
+    }
+
+    // Obsługuje żądania do gier prowadzonych w procesie (także te
+    // wysłane w trakcie obsługi).
+    bool serve() {
+        while (!localRequests.empty()) {
+            auto [id, request] = std::move(localRequests.front());
+            localRequests.pop_front();
+            if (!onResponse(id, local->handle(request))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Czeka na odpowiedzi co najwyżej do podanej chwili.
+    bool wait(Clock::time_point wake) {
+        auto timeout = std::max(wake - Clock::now(), Clock::duration(0));
+        if (local != nullptr) {
+            std::this_thread::sleep_for(timeout);
+            return true;
+        }
+        auto nanos =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)
+                .count();
+        timespec limit{static_cast<time_t>(nanos / 1000000000),
+                       static_cast<long>(nanos % 1000000000)};
+        epoll_event events[256];
+        int ready = epoll_pwait2(epoll, events, 256, &limit, nullptr);
+        for (int i = 0; i < ready; i++) {
+            size_t id = events[i].data.u64;
+            bool alive = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                alive = receive(id);
+            } else if (events[i].events & EPOLLOUT) {
+                alive = flush(clients[id], id);
+            }
+            if (!alive) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void reportWindow(double from, double to, std::ostream &out) {
+        out << std::fixed << std::setprecision(1) << "t=" << to
+            << "s steps=" << latencies.window.count()
+            << " rate=" << latencies.window.count() / (to - from)
+            << "/s p50=" << micros(latencies.window.percentile(50))
+            << "us p99=" << micros(latencies.window.percentile(99))
+            << "us max=" << micros(latencies.window.max()) << "us\n"
+            << std::defaultfloat;
+        latencies.window = LatencyHistogram();
+    }
+
+   public:
+    explicit LoadGenerator(Options options)
+        : options(options), clients(options.clients) {}
+
+    ~LoadGenerator() {
+        for (auto const &client : clients) {
+            if (client.fd >= 0) {
+                close(client.fd);
+            }
+        }
+        if (epoll >= 0) {
+            close(epoll);
+        }
+    }
+
+    bool run(std::ostream &out) {
+        // Domyślny luz budzika (50 us) opóźniałby wysyłanie względem
+        // planu, a to opóźnienie trafiałoby do wyników.
+        prctl(PR_SET_TIMERSLACK, 1);
+        if (options.path == "-") {
+            local = std::make_unique<GameHost>();
+        } else {
+            epoll = epoll_create1(EPOLL_CLOEXEC);
+        }
+        Clock::time_point start = Clock::now();
+        schedule.emplace(clients.size(), options.rate, options.poisson, start);
+        for (size_t id = 0; id < clients.size(); id++) {
+            Client &client = clients[id];
+            client.seed = static_cast<std::uint64_t>(id) << 32;
+            if (local == nullptr) {
+                client.fd = connectTo(options.path);
+                if (client.fd < 0) {
+                    std::cerr << "cannot connect to " << options.path
+                              << '\n';
+                    return false;
+                }
+                epoll_event event{};
+                event.events = EPOLLIN;
+                event.data.u64 = id;
+                epoll_ctl(epoll, EPOLL_CTL_ADD, client.fd, &event);
+            }
+            if (!create(id)) {
+                std::cerr << "connection lost\n";
+                return false;
+            }
+        }
+
+        auto after = [start](double seconds) {
+            return start + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(seconds));
+        };
+        Clock::time_point end = after(options.seconds);
+        unsigned int windows = 1;
+        Clock::time_point nextReport = after(options.reportEvery);
+        for (Clock::time_point now = start; now < end;
+             now = Clock::now()) {
+            while (schedule->next().first <= now) {
+                auto [due, id] = schedule->advance();
+                clients[id].due.push_back(due);
+                if (!pump(id)) {
+                    std::cerr << "connection lost\n";
+                    return false;
+                }
+            }
+            if (local != nullptr && !serve()) {
+                std::cerr << "unexpected response\n";
+                return false;
+            }
+            if (now >= nextReport) {
+                reportWindow((windows - 1) * options.reportEvery,
+                             windows * options.reportEvery, out);
+                nextReport = after(++windows * options.reportEvery);
+            }
+            if (!wait(std::min({end, schedule->next().first, nextReport}))) {
+                std::cerr << "connection lost\n";
+                return false;
+            }
+        }
+        double last = (windows - 1) * options.reportEvery;
+        if (last < options.seconds) {
+            reportWindow(last, options.seconds, out);
+        }
+        return true;
+    }
+
+    void report(std::ostream &out) const {
+        out << std::fixed << std::setprecision(1)
+            << "steps=" << latencies.response.count()
+            << " failed=" << latencies.failed.count() << " errors=" << errors
+            << " games=" << finishedGames << " rate="
+            << latencies.response.count() / options.seconds << "/s\n"
+            << "percentile\tresponse[us]\tservice[us]\tfailed[us]\n";
+        for (double p : {50.0, 90.0, 99.0, 99.9, 99.99}) {
+            out << std::setprecision(2) << p << std::setprecision(1)
+                << '\t' << micros(latencies.response.percentile(p)) << '\t'
+                << micros(latencies.service.percentile(p)) << '\t'
+                << micros(latencies.failed.percentile(p)) << '\n';
+        }
+        out << "max\t" << micros(latencies.response.max()) << '\t'
+            << micros(latencies.service.max()) << '\t'
+            << micros(latencies.failed.max()) << '\n'
+            << std::defaultfloat;
+    }
+
+    StepLatencies const &stepLatencies() const { return latencies; }
+
+    // Liczba odpowiedzi z błędem (na wszystkie rodzaje żądań).
+    std::uint64_t errorCount() const { return errors; }
+};
+}  // namespace loadgen
+
+#endif
@@ -0,0 +1,40 @@
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worldcup_trace.h"
+
+// Narzędzie: worldcup_logtrace [liczba wątków] dziennik...
+// Zamienia dzienniki tablicy wyników tekstowej (standardowy układ
+// planszy) na pliki śladów kolumnowych (nazwa dziennika z dopisanym
+// ".trace") i wypisuje przepustowość.
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " threads log...\n";
+        return 1;
+    }
+    unsigned int threads = std::stoul(argv[1]);
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    std::vector<std::filesystem::path> logs(argv + 2, argv + argc);
+
+    try {
+        TextLogParser parser;
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t bytes = convertLogs(logs, parser, threads);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << logs.size() << " logs, " << bytes << " bytes in "
+                  << std::fixed << std::setprecision(3) << elapsed.count()
+                  << " s (" << bytes / elapsed.count() / 1e6 << " MB/s)\n";
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
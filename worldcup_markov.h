@@ -0,0 +1,261 @@
+#ifndef WORLDCUP_MARKOV_H
+#define WORLDCUP_MARKOV_H
+
+#include <algorithm>
+#include <barrier>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "worldcup2022.h"
+
+// Rozkład długości gry dwóch graczy na planszy o danym układzie.
+//
+// Gra jest łańcuchem Markowa, którego stanem są stany obu graczy i wszystkich
+// pól (pule meczów, licznik bukmachera). Bankructwo któregoś z graczy kończy
+// grę, więc takie stany są pochłaniające. Rozkład prawdopodobieństwa po
+// stanach trzymamy jako wektor rzadki, a jedną rundę liczymy jako iloczyn
+// macierzy przejścia przez ten wektor. Macierzy nie budujemy jawnie -
+// przejścia wyznacza ta sama plansza, na której toczy się zwykła gra, dzięki
+// czemu semantyka (zaokrąglenia, kolejność pól) jest identyczna z play().
+//
+// Liczba osiągalnych stanów rośnie wykładniczo z liczbą rund (głównie przez
+// stan konta graczy), więc dokładny wynik jest osiągalny tylko dla krótkich
+// horyzontów. Dłuższe są liczone w przybliżeniu, które wynik opisuje jawnie:
+// - po przekroczeniu maxStates odrzucamy najmniej prawdopodobne stany;
+//   odrzucona masa ogranicza błąd (zob. Result::errorBound);
+// - moneyBucket > 1 zaokrągla stan konta do wielokrotności kubełka po
+//   każdej turze - wynik jest wtedy dokładny dla łańcucha z zaokrąglaniem,
+//   ale jego odległości od gry bez zaokrągleń nie ograniczamy.
+class GameLengthSolver {
+   public:
+    struct Result {
+        // endsInRound[r] - prawdopodobieństwo, że gra skończy się bankructwem
+        // w rundzie o numerze r.
+        std::vector<double> endsInRound;
+        // Masa prawdopodobieństwa gier trwających dłużej niż maxRounds.
+        double unfinished;
+        // Ograniczenie błędu odrzucania stanów: prawdziwe wartości
+        // endsInRound[r] i unfinished leżą w [wynik, wynik + errorBound],
+        // a suma błędów bezwzględnych nie przekracza errorBound.
+        double errorBound;
+        // Czy wynik jest dokładny (nic nie odrzucono i bez kubełków).
+        bool exact;
+        // Największa liczba jednoczesnych stanów w trakcie obliczeń.
+        size_t peakStates;
+    };
+
+   private:
+    // Pierwsze dwa razy po 4 liczby to stany graczy, dalej stany pól.
+    static constexpr size_t playerSlots = 4;
+
+    using State = std::vector<unsigned int>;
+
+    struct StateHash {
+        size_t operator()(State const &state) const {
+            std::uint64_t hash = 0xcbf29ce484222325ULL;
+            for (unsigned int value : state) {
+                hash = (hash ^ value) * 0x100000001b3ULL;
+            }
+            return hash;
+        }
+    };
+
+    using Distribution = std::unordered_map<State, double, StateHash>;
+
+    std::vector<FieldSpec> layout;
+    std::vector<std::pair<unsigned int, double>> rolls;
+    unsigned int threads;
+    size_t maxStates;
+    unsigned int moneyBucket;
+
+    void storePlayer(State &state, size_t slot, PlayerState const &p) const {
+        unsigned int money = p.money;
+        if (moneyBucket > 1) {
+            money = (money + moneyBucket / 2) / moneyBucket * moneyBucket;
+        }
+        state[slot * playerSlots] = money;
+        state[slot * playerSlots + 1] = p.field;
+        state[slot * playerSlots + 2] = p.suspension;
+        state[slot * playerSlots + 3] = p.bankrupted;
+    }
+
+    static PlayerState loadPlayer(State const &state, size_t slot) {
+        return {state[slot * playerSlots], state[slot * playerSlots + 1],
+                state[slot * playerSlots + 2],
+                state[slot * playerSlots + 3] != 0};
+    }
+
+    static BoardState loadBoard(State const &state) {
+        return BoardState(state.begin() + 2 * playerSlots, state.end());
+    }
+
+    static void storeBoard(State &state, BoardState const &board) {
+        std::copy(board.begin(), board.end(), state.begin() + 2 * playerSlots);
+    }
+
+    // Wykonuje turę gracza slot we wszystkich wariantach rzutu i przekazuje
+    // powstałe stany (z prawdopodobieństwami) dalej.
+    void turn(Board &board, State const &state, double probability,
+              size_t slot,
+              std::function<void(State const &, double)> const &emit) const {
+        Player player("", loadPlayer(state, slot));
+        player.waitIfNeeded();
+        if (player.waiting()) {
+            State next = state;
+            storePlayer(next, slot, player.getState());
+            emit(next, probability);
+            return;
+        }
+        BoardState const before = loadBoard(state);
+        PlayerState const waited = player.getState();
+        for (auto const &[roll, rollProbability] : rolls) {
+            Player moved("", waited);
+            board.setState(before);
+            board.playerMove(&moved, roll);
+            State next = state;
+            storePlayer(next, slot, moved.getState());
+            storeBoard(next, board.getState());
+            emit(next, probability * rollProbability);
+        }
+    }
+
+    // Jedna runda dla fragmentu rozkładu. Gry zakończone w tej rundzie
+    // zwiększają ended, pozostałe trafiają do next.
+    void round(std::vector<std::pair<State, double>> const &current,
+               size_t begin, size_t end, Distribution &next,
+               double &ended) const {
+        Board board(layout);
+        for (size_t i = begin; i < end; i++) {
+            turn(board, current[i].first, current[i].second, 0,
+                 [&](State const &afterFirst, double p) {
+                     if (loadPlayer(afterFirst, 0).bankrupted) {
+                         ended += p;
+                         return;
+                     }
+                     turn(board, afterFirst, p, 1,
+                          [&](State const &afterSecond, double q) {
+                              if (loadPlayer(afterSecond, 1).bankrupted) {
+                                  ended += q;
+                              } else {
+                                  next[afterSecond] += q;
+                              }
+                          });
+                 });
+        }
+    }
+
+   public:
+    // dieFaces[k] to prawdopodobieństwo wyrzucenia k oczek jedną kostką.
+    // Gra używa dwóch kostek, więc rozkład sumy liczymy jako splot.
+    explicit GameLengthSolver(std::vector<double> const &dieFaces,
+                              unsigned int threads = 1,
+                              size_t maxStates = 1 << 20,
+                              unsigned int moneyBucket = 1,
+                              std::vector<FieldSpec> layout = defaultLayout())
+        : layout(std::move(layout)),
+          rolls(),
+          threads(threads > 0 ? threads : 1),
+          maxStates(maxStates),
+          moneyBucket(moneyBucket) {
+        std::vector<double> sum(2 * dieFaces.size(), 0.0);
+        for (size_t a = 0; a < dieFaces.size(); a++) {
+            for (size_t b = 0; b < dieFaces.size(); b++) {
+                sum[a + b] += dieFaces[a] * dieFaces[b];
+            }
+        }
+        for (size_t total = 0; total < sum.size(); total++) {
+            if (sum[total] > 0) {
+                rolls.emplace_back(total, sum[total]);
+            }
+        }
+    }
+
+    // Rundy liczy stała pula threads wątków (wraz z wywołującym), która
+    // dzieli między siebie stany bieżącego rozkładu.
+    Result solve(unsigned int maxRounds) const {
+        Board board(layout);
+        State start(2 * playerSlots + layout.size(), 0);
+        storePlayer(start, 0, Player("").getState());
+        storePlayer(start, 1, Player("").getState());
+        storeBoard(start, board.getState());
+
+        Result result{{}, 0.0, 0.0, moneyBucket <= 1, 1};
+        std::vector<std::pair<State, double>> current{{start, 1.0}};
+        std::vector<Distribution> partial(threads);
+        std::vector<double> ended(threads, 0.0);
+
+        bool finished = false;
+        std::barrier sync(threads);
+        auto work = [&](unsigned int w) {
+            size_t chunk = (current.size() + threads - 1) / threads;
+            size_t begin = std::min(current.size(), w * chunk);
+            size_t end = std::min(current.size(), begin + chunk);
+            round(current, begin, end, partial[w], ended[w]);
+        };
+        std::vector<std::jthread> pool;
+        for (unsigned int w = 1; w < threads; w++) {
+            pool.emplace_back([&, w] {
+                for (;;) {
+                    sync.arrive_and_wait();
+                    if (finished) {
+                        return;
+                    }
+                    work(w);
+                    sync.arrive_and_wait();
+                }
+            });
+        }
+
+        for (unsigned int r = 0; r < maxRounds && !current.empty(); r++) {
+            for (unsigned int w = 0; w < threads; w++) {
+                partial[w].clear();
+                ended[w] = 0.0;
+            }
+            sync.arrive_and_wait();
+            work(0);
+            sync.arrive_and_wait();
+
+            Distribution next = std::move(partial[0]);
+            for (unsigned int w = 1; w < threads; w++) {
+                for (auto &[state, p] : partial[w]) {
+                    next[state] += p;
+                }
+            }
+            double endedNow = 0.0;
+            for (double p : ended) {
+                endedNow += p;
+            }
+            result.endsInRound.push_back(endedNow);
+
+            current.assign(next.begin(), next.end());
+            if (current.size() > maxStates) {
+                // Zostawiamy najbardziej prawdopodobne stany.
+                std::nth_element(current.begin(),
+                                 current.begin() + maxStates, current.end(),
+                                 [](auto const &a, auto const &b) {
+                                     return a.second > b.second;
+                                 });
+                for (size_t i = maxStates; i < current.size(); i++) {
+                    result.errorBound += current[i].second;
+                }
+                current.resize(maxStates);
+                result.exact = false;
+            }
+            result.peakStates = std::max(result.peakStates, current.size());
+        }
+        finished = true;
+        sync.arrive_and_wait();
+        pool.clear();
+
+        for (auto const &entry : current) {
+            result.unfinished += entry.second;
+        }
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef WORLDCUP_PROFILER_H
+#define WORLDCUP_PROFILER_H
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "worldcup.h"
+
+// Histogram opóźnień w stylu HDR: kubełki logarytmiczne (potęgi dwójki),
+// każdy podzielony na 8 liniowych pod-kubełków. Błąd względny odczytanego
+// percentyla nie przekracza 12.5%, a rozmiar histogramu jest stały.
+class LatencyHistogram {
+   private:
+    static constexpr unsigned int subBuckets = 8;
+    static constexpr unsigned int bucketCount = 62 * subBuckets;
+
+    std::array<std::uint64_t, bucketCount> counts{};
+    std::uint64_t samples = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t maximum = 0;
+
+    static constexpr unsigned int bucketOf(std::uint64_t value) {
+        if (value < subBuckets) {
+            return value;
+        }
+        unsigned int exponent = std::bit_width(value) - 1;
+        unsigned int shift = exponent - 3;
+        return (exponent - 2) * subBuckets + (value >> shift) - subBuckets;
+    }
+
+    static constexpr std::uint64_t lowerBound(unsigned int bucket) {
+        if (bucket < subBuckets) {
+            return bucket;
+        }
+        unsigned int exponent = bucket / subBuckets + 2;
+        std::uint64_t mantissa = bucket % subBuckets + subBuckets;
+        return mantissa << (exponent - 3);
+    }
+
+   public:
+    void record(std::uint64_t nanos) {
+        counts[bucketOf(nanos)]++;
+        samples++;
+        sum += nanos;
+        if (nanos > maximum) {
+            maximum = nanos;
+        }
+    }
+
+    void merge(LatencyHistogram const &other) {
+        for (unsigned int i = 0; i < bucketCount; i++) {
+            counts[i] += other.counts[i];
+        }
+        samples += other.samples;
+        sum += other.sum;
+        if (other.maximum > maximum) {
+            maximum = other.maximum;
+        }
+    }
+
+    std::uint64_t count() const { return samples; }
+
+    std::uint64_t max() const { return maximum; }
+
+    double mean() const {
+        return samples == 0 ? 0.0 : static_cast<double>(sum) / samples;
+    }
+
+    // Zwraca dolną granicę kubełka, w którym wypada percentyl p (0 - 100).
+    std::uint64_t percentile(double p) const {
+        if (samples == 0) {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(p / 100.0 * (samples - 1));
+        std::uint64_t seen = 0;
+        for (unsigned int i = 0; i < bucketCount; i++) {
+            seen += counts[i];
+            if (seen > rank) {
+                return lowerBound(i);
+            }
+        }
+        return maximum;
+    }
+};
+
+// Statystyki jednego rodzaju wywołań zwrotnych (kostki lub tablica wyników).
+// Mierzone jest tylko co sampleEvery-te wywołanie, a łączny czas jest
+// szacowany jako średnia z próbek razy liczba wszystkich wywołań. Dzięki temu
+// narzut pomiaru (dwa odczyty zegara) rozkłada się na wiele wywołań.
+class CallbackProfile {
+   private:
+    LatencyHistogram histogram;
+    std::uint64_t calls;
+    unsigned int sampleEvery;
+    // Wywołania do następnej próbki (odliczanie zamiast dzielenia modulo
+    // w każdym wywołaniu).
+    unsigned int untilSample;
+
+   public:
+    explicit CallbackProfile(unsigned int sampleEvery)
+        : histogram(),
+          calls(0),
+          sampleEvery(sampleEvery > 0 ? sampleEvery : 1),
+          untilSample(1) {}
+
+    bool nextCallSampled() {
+        calls++;
+        if (--untilSample != 0) {
+            return false;
+        }
+        untilSample = sampleEvery;
+        return true;
+    }
+
+    void record(std::uint64_t nanos) { histogram.record(nanos); }
+
+    std::uint64_t callCount() const { return calls; }
+
+    double estimatedTotalNanos() const { return histogram.mean() * calls; }
+
+    LatencyHistogram const &latencies() const { return histogram; }
+};
+
+// Mierzy czas wykonania bloku, jeśli profil zdecydował o próbkowaniu.
+// Używamy steady_clock zamiast rdtsc, bo jest przenośny i monotoniczny.
+class SampledTimer {
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    CallbackProfile *profile;
+    bool sampled;
+    Clock::time_point start;
+
+   public:
+    explicit SampledTimer(CallbackProfile *profile)
+        : profile(profile), sampled(profile->nextCallSampled()), start() {
+        if (sampled) {
+            start = Clock::now();
+        }
+    }
+
+    SampledTimer(SampledTimer const &) = delete;
+    SampledTimer &operator=(SampledTimer const &) = delete;
+
+    ~SampledTimer() {
+        if (sampled) {
+            auto elapsed = Clock::now() - start;
+            profile->record(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count());
+        }
+    }
+};
+
+// Dekorator kostki mierzący czas rzutów. Gra nie wie o pomiarze, więc nie
+// trzeba zmieniać silnika, żeby włączyć lub wyłączyć instrumentację.
+class ProfiledDie : public Die {
+   private:
+    std::shared_ptr<Die> const die;
+    std::shared_ptr<CallbackProfile> const profile;
+
+   public:
+    ProfiledDie(std::shared_ptr<Die> die,
+                std::shared_ptr<CallbackProfile> profile)
+        : die(std::move(die)), profile(std::move(profile)) {}
+
+    [[nodiscard]] unsigned short roll() const override {
+        SampledTimer timer(profile.get());
+        return die->roll();
+    }
+};
+
+// Dekorator tablicy wyników mierzący czas wszystkich jej wywołań.
+class ProfiledScoreBoard : public ScoreBoard {
+   private:
+    std::shared_ptr<ScoreBoard> const scoreboard;
+    std::shared_ptr<CallbackProfile> const profile;
+
+   public:
+    ProfiledScoreBoard(std::shared_ptr<ScoreBoard> scoreboard,
+                       std::shared_ptr<CallbackProfile> profile)
+        : scoreboard(std::move(scoreboard)), profile(std::move(profile)) {}
+
+    void onRound(unsigned int roundNo) override {
+        SampledTimer timer(profile.get());
+        scoreboard->onRound(roundNo);
+    }
+
+    void onTurn(std::string const &playerName, std::string const &playerStatus,
+                std::string const &squareName, unsigned int money) override {
+        SampledTimer timer(profile.get());
+        scoreboard->onTurn(playerName, playerStatus, squareName, money);
+    }
+
+    void onWin(std::string const &playerName) override {
+        SampledTimer timer(profile.get());
+        scoreboard->onWin(playerName);
+    }
+};
+
+// Profil gier: opakowuje kostki i tablicę wyników, mierzy całe wywołania
+// play() i przypisuje łączny czas silnikowi, kostkom oraz tablicy wyników.
+// Obiekt nie jest bezpieczny wielowątkowo - każdy wątek ma własny.
+//
+// Tura silnika trwa kilkanaście nanosekund, więc już samo przejście przez
+// dekorator (wywołanie wirtualne więcej) kosztowałoby kilka procent. Dlatego
+// profilowana jest co gameEvery-ta gra (pierwsza zawsze): tylko dla niej
+// wrap() zwraca dekoratory, a play() mierzy czas. Pozostałe gry dostają
+// oryginalne obiekty i idą bez odczytów zegara. wrap() dotyczy gry, którą
+// rozegra najbliższe play().
+class PlayProfiler {
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    std::shared_ptr<CallbackProfile> dice;
+    std::shared_ptr<CallbackProfile> scoreboard;
+    LatencyHistogram plays;
+    std::uint64_t playNanos;
+    unsigned int gameEvery;
+    std::uint64_t games;
+
+    bool profilingNextGame() const { return games % gameEvery == 0; }
+
+   public:
+    explicit PlayProfiler(unsigned int sampleEvery = 16,
+                          unsigned int gameEvery = 64)
+        : dice(std::make_shared<CallbackProfile>(sampleEvery)),
+          scoreboard(std::make_shared<CallbackProfile>(sampleEvery)),
+          plays(),
+          playNanos(0),
+          gameEvery(gameEvery > 0 ? gameEvery : 1),
+          games(0) {}
+
+    std::shared_ptr<Die> wrap(std::shared_ptr<Die> die) const {
+        if (die == nullptr || !profilingNextGame()) {
+            return die;
+        }
+        return std::make_shared<ProfiledDie>(std::move(die), dice);
+    }
+
+    std::shared_ptr<ScoreBoard> wrap(
+        std::shared_ptr<ScoreBoard> scoreboard) const {
+        if (scoreboard == nullptr || !profilingNextGame()) {
+            return scoreboard;
+        }
+        return std::make_shared<ProfiledScoreBoard>(std::move(scoreboard),
+                                                    this->scoreboard);
+    }
+
+    void play(WorldCup &worldCup, unsigned int rounds) {
+        if (!profilingNextGame()) {
+            games++;
+            worldCup.play(rounds);
+            return;
+        }
+        games++;
+        auto start = Clock::now();
+        try {
+            worldCup.play(rounds);
+        } catch (...) {
+            recordPlay(Clock::now() - start);
+            throw;
+        }
+        recordPlay(Clock::now() - start);
+    }
+
+    CallbackProfile const &diceProfile() const { return *dice; }
+
+    CallbackProfile const &scoreBoardProfile() const { return *scoreboard; }
+
+    // Czasy profilowanych gier.
+    LatencyHistogram const &playLatencies() const { return plays; }
+
+    // Wszystkie gry rozegrane przez play(), także nieprofilowane.
+    std::uint64_t gameCount() const { return games; }
+
+    double engineNanos() const {
+        double engine = playNanos - dice->estimatedTotalNanos() -
+                        scoreboard->estimatedTotalNanos();
+        return engine > 0 ? engine : 0;
+    }
+
+    void report(std::ostream &out) const {
+        double total = playNanos > 0 ? playNanos : 1;
+        auto line = [&](char const *name, double nanos) {
+            out << name << ": " << static_cast<std::uint64_t>(nanos) << " ns ("
+                << 100.0 * nanos / total << "%)\n";
+        };
+        auto latencies = [&](char const *name, CallbackProfile const &profile) {
+            LatencyHistogram const &h = profile.latencies();
+            out << name << ": calls=" << profile.callCount()
+                << " sampled=" << h.count() << " p50=" << h.percentile(50)
+                << " p99=" << h.percentile(99) << " max=" << h.max()
+                << " ns\n";
+        };
+        out << "play: " << playNanos << " ns in " << plays.count()
+            << " profiled of " << games << " games\n";
+        line("engine", engineNanos());
+        line("dice", dice->estimatedTotalNanos());
+        line("scoreboard", scoreboard->estimatedTotalNanos());
+        latencies("Die::roll", *dice);
+        latencies("ScoreBoard", *scoreboard);
+    }
+
+   private:
+    void recordPlay(Clock::duration elapsed) {
+        auto nanos =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                .count();
+        plays.record(nanos);
+        playNanos += nanos;
+    }
+};
+
+// Licznik zdarzeń procesora lub jądra (perf_event_open) dla bieżącego
+// wątku, liczony tylko w przestrzeni użytkownika. W maszynie wirtualnej bez
+// PMU albo przy zbyt wysokim perf_event_paranoid licznik jest niedostępny
+// (available() zwraca false), a pomiary zwracają 0.
+class PerfCounter {
+   private:
+    int fd;
+
+   public:
+    PerfCounter(std::uint32_t type, std::uint64_t config) : fd(-1) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    // Chybienia TLB danych przy odczycie.
+    static PerfCounter dtlbLoadMisses() {
+        return PerfCounter(PERF_TYPE_HW_CACHE,
+                           PERF_COUNT_HW_CACHE_DTLB |
+                               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    }
+
+    static PerfCounter pageFaults() {
+        return PerfCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    }
+
+    PerfCounter(PerfCounter &&other) noexcept
+        : fd(std::exchange(other.fd, -1)) {}
+
+    PerfCounter &operator=(PerfCounter &&other) noexcept {
+        std::swap(fd, other.fd);
+        return *this;
+    }
+
+    ~PerfCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start() {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    std::uint64_t stop() {
+        std::uint64_t count = 0;
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+        return count;
+    }
+};
+
+#endif
@@ -0,0 +1,718 @@
+#ifndef WORLDCUP_PROTOCOL_H
+#define WORLDCUP_PROTOCOL_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "worldcup_journal.h"
+#include "worldcup_simulation.h"
+
+// Binarny protokół usługi prowadzącej gry (demon worldcup_daemon).
+//
+// Każda wiadomość to ramka: 4-bajtowa długość treści, a po niej treść.
+// Liczby są zapisywane w porządku bajtów komputera (usługa jest lokalna),
+// napisy jako 2-bajtowa długość i bajty. Żądanie zaczyna się od kodu
+// operacji, odpowiedź od kodu wyniku:
+//
+//   Create    seed:u64                 -> game:u32
+//   AddPlayer game:u32 name:str        -> (nic)
+//   Step      game:u32 rounds:u32      -> rounds:u32 running:u8
+//   Query     game:u32                 -> round:u32 running:u8 winner:str
+//                                         count:u16 (name:str money:u32
+//                                         field:u32 suspension:u32)*count
+//   Close     game:u32                 -> (nic)
+//
+// AddPlayer odrzuca nazwę dłuższą niż GameHost::maxNameLength (BadRequest)
+// i gracza ponad WorldCup2022::maxPlayers (GameError).
+// Step rozgrywa co najwyżej rounds kolejnych rund (WorldCup2022::step, nie
+// więcej niż GameHost::maxStepRounds naraz, żeby jedno żądanie nie
+// blokowało usługi), running mówi, czy gra toczy się dalej.
+enum class Opcode : std::uint8_t {
+    Create = 1,
+    AddPlayer = 2,
+    Step = 3,
+    Query = 4,
+    Close = 5,
+};
+
+enum class Status : std::uint8_t {
+    Ok = 0,
+    UnknownGame = 1,
+    // Gra odrzuciła operację (np. za mało graczy).
+    GameError = 2,
+    BadRequest = 3,
+};
+
+class ProtocolError : public std::runtime_error {
+   public:
+    using std::runtime_error::runtime_error;
+};
+
+// Dopisuje do bufora ramkę z podaną treścią.
+inline void appendFrame(std::string &buffer, std::string_view payload) {
+    std::uint32_t length = payload.size();
+    buffer.append(reinterpret_cast<char const *>(&length), sizeof(length));
+    buffer.append(payload);
+}
+
+// Składa treść wiadomości.
+class ProtocolWriter {
+   private:
+    std::string data;
+
+    template <typename T>
+    ProtocolWriter &put(T value) {
+        data.append(reinterpret_cast<char const *>(&value), sizeof(value));
+        return *this;
+    }
+
+   public:
+    ProtocolWriter &u8(std::uint8_t value) { return put(value); }
+    ProtocolWriter &u16(std::uint16_t value) { return put(value); }
+    ProtocolWriter &u32(std::uint32_t value) { return put(value); }
+    ProtocolWriter &u64(std::uint64_t value) { return put(value); }
+
+    // Liczba o zmiennej długości: po 7 bitów na bajt, najmłodsze najpierw.
+    ProtocolWriter &var(std::uint64_t value) {
+        for (; value >= 0x80; value >>= 7) {
+            data.push_back(static_cast<char>(value | 0x80));
+        }
+        data.push_back(static_cast<char>(value));
+        return *this;
+    }
+
+    ProtocolWriter &str(std::string_view value) {
+        if (value.size() > UINT16_MAX) {
+            throw ProtocolError("string too long");
+        }
+        u16(value.size());
+        data.append(value);
+        return *this;
+    }
+
+    // Bajty bez długości.
+    ProtocolWriter &bytes(std::string_view value) {
+        data.append(value);
+        return *this;
+    }
+
+    ProtocolWriter &op(Opcode opcode) {
+        return u8(static_cast<std::uint8_t>(opcode));
+    }
+
+    ProtocolWriter &status(Status status) {
+        return u8(static_cast<std::uint8_t>(status));
+    }
+
+    std::string const &payload() const { return data; }
+
+    // Treść poprzedzona długością - gotowa do wysłania.
+    std::string frame() const {
+        std::string result;
+        appendFrame(result, data);
+        return result;
+    }
+};
+
+// Odczytuje treść wiadomości; rzuca ProtocolError, gdy treść jest za krótka.
+// Nie kopiuje treści, więc nie przyjmuje obiektów tymczasowych.
+class ProtocolReader {
+   private:
+    std::string_view data;
+
+    template <typename T>
+    T get() {
+        if (data.size() < sizeof(T)) {
+            throw ProtocolError("truncated message");
+        }
+        T value;
+        std::memcpy(&value, data.data(), sizeof(T));
+        data.remove_prefix(sizeof(T));
+        return value;
+    }
+
+   public:
+    explicit ProtocolReader(std::string_view data) : data(data) {}
+
+    explicit ProtocolReader(std::string &&data) = delete;
+
+    std::uint8_t u8() { return get<std::uint8_t>(); }
+    std::uint16_t u16() { return get<std::uint16_t>(); }
+    std::uint32_t u32() { return get<std::uint32_t>(); }
+    std::uint64_t u64() { return get<std::uint64_t>(); }
+
+    std::uint64_t var() {
+        std::uint64_t value = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t byte = u8();
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                return value;
+            }
+        }
+        throw ProtocolError("malformed number");
+    }
+
+    std::string str() { return std::string(bytes(u16())); }
+
+    std::string_view bytes(size_t length) {
+        if (data.size() < length) {
+            throw ProtocolError("truncated string");
+        }
+        std::string_view value = data.substr(0, length);
+        data.remove_prefix(length);
+        return value;
+    }
+
+    Status status() { return static_cast<Status>(u8()); }
+};
+
+// Najdłuższa treść ramki przyjmowana przez takeFrame.
+inline constexpr size_t maxFrame = 1 << 16;
+
+// Wycina z początku bufora kolejną pełną ramkę. Zwraca false, jeśli ramka
+// nie dotarła jeszcze w całości. Rzuca ProtocolError przy ramce dłuższej niż
+// maxFrame.
+inline bool takeFrame(std::string &buffer, std::string &payload,
+                      size_t &offset) {
+    std::uint32_t length;
+    if (buffer.size() - offset < sizeof(length)) {
+        return false;
+    }
+    std::memcpy(&length, buffer.data() + offset, sizeof(length));
+    if (length > maxFrame) {
+        throw ProtocolError("frame too long");
+    }
+    if (buffer.size() - offset - sizeof(length) < length) {
+        return false;
+    }
+    payload.assign(buffer, offset + sizeof(length), length);
+    offset += sizeof(length) + length;
+    return true;
+}
+
+// Kostka usługi: n-ta wartość strumienia o danym ziarnie to SplitMix64
+// w punkcie seed + n * złota stała, więc stan strumienia to dwie liczby,
+// a przejście do dowolnego miejsca kosztuje O(1) (w odróżnieniu od
+// mt19937_64, którego odtworzenie z ziarna i liczby wartości wymaga
+// discard() proporcjonalnego do długości gry).
+struct CounterStream {
+    std::uint64_t seed = 0;
+    // Liczba pobranych wartości.
+    std::uint64_t draws = 0;
+
+    std::uint64_t next() {
+        std::uint64_t z = seed + ++draws * 0x9e3779b97f4a7c15u;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+        return z ^ (z >> 31);
+    }
+};
+
+class CounterDie : public Die {
+   private:
+    std::shared_ptr<CounterStream> const stream;
+
+   public:
+    explicit CounterDie(std::shared_ptr<CounterStream> stream)
+        : stream(std::move(stream)) {}
+
+    [[nodiscard]] unsigned short roll() const override {
+        return stream->next() % 6 + 1;
+    }
+};
+
+// Gry prowadzone przez usługę, niezależne od transportu: handle() zamienia
+// treść żądania na treść odpowiedzi. Gry mają dwie kostki CounterDie
+// ze wspólnym strumieniem o ziarnie podanym przy tworzeniu.
+//
+// Z dziennikiem (GameJournal) każda zmiana stanu jest w nim zapisywana:
+// utworzenie gry, dodanie gracza, zamknięcie gry i krok. Rekord kroku
+// zawiera liczbę rozegranych rund i wpis każdej tury (suma oczek i stan
+// gracza po turze), zapisane razem, żeby nie płacić za nagłówek rekordu
+// przy każdej turze. Gry są deterministyczne, więc recover() odtwarza stan
+// z migawki, wykonując ponownie kroki z dziennika; wpisy tur służą do
+// sprawdzenia, że odtworzony przebieg jest identyczny z zapisanym.
+//
+// Aktywnych gier (z pełnym zestawem obiektów silnika) jest co najwyżej
+// liveLimit. Najdawniej używane są pakowane do zwartej postaci
+// (kilkadziesiąt bajtów) i odtwarzane przy następnym żądaniu, które ich
+// dotyczy; obiekty spakowanej gry są użyte ponownie. Stan strumienia kostek
+// spakowana gra przechowuje jako ziarno i liczbę pobranych wartości.
+// Spakowane gry tworzą też migawkę.
+class GameHost {
+   public:
+    static constexpr std::uint32_t maxStepRounds = 1 << 16;
+    // Najdłuższa nazwa gracza: odpowiedź na Query (10 bajtów nagłówka,
+    // nazwa zwycięzcy i po 14 bajtów na gracza poza nazwą) dla
+    // WorldCup2022::maxPlayers graczy o takich nazwach mieści się w ramce.
+    static constexpr size_t maxNameLength =
+        (maxFrame - 10 - 14 * WorldCup2022::maxPlayers) /
+        (WorldCup2022::maxPlayers + 1);
+
+   private:
+    enum class Record : std::uint8_t {
+        Create = 1,
+        AddPlayer = 2,
+        Step = 3,
+        Close = 4,
+    };
+
+    static constexpr unsigned int diceCount = 2;
+    // Rodzaj rekordu, numer gry i liczba rund; za nimi wpisy tur.
+    static constexpr size_t stepHeaderSize = 9;
+    // Wpis tury: rzut (u8), pieniądze, pole i 2 * zawieszenie + bankructwo
+    // jako liczby o zmiennej długości - zwykle 5 bajtów, najwyżej 16.
+    static constexpr size_t maxTurnEntrySize = 16;
+    // Rekord najdłuższego kroku musi się zmieścić w rekordzie dziennika.
+    static_assert(stepHeaderSize + maxTurnEntrySize *
+                                       WorldCup2022::maxPlayers *
+                                       maxStepRounds <=
+                  GameJournal::maxRecord);
+
+    struct HostedGame : TurnObserver {
+        std::uint32_t id = 0;
+        std::shared_ptr<CounterStream> stream;
+        std::shared_ptr<OutcomeScoreBoard> scoreboard;
+        WorldCup2022 game;
+        bool running = true;
+        std::string winner;
+        // Bufor, do którego trafiają wpisy tur (nullptr - bez zapisu).
+        std::string *turns = nullptr;
+        BoardState const initialBoard;
+
+        HostedGame()
+            : stream(std::make_shared<CounterStream>()),
+              scoreboard(std::make_shared<OutcomeScoreBoard>()),
+              initialBoard(game.getState().board) {
+            for (unsigned int i = 0; i < diceCount; i++) {
+                game.addDie(std::make_shared<CounterDie>(stream));
+            }
+            game.setScoreBoard(scoreboard);
+            game.setTurnObserver(this);
+        }
+
+        // Numer miejsca, jeśli name to seatName(numer), w przeciwnym
+        // razie -1.
+        static long seatOf(std::string const &name) {
+            constexpr std::string_view prefix = "Player-";
+            unsigned int number = 0;
+            if (!name.starts_with(prefix) ||
+                std::from_chars(name.data() + prefix.size(),
+                                name.data() + name.size(), number)
+                        .ec != std::errc() ||
+                number == 0 || seatName(number - 1) != name) {
+                return -1;
+            }
+            return number - 1;
+        }
+
+        // Nazwy postaci seatName(numer) są zapisywane jako numer + 1, inne
+        // jako 0 i napis.
+        static void putName(ProtocolWriter &out, std::string const &name) {
+            long seat = seatOf(name);
+            if (seat >= 0) {
+                out.var(seat + 1);
+            } else {
+                out.var(0).str(name);
+            }
+        }
+
+        static std::string getName(ProtocolReader &in) {
+            std::uint64_t seat = in.var();
+            return seat > 0 ? seatName(seat - 1) : in.str();
+        }
+
+        // Zaczyna od nowa grę o podanym numerze i ziarnie.
+        void start(std::uint32_t id, std::uint64_t seed) {
+            this->id = id;
+            *stream = CounterStream{seed, 0};
+            running = true;
+            winner.clear();
+            game.setState(GameState{{}, initialBoard, 0});
+        }
+
+        // Liczby są zapisywane ze zmienną długością, a stan pól planszy jako
+        // różnica (xor) względem stanu nowej gry, więc nietknięte pola
+        // zajmują po bajcie.
+        void pack(ProtocolWriter &out) const {
+            GameState state = game.getState();
+            out.u64(stream->seed).var(stream->draws).u8(running);
+            putName(out, winner);
+            out.var(state.round).var(state.players.size());
+            for (auto const &[name, player] : state.players) {
+                putName(out, name);
+                out.var(player.money)
+                    .var(player.field)
+                    .var(player.suspension)
+                    .u8(player.bankrupted);
+            }
+            out.var(state.board.size());
+            for (size_t i = 0; i < state.board.size(); i++) {
+                out.var(state.board[i] ^ initialBoard[i]);
+            }
+        }
+
+        // Rzuca ProtocolError przy uszkodzonej postaci.
+        void unpack(std::string_view packed) {
+            ProtocolReader in(packed);
+            stream->seed = in.u64();
+            stream->draws = in.var();
+            running = in.u8();
+            winner = getName(in);
+            GameState state;
+            state.round = in.var();
+            for (std::uint64_t players = in.var(); players > 0; players--) {
+                std::string name = getName(in);
+                PlayerState player;
+                player.money = in.var();
+                player.field = in.var();
+                player.suspension = in.var();
+                player.bankrupted = in.u8();
+                state.players.emplace_back(std::move(name), player);
+            }
+            if (in.var() != initialBoard.size()) {
+                throw ProtocolError("board size mismatch");
+            }
+            state.board.resize(initialBoard.size());
+            for (size_t i = 0; i < state.board.size(); i++) {
+                state.board[i] = in.var() ^ initialBoard[i];
+            }
+            game.setState(state);
+        }
+
+        void onTurnEnd(Player const &player, unsigned int roll) override {
+            if (turns == nullptr) {
+                return;
+            }
+            PlayerState state = player.getState();
+            char entry[maxTurnEntrySize];
+            char *out = entry;
+            auto var = [&out](std::uint64_t value) {
+                for (; value >= 0x80; value >>= 7) {
+                    *out++ = static_cast<char>(value | 0x80);
+                }
+                *out++ = static_cast<char>(value);
+            };
+            *out++ = static_cast<char>(roll);
+            var(state.money);
+            var(state.field);
+            var(std::uint64_t(state.suspension) * 2 + state.bankrupted);
+            turns->append(entry, out - entry);
+        }
+
+        PlayResult step(std::uint32_t rounds) {
+            PlayResult result = game.step(rounds);
+            running = result.stopped;
+            if (!running) {
+                winner = scoreboard->getWinner();
+            }
+            return result;
+        }
+    };
+
+    // Gra aktywna albo spakowana (live == nullptr).
+    struct Slot {
+        std::unique_ptr<HostedGame> live;
+        std::string packed;
+        std::list<std::uint32_t>::iterator recent;
+    };
+
+    GameJournal *journal;
+    size_t liveLimit;
+    std::unordered_map<std::uint32_t, Slot> games;
+    // Numery aktywnych gier, od ostatnio używanej.
+    std::list<std::uint32_t> recent;
+    // Obiekty ostatnio spakowanej lub zamkniętej gry do ponownego użycia.
+    std::unique_ptr<HostedGame> spare;
+    std::uint32_t nextId = 1;
+    // Wpisy tur kroku odtwarzanego z dziennika (wielokrotnie używany bufor).
+    std::string stepRecord;
+
+    static std::string packed(HostedGame const &hosted) {
+        ProtocolWriter out;
+        hosted.pack(out);
+        return out.payload();
+    }
+
+    // Obiekty gry do zainicjowania; przy wyczerpanym limicie aktywnych gier
+    // pakuje najdawniej używaną.
+    std::unique_ptr<HostedGame> shell() {
+        if (recent.size() >= liveLimit) {
+            Slot &slot = games.find(recent.back())->second;
+            slot.packed = packed(*slot.live);
+            spare = std::move(slot.live);
+            recent.pop_back();
+        }
+        if (spare != nullptr) {
+            return std::move(spare);
+        }
+        return std::make_unique<HostedGame>();
+    }
+
+    Slot &activate(std::uint32_t id, std::unique_ptr<HostedGame> hosted) {
+        Slot &slot = games[id];
+        slot.live = std::move(hosted);
+        slot.packed = std::string();
+        slot.recent = recent.insert(recent.begin(), id);
+        return slot;
+    }
+
+    HostedGame &find(std::uint32_t id) {
+        auto it = games.find(id);
+        if (it == games.end()) {
+            throw std::out_of_range("unknown game");
+        }
+        Slot &slot = it->second;
+        if (slot.live != nullptr) {
+            recent.splice(recent.begin(), recent, slot.recent);
+            return *slot.live;
+        }
+        std::unique_ptr<HostedGame> hosted = shell();
+        hosted->id = id;
+        hosted->unpack(slot.packed);
+        return *activate(id, std::move(hosted)).live;
+    }
+
+    HostedGame &create(std::uint32_t id, std::uint64_t seed) {
+        remove(id);
+        std::unique_ptr<HostedGame> hosted = shell();
+        hosted->start(id, seed);
+        nextId = std::max(nextId, id + 1);
+        return *activate(id, std::move(hosted)).live;
+    }
+
+    bool remove(std::uint32_t id) {
+        auto it = games.find(id);
+        if (it == games.end()) {
+            return false;
+        }
+        if (it->second.live != nullptr) {
+            recent.erase(it->second.recent);
+            spare = std::move(it->second.live);
+        }
+        games.erase(it);
+        return true;
+    }
+
+    void log(ProtocolWriter const &record) {
+        if (journal != nullptr) {
+            journal->append(record.payload());
+        }
+    }
+
+    // Krok zapisywany w dzienniku: nagłówek i wpisy tur trafiają wprost do
+    // bufora dziennika, a liczba rund jest uzupełniana po kroku. Krok
+    // zakończony wyjątkiem nie zostawia rekordu.
+    PlayResult loggedStep(HostedGame &hosted, std::uint32_t rounds) {
+        std::string &buffer = journal->beginRecord();
+        size_t header = buffer.size();
+        buffer.push_back(static_cast<char>(Record::Step));
+        buffer.append(reinterpret_cast<char const *>(&hosted.id),
+                      sizeof(hosted.id));
+        buffer.append(sizeof(std::uint32_t), '\0');
+        hosted.turns = &buffer;
+        PlayResult result;
+        try {
+            result = hosted.step(rounds);
+        } catch (...) {
+            hosted.turns = nullptr;
+            journal->dropRecord();
+            throw;
+        }
+        hosted.turns = nullptr;
+        std::memcpy(&buffer[header + 5], &result.rounds,
+                    sizeof(result.rounds));
+        journal->endRecord();
+        return result;
+    }
+
+    static ProtocolWriter record(Record type, std::uint32_t id) {
+        ProtocolWriter writer;
+        writer.u8(static_cast<std::uint8_t>(type)).u32(id);
+        return writer;
+    }
+
+    void dispatch(ProtocolReader &in, ProtocolWriter &out) {
+        auto opcode = static_cast<Opcode>(in.u8());
+        switch (opcode) {
+            case Opcode::Create: {
+                std::uint64_t seed = in.u64();
+                std::uint32_t id = nextId;
+                create(id, seed);
+                log(record(Record::Create, id).u64(seed));
+                out.status(Status::Ok).u32(id);
+                return;
+            }
+            case Opcode::AddPlayer: {
+                HostedGame &hosted = find(in.u32());
+                std::string name = in.str();
+                if (name.size() > maxNameLength) {
+                    throw ProtocolError("player name too long");
+                }
+                if (hosted.game.getState().players.size() >=
+                    WorldCup2022::maxPlayers) {
+                    throw TooManyPlayersException();
+                }
+                hosted.game.addPlayer(name);
+                log(record(Record::AddPlayer, hosted.id).str(name));
+                out.status(Status::Ok);
+                return;
+            }
+            case Opcode::Step: {
+                HostedGame &hosted = find(in.u32());
+                std::uint32_t rounds = std::min(in.u32(), maxStepRounds);
+                PlayResult result{0, false};
+                if (hosted.running) {
+                    result = journal != nullptr ? loggedStep(hosted, rounds)
+                                                : hosted.step(rounds);
+                }
+                out.status(Status::Ok).u32(result.rounds).u8(hosted.running);
+                return;
+            }
+            case Opcode::Query: {
+                HostedGame &hosted = find(in.u32());
+                GameState state = hosted.game.getState();
+                out.status(Status::Ok)
+                    .u32(state.round)
+                    .u8(hosted.running)
+                    .str(hosted.winner)
+                    .u16(static_cast<std::uint16_t>(state.players.size()));
+                for (auto const &[name, player] : state.players) {
+                    out.str(name).u32(player.money).u32(player.field).u32(
+                        player.suspension);
+                }
+                return;
+            }
+            case Opcode::Close: {
+                std::uint32_t id = in.u32();
+                if (!remove(id)) {
+                    throw std::out_of_range("unknown game");
+                }
+                log(record(Record::Close, id));
+                out.status(Status::Ok);
+                return;
+            }
+        }
+        throw ProtocolError("unknown opcode");
+    }
+
+    // Gry z migawki pozostają spakowane do pierwszego użycia.
+    void restore(std::string const &snapshot) {
+        ProtocolReader in(snapshot);
+        nextId = in.u32();
+        for (std::uint32_t count = in.u32(); count > 0; count--) {
+            std::uint32_t id = in.u32();
+            games[id].packed = std::string(in.bytes(in.u32()));
+        }
+    }
+
+    void replay(std::vector<std::string> const &records) {
+        for (auto const &data : records) {
+            ProtocolReader in(data);
+            auto type = static_cast<Record>(in.u8());
+            std::uint32_t id = in.u32();
+            switch (type) {
+                case Record::Create:
+                    create(id, in.u64());
+                    break;
+                case Record::AddPlayer:
+                    find(id).game.addPlayer(in.str());
+                    break;
+                case Record::Step: {
+                    HostedGame &hosted = find(id);
+                    stepRecord.clear();
+                    hosted.turns = &stepRecord;
+                    hosted.step(in.u32());
+                    hosted.turns = nullptr;
+                    if (std::string_view(data).substr(stepHeaderSize) !=
+                        stepRecord) {
+                        throw std::runtime_error(
+                            "journal diverges from the engine");
+                    }
+                    break;
+                }
+                case Record::Close:
+                    remove(id);
+                    break;
+                default:
+                    throw std::runtime_error("unknown journal record");
+            }
+        }
+    }
+
+   public:
+    // Bez dziennika (nullptr) stan gier istnieje tylko w pamięci.
+    explicit GameHost(GameJournal *journal = nullptr,
+                      size_t liveLimit = SIZE_MAX)
+        : journal(journal), liveLimit(std::max<size_t>(1, liveLimit)) {}
+
+    GameHost(GameHost const &) = delete;
+    GameHost &operator=(GameHost const &) = delete;
+
+    std::string handle(std::string_view request) {
+        ProtocolReader in(request);
+        ProtocolWriter out;
+        try {
+            dispatch(in, out);
+        } catch (ProtocolError const &) {
+            return ProtocolWriter().status(Status::BadRequest).payload();
+        } catch (std::out_of_range const &) {
+            return ProtocolWriter().status(Status::UnknownGame).payload();
+        } catch (std::exception const &) {
+            return ProtocolWriter().status(Status::GameError).payload();
+        }
+        return out.payload();
+    }
+
+    // Odtwarza gry z migawki i dziennika. Wywoływane przed pierwszym
+    // żądaniem; rzuca std::runtime_error, jeśli dziennik nie zgadza się
+    // z przebiegiem gier.
+    void recover() {
+        if (journal == nullptr) {
+            return;
+        }
+        games.clear();
+        recent.clear();
+        nextId = 1;
+        auto [epoch, snapshot] = journal->loadSnapshot();
+        GameJournal *active = journal;
+        journal = nullptr;
+        if (!snapshot.empty()) {
+            restore(snapshot);
+        }
+        replay(active->recover(epoch));
+        journal = active;
+    }
+
+    // Zapisuje migawkę wszystkich gier i zaczyna nowy dziennik.
+    void snapshot() {
+        if (journal == nullptr) {
+            return;
+        }
+        ProtocolWriter out;
+        out.u32(nextId).u32(games.size());
+        for (auto const &[id, slot] : games) {
+            std::string const &state =
+                slot.live != nullptr ? packed(*slot.live) : slot.packed;
+            out.u32(id).u32(state.size()).bytes(state);
+        }
+        journal->writeSnapshot(out.payload());
+    }
+
+    size_t size() const { return games.size(); }
+
+    // Liczba gier, które nie są spakowane.
+    size_t liveCount() const { return recent.size(); }
+};
+
+#endif
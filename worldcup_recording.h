@@ -0,0 +1,337 @@
+#ifndef WORLDCUP_RECORDING_H
+#define WORLDCUP_RECORDING_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "worldcup_codec.h"
+#include "worldcup_protocol.h"
+
+// Nagranie gry z punktami kontrolnymi, pozwalające przewinąć grę do
+// dowolnej rundy bez odtwarzania jej od początku.
+//
+// Nagranie składa się z odcinków po interval rund. Odcinek zawiera stan
+// gry (GameState) z początku swojej pierwszej rundy i wyniki rzutów
+// kostkami ze wszystkich tur tych rund; na końcu pliku jest indeks
+// (pierwsza runda odcinka -> położenie w pliku). Przewinięcie do rundy r
+// odtwarza stan z najbliższego wcześniejszego punktu kontrolnego i rozgrywa
+// co najwyżej interval - 1 rund, podając zapisane rzuty zamiast losować.
+//
+// Plik: "WCR1", ramka z układem planszy, ramki odcinków (jak w protokole:
+// długość u32 i treść), indeks (runda u32, położenie u64) i stopka:
+// położenie indeksu (u64), liczba odcinków (u32), interval (u32), "WCR1".
+// Stan w odcinku jest skompresowany codec::lzCompress() (plansze mogą mieć
+// miliony pól, a większość ich stanów jest zerowa).
+//
+// Odtwarzanie zakłada, że suma rzutów w turze z rzutem jest dodatnia
+// (tury bez rzutu, np. zawieszenie, mają w obserwatorze wynik 0).
+namespace recording_detail {
+    inline void packState(ProtocolWriter &out, GameState const &state) {
+        out.var(state.round).var(state.players.size());
+        for (auto const &[name, player] : state.players) {
+            out.str(name)
+                .var(player.money)
+                .var(player.field)
+                .var(player.suspension)
+                .u8(player.bankrupted);
+        }
+        out.var(state.board.size());
+        for (unsigned int value : state.board) {
+            out.var(value);
+        }
+    }
+
+    inline GameState unpackState(ProtocolReader &in) {
+        GameState state;
+        state.round = in.var();
+        for (std::uint64_t players = in.var(); players > 0; players--) {
+            std::string name = in.str();
+            PlayerState player;
+            player.money = in.var();
+            player.field = in.var();
+            player.suspension = in.var();
+            player.bankrupted = in.u8();
+            state.players.emplace_back(std::move(name), player);
+        }
+        // Elementy dokładamy po jednym: liczba z uszkodzonego nagrania nie
+        // wymusi przydziału większego niż dane, które faktycznie są.
+        for (std::uint64_t fields = in.var(); fields > 0; fields--) {
+            state.board.push_back(in.var());
+        }
+        return state;
+    }
+
+    // Zbiera rzuty kolejnych tur nagrywanej gry.
+    class RollRecorder : public TurnObserver {
+       public:
+        std::vector<unsigned int> rolls;
+
+        void onTurnEnd(Player const &, unsigned int roll) override {
+            if (roll > 0) {
+                rolls.push_back(roll);
+            }
+        }
+    };
+
+    // Kostki odtwarzanej gry: pierwsza podaje zapisane sumy, druga 0.
+    class TapeDie : public Die {
+       private:
+        std::shared_ptr<std::vector<unsigned int>> tape;
+        std::shared_ptr<size_t> position;
+
+       public:
+        TapeDie(std::shared_ptr<std::vector<unsigned int>> tape,
+                std::shared_ptr<size_t> position)
+            : tape(std::move(tape)), position(std::move(position)) {}
+
+        [[nodiscard]] unsigned short roll() const override {
+            if (tape == nullptr) {
+                return 0;
+            }
+            if (*position >= tape->size()) {
+                throw std::runtime_error("recording has too few rolls");
+            }
+            return (*tape)[(*position)++];
+        }
+    };
+}  // namespace recording_detail
+
+// Rozgrywa co najwyżej rounds rund gry game (na planszy o układzie layout,
+// przygotowanej jak do play()) i zapisuje ją do out z punktem kontrolnym
+// co interval rund oraz po ostatniej rundzie. Gra kończy się jak po
+// play(rounds). Zwraca liczbę rozegranych rund.
+inline unsigned int recordGame(WorldCup2022 &game,
+                               std::vector<FieldSpec> const &layout,
+                               unsigned int rounds, unsigned int interval,
+                               std::ostream &out) {
+    if (interval == 0) {
+        throw std::invalid_argument("checkpoint interval must be positive");
+    }
+    out.write("WCR1", 4);
+    std::uint64_t offset = 4;
+    auto putFrame = [&](ProtocolWriter const &writer) {
+        std::string frame = writer.frame();
+        out.write(frame.data(), frame.size());
+        offset += frame.size();
+    };
+    ProtocolWriter header;
+    header.var(layout.size());
+    for (auto const &spec : layout) {
+        header.u8(static_cast<std::uint8_t>(spec.type))
+            .str(spec.name)
+            .var(spec.value)
+            .u64(std::bit_cast<std::uint64_t>(spec.weight));
+    }
+    putFrame(header);
+
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> index;
+    recording_detail::RollRecorder recorder;
+    auto putSegment = [&](GameState const &state, unsigned int length) {
+        ProtocolWriter packed;
+        recording_detail::packState(packed, state);
+        std::string compressed = codec::lzCompress(packed.payload());
+        ProtocolWriter segment;
+        segment.var(state.round)
+            .var(length)
+            .var(packed.payload().size())
+            .var(compressed.size())
+            .bytes(compressed)
+            .var(recorder.rolls.size());
+        for (unsigned int roll : recorder.rolls) {
+            segment.var(roll);
+        }
+        index.emplace_back(state.round, offset);
+        putFrame(segment);
+    };
+
+    game.setTurnObserver(&recorder);
+    unsigned int const firstRound = game.getRound();
+    unsigned int played = 0;
+    bool running = true;
+    while (running && played < rounds) {
+        GameState state = game.getState();
+        recorder.rolls.clear();
+        PlayResult result = game.step(std::min(interval, rounds - played));
+        played += result.rounds;
+        running = result.stopped;
+        putSegment(state, result.rounds);
+    }
+    game.setTurnObserver(nullptr);
+    // Stan końcowy (zakończona gra ma już wyzerowany numer rundy).
+    GameState last = game.getState();
+    last.round = firstRound + played;
+    recorder.rolls.clear();
+    putSegment(last, 0);
+    if (running) {
+        game.play(0);
+    }
+
+    std::uint64_t indexOffset = offset;
+    for (auto const &[round, position] : index) {
+        out.write(reinterpret_cast<char const *>(&round), sizeof(round));
+        out.write(reinterpret_cast<char const *>(&position),
+                  sizeof(position));
+    }
+    auto count = static_cast<std::uint32_t>(index.size());
+    out.write(reinterpret_cast<char const *>(&indexOffset),
+              sizeof(indexOffset));
+    out.write(reinterpret_cast<char const *>(&count), sizeof(count));
+    out.write(reinterpret_cast<char const *>(&interval), sizeof(interval));
+    out.write("WCR1", 4);
+    if (!out) {
+        throw std::runtime_error("cannot write recording");
+    }
+    return played;
+}
+
+// Odczyt nagrania recordGame() z przewijaniem do dowolnej rundy.
+class GameRecording {
+   private:
+    struct Segment {
+        GameState state;
+        unsigned int rounds;
+        std::vector<unsigned int> rolls;
+    };
+
+    std::ifstream in;
+    std::uint64_t fileSize;
+    std::vector<FieldSpec> layout;
+    // (pierwsza runda odcinka, położenie ramki), rosnąco.
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> index;
+    std::uint32_t interval;
+    unsigned int replayed;
+
+    std::string readFrame(std::uint64_t offset) {
+        std::uint32_t length;
+        in.seekg(offset);
+        in.read(reinterpret_cast<char *>(&length), sizeof(length));
+        if (in && length > fileSize - offset - sizeof(length)) {
+            throw std::runtime_error("truncated recording");
+        }
+        std::string payload(in ? length : 0, '\0');
+        in.read(payload.data(), payload.size());
+        if (!in) {
+            throw std::runtime_error("truncated recording");
+        }
+        return payload;
+    }
+
+    Segment readSegment(size_t number) {
+        std::string payload = readFrame(index[number].second);
+        ProtocolReader reader(payload);
+        Segment segment;
+        reader.var();
+        segment.rounds = reader.var();
+        size_t stateSize = reader.var();
+        std::string packed =
+            codec::lzDecompress(reader.bytes(reader.var()), stateSize);
+        ProtocolReader stateReader(packed);
+        segment.state = recording_detail::unpackState(stateReader);
+        for (std::uint64_t rolls = reader.var(); rolls > 0; rolls--) {
+            segment.rolls.push_back(reader.var());
+        }
+        return segment;
+    }
+
+   public:
+    // Rzuca std::runtime_error, jeśli plik nie jest nagraniem.
+    explicit GameRecording(std::filesystem::path const &path)
+        : in(path, std::ios::binary), fileSize(0), interval(0), replayed(0) {
+        std::uint64_t indexOffset = 0;
+        std::uint32_t count = 0;
+        char magic[4] = {};
+        in.seekg(0, std::ios::end);
+        fileSize = static_cast<std::uint64_t>(in.tellg());
+        if (!in || fileSize < 20) {
+            throw std::runtime_error("not a game recording");
+        }
+        in.seekg(-20, std::ios::end);
+        in.read(reinterpret_cast<char *>(&indexOffset), sizeof(indexOffset));
+        in.read(reinterpret_cast<char *>(&count), sizeof(count));
+        in.read(reinterpret_cast<char *>(&interval), sizeof(interval));
+        in.read(magic, sizeof(magic));
+        if (!in || std::memcmp(magic, "WCR1", 4) != 0) {
+            throw std::runtime_error("not a game recording");
+        }
+        // Indeks (po 12 bajtów na wpis) wypełnia dokładnie miejsce przed
+        // stopką.
+        if (indexOffset > fileSize - 20 ||
+            fileSize - 20 - indexOffset != std::uint64_t{count} * 12) {
+            throw std::runtime_error("corrupted recording");
+        }
+        index.resize(count);
+        in.seekg(indexOffset);
+        for (auto &[round, position] : index) {
+            in.read(reinterpret_cast<char *>(&round), sizeof(round));
+            in.read(reinterpret_cast<char *>(&position), sizeof(position));
+        }
+        std::string header = readFrame(4);
+        ProtocolReader reader(header);
+        for (std::uint64_t fields = reader.var(); fields > 0; fields--) {
+            FieldSpec &spec = layout.emplace_back();
+            spec.type = static_cast<FieldType>(reader.u8());
+            spec.name = reader.str();
+            spec.value = reader.var();
+            spec.weight = std::bit_cast<double>(reader.u64());
+        }
+        if (index.empty()) {
+            throw std::runtime_error("empty recording");
+        }
+    }
+
+    std::vector<FieldSpec> const &getLayout() const { return layout; }
+
+    std::uint32_t getInterval() const { return interval; }
+
+    size_t checkpoints() const { return index.size(); }
+
+    // Pierwsza i ostatnia runda nagrania (ostatnia - stan końcowy).
+    unsigned int firstRound() const { return index.front().first; }
+
+    unsigned int lastRound() const { return index.back().first; }
+
+    // Ile rund rozegrało ostatnie seek().
+    unsigned int replayedRounds() const { return replayed; }
+
+    // Stan gry na początku rundy round (dla lastRound() - stan końcowy).
+    // Rzuca std::out_of_range dla rundy spoza nagrania.
+    GameState seek(unsigned int round) {
+        if (round < firstRound() || round > lastRound()) {
+            throw std::out_of_range("round outside recording");
+        }
+        size_t number =
+            std::upper_bound(index.begin(), index.end(),
+                             std::pair<std::uint32_t, std::uint64_t>(
+                                 round, UINT64_MAX)) -
+            index.begin() - 1;
+        Segment segment = readSegment(number);
+        replayed = round - index[number].first;
+        if (replayed == 0) {
+            return segment.state;
+        }
+        auto tape = std::make_shared<std::vector<unsigned int>>(
+            std::move(segment.rolls));
+        auto position = std::make_shared<size_t>(0);
+        WorldCup2022 game(layout);
+        game.addDie(
+            std::make_shared<recording_detail::TapeDie>(tape, position));
+        game.addDie(
+            std::make_shared<recording_detail::TapeDie>(nullptr, position));
+        game.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+        game.setState(segment.state);
+        game.step(replayed);
+        return game.getState();
+    }
+};
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef WORLDCUP_RESIMULATION_H
+#define WORLDCUP_RESIMULATION_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "worldcup_simulation.h"
+
+// Gra, którą można tanio przeliczyć ponownie po zmianie parametru jednego
+// pola. Aż do pierwszej rundy, w której ktoś przeszedł przez to pole lub się
+// na nim zatrzymał, przebieg gry nie zależy od jego parametrów. Dla każdego
+// pola zapamiętujemy więc tę rundę (punkt rozbieżności) i stan gry razem
+// z liczbą rzutów wykonanych przed jej początkiem. Po zmianie pola gra jest
+// wznawiana od tego punktu, więc koszt jest proporcjonalny do długości
+// zmienionej końcówki (plus przewinięcie generatora o zapamiętaną liczbę
+// rzutów, co jest dużo tańsze od rozegrania tych rund).
+//
+// Stanu generatora (2,5 KiB dla mt19937_64) nie kopiujemy: wystarczy ziarno
+// gry i liczba rzutów. Punkt kontrolny powstaje tylko w rundzie, w której
+// gra dotknęła nowego pola.
+//
+// Punkty rozbieżności mają dokładność rundy, nie tury - stan gry zapisujemy
+// tylko na granicach rund.
+class IncrementalGame {
+   private:
+    static constexpr unsigned int untouched =
+        std::numeric_limits<unsigned int>::max();
+
+    struct Checkpoint {
+        unsigned int round;
+        GameState state;
+        // Rzuty kostkami przed początkiem rundy.
+        std::uint64_t draws;
+    };
+
+    // Generator kostek z licznikiem rzutów.
+    struct DrawStream {
+        std::mt19937_64 engine;
+        std::uint64_t draws = 0;
+    };
+
+    // Kostka jak RandomDie, ale licząca rzuty.
+    class CountingDie : public Die {
+       private:
+        std::shared_ptr<DrawStream> const stream;
+
+       public:
+        explicit CountingDie(std::shared_ptr<DrawStream> stream)
+            : stream(std::move(stream)) {}
+
+        [[nodiscard]] unsigned short roll() const override {
+            stream->draws++;
+            return stream->engine() % 6 + 1;
+        }
+    };
+
+    class TouchRecorder : public FieldObserver {
+       private:
+        std::vector<unsigned int> &firstTouch;
+
+       public:
+        unsigned int round = 0;
+        bool touchedNew = false;
+
+        explicit TouchRecorder(std::vector<unsigned int> &firstTouch)
+            : firstTouch(firstTouch) {}
+
+        void onFieldAction(unsigned int field, unsigned int moneyBefore,
+                           Player const &player) override {
+            (void)moneyBefore;
+            (void)player;
+            if (firstTouch[field] == untouched) {
+                firstTouch[field] = round;
+                touchedNew = true;
+            }
+        }
+    };
+
+    std::vector<FieldSpec> layout;
+    unsigned int players;
+    unsigned int rounds;
+    std::uint64_t seed;
+    std::vector<unsigned int> firstTouch;
+    // Posortowane rosnąco po numerze rundy.
+    std::vector<Checkpoint> checkpoints;
+    GameOutcome outcome;
+    std::uint64_t simulatedRounds;
+
+    void simulateFrom(Checkpoint start) {
+        while (!checkpoints.empty() && checkpoints.back().round > start.round) {
+            checkpoints.pop_back();
+        }
+        for (auto &round : firstTouch) {
+            if (round != untouched && round >= start.round) {
+                round = untouched;
+            }
+        }
+
+        auto stream = std::make_shared<DrawStream>();
+        stream->engine.seed(seed);
+        stream->engine.discard(start.draws);
+        stream->draws = start.draws;
+        auto scoreboard = std::make_shared<OutcomeScoreBoard>();
+        TouchRecorder recorder(firstTouch);
+        WorldCup2022 worldCup(layout);
+        worldCup.addDie(std::make_shared<CountingDie>(stream));
+        worldCup.addDie(std::make_shared<CountingDie>(stream));
+        worldCup.setScoreBoard(scoreboard);
+        worldCup.setFieldObserver(&recorder);
+        worldCup.setState(start.state);
+
+        unsigned int round = start.round;
+        GameState state = start.state;
+        while (round < rounds && state.players.size() > 1) {
+            std::uint64_t draws = stream->draws;
+            recorder.round = round;
+            recorder.touchedNew = false;
+            worldCup.play(1);
+            if (recorder.touchedNew &&
+                (checkpoints.empty() || checkpoints.back().round < round)) {
+                checkpoints.push_back({round, std::move(state), draws});
+            }
+            state = worldCup.getState();
+            round++;
+            simulatedRounds++;
+        }
+        // Pętla nie rozegrała żadnej rundy (rounds == 0): jak w play(0),
+        // gra kończy się wyborem zwycięzcy (play() sprawdza też liczbę
+        // graczy).
+        if (scoreboard->getWinner().empty()) {
+            worldCup.play(0);
+        }
+
+        outcome.rounds = round;
+        outcome.winnerSeat = 0;
+        while (outcome.winnerSeat < players &&
+               seatName(outcome.winnerSeat) != scoreboard->getWinner()) {
+            outcome.winnerSeat++;
+        }
+    }
+
+   public:
+    IncrementalGame(std::vector<FieldSpec> layout, unsigned int players,
+                    unsigned int rounds, std::uint64_t seed)
+        : layout(std::move(layout)),
+          players(players),
+          rounds(rounds),
+          seed(seed),
+          firstTouch(this->layout.size(), untouched),
+          checkpoints(),
+          outcome{0, 0},
+          simulatedRounds(0) {
+        WorldCup2022 initial(this->layout);
+        for (unsigned int seat = 0; seat < players; seat++) {
+            initial.addPlayer(seatName(seat));
+        }
+        simulateFrom({0, initial.getState(), 0});
+    }
+
+    GameOutcome const &getOutcome() const { return outcome; }
+
+    // Pierwsza runda, w której gra dotknęła pola (lub -1, jeśli nigdy).
+    int divergenceRound(unsigned int field) const {
+        return firstTouch[field] == untouched ? -1 : firstTouch[field];
+    }
+
+    // Łączna liczba rund zasymulowanych od utworzenia gry.
+    std::uint64_t getSimulatedRounds() const { return simulatedRounds; }
+
+    // Zmienia parametry pola i przelicza grę od punktu rozbieżności.
+    GameOutcome const &retune(unsigned int field, FieldSpec const &spec) {
+        layout[field] = spec;
+        if (firstTouch[field] == untouched) {
+            return outcome;
+        }
+        for (auto const &checkpoint : checkpoints) {
+            if (checkpoint.round == firstTouch[field]) {
+                simulateFrom(checkpoint);
+                break;
+            }
+        }
+        return outcome;
+    }
+};
+
+// Zbiór gier o kolejnych ziarnach przeliczanych przyrostowo, równolegle.
+class IncrementalRunner {
+   private:
+    std::vector<IncrementalGame> games;
+    unsigned int players;
+    unsigned int threads;
+
+   public:
+    IncrementalRunner(std::vector<FieldSpec> const &layout,
+                      unsigned int players, unsigned int rounds,
+                      std::uint64_t firstSeed, std::uint64_t count,
+                      unsigned int threads)
+        : games(), players(players), threads(threads) {
+        games.reserve(count);
+        for (std::uint64_t i = 0; i < count; i++) {
+            games.emplace_back(layout, players, rounds, firstSeed + i);
+        }
+    }
+
+    // Liczba wygranych na każdym miejscu w kolejności ruchów. Rzuca
+    // std::out_of_range, gdy zwycięzca gry nie jest żadnym z miejsc.
+    std::vector<std::uint64_t> wins() const {
+        std::vector<std::uint64_t> result(players, 0);
+        for (auto const &game : games) {
+            result.at(game.getOutcome().winnerSeat)++;
+        }
+        return result;
+    }
+
+    std::vector<std::uint64_t> retune(unsigned int field,
+                                      FieldSpec const &spec) {
+        parallelForSeeds(0, games.size(), threads,
+                         [&](unsigned int, std::uint64_t i) {
+                             games[i].retune(field, spec);
+                         });
+        return wins();
+    }
+
+    std::uint64_t simulatedRounds() const {
+        std::uint64_t total = 0;
+        for (auto const &game : games) {
+            total += game.getSimulatedRounds();
+        }
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "worldcup_recording.h"
+
+// Narzędzie: worldcup_seek record nagranie [liczba rund] [liczba graczy]
+//            [co ile rund punkt kontrolny] [ziarno]
+//            worldcup_seek seek nagranie runda...
+// Nagrywa długą grę (plansza z niskimi opłatami, na której gracze rzadko
+// bankrutują) albo przewija nagranie do podanych rund, wypisując stan
+// graczy i czas przewinięcia.
+namespace {
+    std::vector<FieldSpec> longLayout() {
+        return {{FieldType::Beginning, "Początek sezonu", 60, 0.0},
+                {FieldType::Match, "Mecz z San Marino", 20, 1.0},
+                {FieldType::Empty, "Dzień wolny od treningu", 0, 0.0},
+                {FieldType::Goal, "Gol", 30, 0.0},
+                {FieldType::YellowCard, "Żółta kartka", 2, 0.0},
+                {FieldType::Match, "Mecz z Meksykiem", 40, 1.0},
+                {FieldType::Bookmaker, "Bukmacher", 20, 0.0},
+                {FieldType::Penalty, "Rzut karny", 50, 0.0},
+                {FieldType::Match, "Mecz z Francją", 30, 1.0},
+                {FieldType::Goal, "Gol", 20, 0.0}};
+    }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0]
+                  << " record recording [rounds players interval seed]\n"
+                  << "       " << argv[0] << " seek recording round...\n";
+        return 1;
+    }
+    std::string const mode = argv[1];
+    try {
+        if (mode == "record") {
+            unsigned int rounds = argc > 3 ? std::stoul(argv[3]) : 100000;
+            unsigned int players = argc > 4 ? std::stoul(argv[4]) : 4;
+            unsigned int interval = argc > 5 ? std::stoul(argv[5]) : 1000;
+            std::uint64_t seed = argc > 6 ? std::stoull(argv[6]) : 0;
+            auto layout = longLayout();
+            auto engine = std::make_shared<std::mt19937_64>(seed);
+            WorldCup2022 game(layout);
+            game.addDie(std::make_shared<RandomDie>(engine));
+            game.addDie(std::make_shared<RandomDie>(engine));
+            for (unsigned int seat = 0; seat < players; seat++) {
+                game.addPlayer(seatName(seat));
+            }
+            game.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+            std::ofstream out(argv[2], std::ios::binary);
+            auto start = std::chrono::steady_clock::now();
+            unsigned int played =
+                recordGame(game, layout, rounds, interval, out);
+            out.close();
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::cout << played << " rounds recorded in " << elapsed.count()
+                      << " s, " << std::filesystem::file_size(argv[2])
+                      << " bytes\n";
+        } else if (mode == "seek") {
+            GameRecording recording(argv[2]);
+            std::cout << "rounds " << recording.firstRound() << " - "
+                      << recording.lastRound() << ", "
+                      << recording.checkpoints() << " checkpoints\n";
+            for (int i = 3; i < argc; i++) {
+                auto start = std::chrono::steady_clock::now();
+                GameState state = recording.seek(std::stoul(argv[i]));
+                std::chrono::duration<double, std::milli> elapsed =
+                    std::chrono::steady_clock::now() - start;
+                std::cout << "round " << state.round << " ("
+                          << elapsed.count() << " ms, "
+                          << recording.replayedRounds()
+                          << " rounds replayed):";
+                for (auto const &[name, player] : state.players) {
+                    std::cout << ' ' << name << '=' << player.money << '@'
+                              << player.field;
+                }
+                std::cout << '\n';
+            }
+        } else {
+            std::cerr << "unknown mode " << mode << '\n';
+            return 1;
+        }
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+#ifndef WORLDCUP_SIMULATION_H
+#define WORLDCUP_SIMULATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worldcup2022.h"
+
+// Kostka sześcienna losująca z generatora współdzielonego przez wszystkie
+// kostki jednej gry. Gra o danym ziarnie jest więc w pełni powtarzalna, co
+// pozwala porównywać warianty na tych samych liczbach losowych.
+// Zamiast std::uniform_int_distribution (zależnej od implementacji
+// biblioteki) używamy reszty z dzielenia - obciążenie jest pomijalne.
+class RandomDie : public Die {
+   private:
+    std::shared_ptr<std::mt19937_64> const engine;
+
+   public:
+    explicit RandomDie(std::shared_ptr<std::mt19937_64> engine)
+        : engine(std::move(engine)) {}
+
+    [[nodiscard]] unsigned short roll() const override {
+        return (*engine)() % 6 + 1;
+    }
+};
+
+// Tablica wyników zapamiętująca tylko zwycięzcę i liczbę rozegranych rund.
+class OutcomeScoreBoard : public ScoreBoard {
+   private:
+    std::string winner;
+    unsigned int rounds = 0;
+
+   public:
+    void onRound(unsigned int roundNo) override { rounds = roundNo + 1; }
+
+    void onTurn(std::string const &playerName, std::string const &playerStatus,
+                std::string const &squareName, unsigned int money) override {
+        (void)playerName;
+        (void)playerStatus;
+        (void)squareName;
+        (void)money;
+    }
+
+    void onWin(std::string const &playerName) override { winner = playerName; }
+
+    std::string const &getWinner() const { return winner; }
+
+    unsigned int getRounds() const { return rounds; }
+};
+
+// Wynik pojedynczej gry z punktu widzenia analiz: miejsce (kolejność ruchu)
+// zwycięzcy i długość gry.
+struct GameOutcome {
+    unsigned int winnerSeat;
+    unsigned int rounds;
+};
+
+inline std::string seatName(unsigned int seat) {
+    return "Player-" + std::to_string(seat + 1);
+}
+
+// Wersja semantyki silnika. Należy ją zwiększyć przy każdej zmianie, która
+// może zmienić wynik gry o danym ziarnie (np. w zapisanych wynikach).
+inline constexpr unsigned int engineVersion = 1;
+
+// Rozgrywa jedną grę players graczy z dwiema losowymi kostkami o podanym
+// ziarnie na planszy o podanym układzie (z opcjonalnymi obserwatorami pól
+// i tur).
+inline GameOutcome simulateGame(std::vector<FieldSpec> const &layout,
+                                unsigned int players, unsigned int rounds,
+                                std::uint64_t seed,
+                                FieldObserver *observer = nullptr,
+                                TurnObserver *turnObserver = nullptr) {
+    auto engine = std::make_shared<std::mt19937_64>(seed);
+    auto scoreboard = std::make_shared<OutcomeScoreBoard>();
+    WorldCup2022 worldCup(layout);
+    worldCup.addDie(std::make_shared<RandomDie>(engine));
+    worldCup.addDie(std::make_shared<RandomDie>(engine));
+    for (unsigned int seat = 0; seat < players; seat++) {
+        worldCup.addPlayer(seatName(seat));
+    }
+    worldCup.setScoreBoard(scoreboard);
+    worldCup.setFieldObserver(observer);
+    worldCup.setTurnObserver(turnObserver);
+    worldCup.play(rounds);
+
+    unsigned int winnerSeat = 0;
+    while (winnerSeat < players &&
+           seatName(winnerSeat) != scoreboard->getWinner()) {
+        winnerSeat++;
+    }
+    return {winnerSeat, scoreboard->getRounds()};
+}
+
+inline GameOutcome simulateGame(unsigned int players, unsigned int rounds,
+                                std::uint64_t seed) {
+    return simulateGame(defaultLayout(), players, rounds, seed);
+}
+
+// Wywołuje job(seed) dla seedów z [firstSeed, firstSeed + count) na threads
+// wątkach. Wątki pobierają kolejne porcje ziaren ze wspólnego licznika, więc
+// obciążenie wyrównuje się samo, nawet gdy gry mają różną długość.
+// Każdy wątek dostaje swój numer, żeby mógł agregować wyniki lokalnie.
+inline void parallelForSeeds(
+    std::uint64_t firstSeed, std::uint64_t count, unsigned int threads,
+    std::function<void(unsigned int, std::uint64_t)> const &job) {
+    constexpr std::uint64_t batch = 64;
+    threads = std::max(1u, threads);
+    std::atomic<std::uint64_t> next(0);
+    auto worker = [&](unsigned int id) {
+        for (;;) {
+            std::uint64_t begin = next.fetch_add(batch);
+            if (begin >= count) {
+                return;
+            }
+            std::uint64_t end = std::min(count, begin + batch);
+            for (std::uint64_t i = begin; i < end; i++) {
+                job(id, firstSeed + i);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int id = 1; id < threads; id++) {
+        pool.emplace_back(worker, id);
+    }
+    worker(0);
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+// Parametry serii symulacji: gry o ziarnach z [firstSeed, lastSeed).
+struct SimulationConfig {
+    std::vector<FieldSpec> layout;
+    unsigned int players;
+    unsigned int rounds;
+    std::uint64_t firstSeed;
+    std::uint64_t lastSeed;
+};
+
+// Wyniki serii symulacji. Wszystkie pola są sumami, więc wyniki rozłącznych
+// zakresów ziaren można łączyć dodawaniem.
+struct SimulationAggregate {
+    std::uint64_t games = 0;
+    std::uint64_t totalRounds = 0;
+    std::vector<std::uint64_t> wins;
+
+    void merge(SimulationAggregate const &other) {
+        games += other.games;
+        totalRounds += other.totalRounds;
+        if (wins.size() < other.wins.size()) {
+            wins.resize(other.wins.size(), 0);
+        }
+        for (size_t seat = 0; seat < other.wins.size(); seat++) {
+            wins[seat] += other.wins[seat];
+        }
+    }
+};
+
+// observerFor(id) (jeśli podane) daje obserwatora pól dla kolejnej gry
+// na wątku id.
+inline SimulationAggregate runSimulation(
+    SimulationConfig const &config, unsigned int threads,
+    std::function<FieldObserver *(unsigned int)> const &observerFor = {}) {
+    std::vector<SimulationAggregate> local(std::max(1u, threads));
+    for (auto &aggregate : local) {
+        aggregate.wins.assign(config.players, 0);
+    }
+    std::uint64_t count = config.lastSeed > config.firstSeed
+                              ? config.lastSeed - config.firstSeed
+                              : 0;
+    parallelForSeeds(config.firstSeed, count, threads,
+                     [&](unsigned int id, std::uint64_t seed) {
+                         GameOutcome outcome = simulateGame(
+                             config.layout, config.players, config.rounds,
+                             seed, observerFor ? observerFor(id) : nullptr);
+                         local[id].games++;
+                         local[id].totalRounds += outcome.rounds;
+                         local[id].wins[outcome.winnerSeat]++;
+                     });
+    SimulationAggregate result;
+    result.wins.assign(config.players, 0);
+    for (auto const &aggregate : local) {
+        result.merge(aggregate);
+    }
+    return result;
+}
+
+#endif
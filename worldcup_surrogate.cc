@@ -0,0 +1,85 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "worldcup_surrogate.h"
+
+// Narzędzie: worldcup_surrogate train model [punkty planu] [gry w punkcie]
+//            [min graczy] [max graczy] [wątki]
+//            worldcup_surrogate predict model gracze waga...
+// Uczy model zastępczy na domyślnej planszy (wagi meczów 0.5 - 5.0) albo
+// przewiduje z niego prawdopodobieństwa wygranej kolejnych miejsc dla
+// podanych wag meczów, z przedziałem błędu i czasem odpowiedzi.
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0]
+                  << " train model [points games minPlayers maxPlayers "
+                     "threads]\n"
+                  << "       " << argv[0] << " predict model players weight...\n";
+        return 1;
+    }
+    std::string const mode = argv[1];
+    try {
+        if (mode == "train") {
+            SurrogateConfig config;
+            config.points = argc > 3 ? std::stoul(argv[3]) : 64;
+            config.games = argc > 4 ? std::stoull(argv[4]) : 20000;
+            config.minPlayers = argc > 5 ? std::stoul(argv[5]) : 2;
+            config.maxPlayers = argc > 6 ? std::stoul(argv[6]) : 4;
+            unsigned int threads =
+                argc > 7 ? std::stoul(argv[7])
+                         : std::max(1u, std::thread::hardware_concurrency());
+            auto start = std::chrono::steady_clock::now();
+            SurrogateModel model = SurrogateModel::train(config, threads);
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::ofstream out(argv[2]);
+            model.write(out);
+            if (!out) {
+                std::cerr << "cannot write " << argv[2] << '\n';
+                return 1;
+            }
+            std::cout << "trained in " << elapsed.count() << " s\n";
+            for (unsigned int players = config.minPlayers;
+                 players <= config.maxPlayers; players++) {
+                std::cout << players << " players, cross-validation error:";
+                for (unsigned int seat = 0; seat < players; seat++) {
+                    std::cout << ' ' << model.crossValidation(players, seat);
+                }
+                std::cout << '\n';
+            }
+        } else if (mode == "predict") {
+            std::ifstream in(argv[2]);
+            SurrogateModel model = SurrogateModel::read(in);
+            if (argc < 4) {
+                std::cerr << "missing player count\n";
+                return 1;
+            }
+            unsigned int players = std::stoul(argv[3]);
+            std::vector<double> weights;
+            for (int i = 4; i < argc; i++) {
+                weights.push_back(std::stod(argv[i]));
+            }
+            auto start = std::chrono::steady_clock::now();
+            WinRateEstimate estimate = model.predict(players, weights);
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+            for (unsigned int seat = 0; seat < players; seat++) {
+                std::cout << seatName(seat) << ": "
+                          << estimate.probability[seat] << " +- "
+                          << estimate.halfWidth[seat] << '\n';
+            }
+            std::cout << (estimate.simulated ? "simulation" : "model")
+                      << ", " << elapsed.count() << " ms\n";
+        } else {
+            std::cerr << "unknown mode " << mode << '\n';
+            return 1;
+        }
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,457 @@
+#ifndef WORLDCUP_SURROGATE_H
+#define WORLDCUP_SURROGATE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <istream>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "worldcup_simulation.h"
+
+// Model zastępczy: natychmiastowe przewidywanie prawdopodobieństwa wygranej
+// każdego miejsca w kolejności ruchów w zależności od wag meczów (pól Match
+// planszy) i liczby graczy - zamiast symulacji trwającej sekundy.
+//
+// Model uczy się offline na planie doświadczenia: dla każdej liczby graczy
+// points punktów w przestrzeni wag wybranych hiperkostką łacińską (każdy
+// przedział wag każdego meczu dostaje dokładnie jeden punkt), w każdym
+// punkcie games gier o tych samych ziarnach (wspólne liczby losowe
+// zmniejszają szum różnic między punktami). Do wyników dopasowujemy
+// metodą najmniejszych kwadratów wielomian drugiego stopnia od
+// znormalizowanych wag, osobno dla każdej liczby graczy i każdego miejsca.
+//
+// Przedział błędu przewidywania to 95% przedział ufności wartości modelu:
+// wariancja resztowa dopasowania razy x^T (X^T X)^-1 x plus wariancja
+// próby games gier (wspólne ziarna przenoszą jej błąd na wszystkie punkty
+// jednakowo, więc dopasowanie go nie uśrednia). Dokładność
+// samego wielomianu opisuje błąd walidacji krzyżowej leave-one-out,
+// liczony przy uczeniu. Zapytanie spoza obszaru uczenia (waga poza
+// przedziałem albo inna liczba graczy) jest liczone symulacją.
+struct SurrogateConfig {
+    std::vector<FieldSpec> layout = defaultLayout();
+    unsigned int minPlayers = 2;
+    unsigned int maxPlayers = 4;
+    unsigned int rounds = 100;
+    // Przedział wag każdego meczu.
+    double minWeight = 0.5;
+    double maxWeight = 5.0;
+    // Punkty planu na każdą liczbę graczy i gry w każdym punkcie.
+    unsigned int points = 64;
+    std::uint64_t games = 20000;
+    std::uint64_t seed = 0;
+};
+
+struct WinRateEstimate {
+    std::vector<double> probability;
+    // Połowa szerokości 95% przedziału.
+    std::vector<double> halfWidth;
+    // Czy wynik pochodzi z symulacji (zapytanie spoza obszaru uczenia).
+    bool simulated = false;
+};
+
+class SurrogateModel {
+   public:
+    static constexpr double z = 1.959964;
+
+   private:
+    // Dopasowanie dla jednej liczby graczy.
+    struct Fit {
+        // (X^T X)^-1, wierszami.
+        std::vector<double> inverse;
+        // coefficients[seat] - współczynniki wielomianu.
+        std::vector<std::vector<double>> coefficients;
+        std::vector<double> residualVariance;
+        // Pierwiastek średniego kwadratu błędu leave-one-out.
+        std::vector<double> crossValidation;
+    };
+
+    std::vector<FieldSpec> layout;
+    std::vector<size_t> matchFields;
+    unsigned int rounds = 0;
+    unsigned int minPlayers = 0;
+    unsigned int maxPlayers = 0;
+    double minWeight = 0;
+    double maxWeight = 0;
+    std::uint64_t games = 0;
+    std::vector<Fit> fits;
+    std::uint64_t fallbackGames = 20000;
+    unsigned int fallbackThreads = 1;
+
+    void findMatches() {
+        matchFields.clear();
+        for (size_t field = 0; field < layout.size(); field++) {
+            if (layout[field].type == FieldType::Match) {
+                matchFields.push_back(field);
+            }
+        }
+    }
+
+    size_t parameters() const {
+        size_t d = matchFields.size();
+        return 1 + d + d * (d + 1) / 2;
+    }
+
+    // Wyrazy wielomianu: 1, z_i, z_i z_j (i <= j), gdzie z - wagi
+    // przeskalowane do [-1, 1].
+    std::vector<double> features(std::vector<double> const &weights) const {
+        double center = (minWeight + maxWeight) / 2;
+        double half = (maxWeight - minWeight) / 2;
+        std::vector<double> scaled;
+        for (double weight : weights) {
+            scaled.push_back((weight - center) / half);
+        }
+        std::vector<double> row{1.0};
+        row.insert(row.end(), scaled.begin(), scaled.end());
+        for (size_t i = 0; i < scaled.size(); i++) {
+            for (size_t j = i; j < scaled.size(); j++) {
+                row.push_back(scaled[i] * scaled[j]);
+            }
+        }
+        return row;
+    }
+
+    // Odwrotność macierzy symetrycznej dodatnio określonej n x n przez
+    // rozkład Cholesky'ego (z niewielką regularyzacją na przekątnej).
+    static std::vector<double> invert(std::vector<double> a, size_t n) {
+        double trace = 0;
+        for (size_t i = 0; i < n; i++) {
+            trace += a[i * n + i];
+        }
+        for (size_t i = 0; i < n; i++) {
+            a[i * n + i] += 1e-12 * trace;
+        }
+        // a = L L^T, L w dolnym trójkącie a.
+        for (size_t j = 0; j < n; j++) {
+            double diagonal = a[j * n + j];
+            for (size_t k = 0; k < j; k++) {
+                diagonal -= a[j * n + k] * a[j * n + k];
+            }
+            if (diagonal <= 0) {
+                throw std::runtime_error("surrogate design is degenerate");
+            }
+            a[j * n + j] = std::sqrt(diagonal);
+            for (size_t i = j + 1; i < n; i++) {
+                double sum = a[i * n + j];
+                for (size_t k = 0; k < j; k++) {
+                    sum -= a[i * n + k] * a[j * n + k];
+                }
+                a[i * n + j] = sum / a[j * n + j];
+            }
+        }
+        // Kolumny odwrotności: L y = e, L^T x = y.
+        std::vector<double> inverse(n * n);
+        std::vector<double> column(n);
+        for (size_t c = 0; c < n; c++) {
+            for (size_t i = 0; i < n; i++) {
+                double sum = i == c ? 1.0 : 0.0;
+                for (size_t k = 0; k < i; k++) {
+                    sum -= a[i * n + k] * column[k];
+                }
+                column[i] = sum / a[i * n + i];
+            }
+            for (size_t i = n; i-- > 0;) {
+                double sum = column[i];
+                for (size_t k = i + 1; k < n; k++) {
+                    sum -= a[k * n + i] * column[k];
+                }
+                column[i] = sum / a[i * n + i];
+            }
+            for (size_t i = 0; i < n; i++) {
+                inverse[i * n + c] = column[i];
+            }
+        }
+        return inverse;
+    }
+
+    // x^T M x dla macierzy n x n.
+    static double quadratic(std::vector<double> const &matrix,
+                            std::vector<double> const &x) {
+        size_t n = x.size();
+        double sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            double row = 0;
+            for (size_t j = 0; j < n; j++) {
+                row += matrix[i * n + j] * x[j];
+            }
+            sum += x[i] * row;
+        }
+        return sum;
+    }
+
+    std::vector<FieldSpec> layoutWith(std::vector<double> const &weights) const {
+        std::vector<FieldSpec> result = layout;
+        for (size_t i = 0; i < matchFields.size(); i++) {
+            result[matchFields[i]].weight = weights[i];
+        }
+        return result;
+    }
+
+    Fit fit(std::vector<std::vector<double>> const &design,
+            std::vector<std::vector<double>> const &rates,
+            unsigned int players) const {
+        size_t n = parameters();
+        size_t count = design.size();
+        std::vector<std::vector<double>> rows;
+        std::vector<double> normal(n * n, 0.0);
+        for (auto const &point : design) {
+            rows.push_back(features(point));
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    normal[i * n + j] += rows.back()[i] * rows.back()[j];
+                }
+            }
+        }
+        Fit result;
+        result.inverse = invert(normal, n);
+        std::vector<double> leverage(count);
+        for (size_t k = 0; k < count; k++) {
+            leverage[k] = quadratic(result.inverse, rows[k]);
+        }
+        for (unsigned int seat = 0; seat < players; seat++) {
+            std::vector<double> moment(n, 0.0);
+            for (size_t k = 0; k < count; k++) {
+                for (size_t i = 0; i < n; i++) {
+                    moment[i] += rows[k][i] * rates[k][seat];
+                }
+            }
+            std::vector<double> coefficients(n, 0.0);
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    coefficients[i] += result.inverse[i * n + j] * moment[j];
+                }
+            }
+            double squares = 0;
+            double crossSquares = 0;
+            for (size_t k = 0; k < count; k++) {
+                double fitted = std::inner_product(
+                    rows[k].begin(), rows[k].end(), coefficients.begin(), 0.0);
+                double residual = rates[k][seat] - fitted;
+                squares += residual * residual;
+                double left = residual / std::max(1e-9, 1 - leverage[k]);
+                crossSquares += left * left;
+            }
+            result.coefficients.push_back(std::move(coefficients));
+            result.residualVariance.push_back(squares / (count - n));
+            result.crossValidation.push_back(std::sqrt(crossSquares / count));
+        }
+        return result;
+    }
+
+   public:
+    // Uczy model planem z config (symulacje na threads wątkach). Rzuca
+    // std::invalid_argument, gdy punktów jest za mało na wielomian albo
+    // liczby graczy wychodzą poza [2, WorldCup2022::maxPlayers].
+    static SurrogateModel train(SurrogateConfig const &config,
+                                unsigned int threads) {
+        SurrogateModel model;
+        model.layout = config.layout;
+        model.rounds = config.rounds;
+        model.minPlayers = config.minPlayers;
+        model.maxPlayers = config.maxPlayers;
+        model.minWeight = config.minWeight;
+        model.maxWeight = config.maxWeight;
+        model.games = config.games;
+        model.fallbackThreads = threads;
+        model.findMatches();
+        if (config.points <= model.parameters() ||
+            config.minPlayers < 2 || config.minPlayers > config.maxPlayers ||
+            config.maxPlayers > WorldCup2022::maxPlayers ||
+            !(config.minWeight < config.maxWeight) || config.games == 0) {
+            throw std::invalid_argument("surrogate design too small");
+        }
+
+        // Hiperkostka łacińska: w każdym wymiarze losowa permutacja
+        // przedziałów, punkt w środku przedziału.
+        std::mt19937_64 engine(config.seed);
+        size_t d = model.matchFields.size();
+        std::vector<std::vector<double>> design(
+            config.points, std::vector<double>(d));
+        std::vector<unsigned int> strata(config.points);
+        for (size_t dimension = 0; dimension < d; dimension++) {
+            std::iota(strata.begin(), strata.end(), 0);
+            std::shuffle(strata.begin(), strata.end(), engine);
+            for (unsigned int k = 0; k < config.points; k++) {
+                design[k][dimension] =
+                    config.minWeight + (strata[k] + 0.5) / config.points *
+                                           (config.maxWeight -
+                                            config.minWeight);
+            }
+        }
+
+        for (unsigned int players = config.minPlayers;
+             players <= config.maxPlayers; players++) {
+            std::vector<std::vector<double>> rates;
+            for (auto const &point : design) {
+                SimulationAggregate outcome = runSimulation(
+                    {model.layoutWith(point), players, config.rounds, 0,
+                     config.games},
+                    threads);
+                std::vector<double> rate;
+                for (auto wins : outcome.wins) {
+                    rate.push_back(static_cast<double>(wins) /
+                                   outcome.games);
+                }
+                rates.push_back(std::move(rate));
+            }
+            model.fits.push_back(model.fit(design, rates, players));
+        }
+        return model;
+    }
+
+    // Liczba gier i wątków symulacji dla zapytań spoza obszaru uczenia.
+    void setFallback(std::uint64_t games, unsigned int threads) {
+        fallbackGames = games;
+        fallbackThreads = threads;
+    }
+
+    size_t weights() const { return matchFields.size(); }
+
+    bool covers(unsigned int players,
+                std::vector<double> const &weights) const {
+        return players >= minPlayers && players <= maxPlayers &&
+               std::all_of(weights.begin(), weights.end(), [this](double w) {
+                   return w >= minWeight && w <= maxWeight;
+               });
+    }
+
+    // Błąd walidacji krzyżowej modelu dla danej liczby graczy i miejsca.
+    double crossValidation(unsigned int players, unsigned int seat) const {
+        return fits[players - minPlayers].crossValidation[seat];
+    }
+
+    // weights - wagi kolejnych meczów planszy. Rzuca std::invalid_argument
+    // przy złej liczbie wag lub liczbie graczy spoza
+    // [2, WorldCup2022::maxPlayers] (symulacja zastępcza jej nie przyjmie).
+    WinRateEstimate predict(unsigned int players,
+                            std::vector<double> const &weights) const {
+        if (players < 2 || players > WorldCup2022::maxPlayers) {
+            throw std::invalid_argument("wrong number of players");
+        }
+        if (weights.size() != matchFields.size()) {
+            throw std::invalid_argument("wrong number of match weights");
+        }
+        WinRateEstimate estimate;
+        if (!covers(players, weights)) {
+            estimate.simulated = true;
+            SimulationAggregate outcome = runSimulation(
+                {layoutWith(weights), players, rounds, 0, fallbackGames},
+                fallbackThreads);
+            for (auto wins : outcome.wins) {
+                double p = static_cast<double>(wins) / outcome.games;
+                estimate.probability.push_back(p);
+                estimate.halfWidth.push_back(
+                    z * std::sqrt(p * (1 - p) / outcome.games));
+            }
+            return estimate;
+        }
+        Fit const &model = fits[players - minPlayers];
+        std::vector<double> row = features(weights);
+        double spread = quadratic(model.inverse, row);
+        for (unsigned int seat = 0; seat < players; seat++) {
+            double p = std::inner_product(row.begin(), row.end(),
+                                          model.coefficients[seat].begin(),
+                                          0.0);
+            p = std::clamp(p, 0.0, 1.0);
+            estimate.probability.push_back(p);
+            estimate.halfWidth.push_back(
+                z * std::sqrt(model.residualVariance[seat] * spread +
+                              p * (1 - p) / games));
+        }
+        return estimate;
+    }
+
+    // Format tekstowy: nagłówek z obszarem uczenia, układ planszy (nazwy
+    // w cudzysłowach) i dopasowania.
+    void write(std::ostream &out) const {
+        out << "surrogate " << engineVersion << ' ' << rounds << ' '
+            << minPlayers << ' ' << maxPlayers << ' ' << games << ' '
+            << std::setprecision(17) << minWeight << ' ' << maxWeight << ' '
+            << layout.size() << '\n';
+        for (auto const &field : layout) {
+            out << static_cast<int>(field.type) << ' ' << field.value << ' '
+                << field.weight << ' ' << std::quoted(field.name) << '\n';
+        }
+        for (auto const &model : fits) {
+            for (double value : model.inverse) {
+                out << value << ' ';
+            }
+            out << '\n';
+            for (size_t seat = 0; seat < model.coefficients.size(); seat++) {
+                out << model.residualVariance[seat] << ' '
+                    << model.crossValidation[seat];
+                for (double value : model.coefficients[seat]) {
+                    out << ' ' << value;
+                }
+                out << '\n';
+            }
+        }
+        out << std::setprecision(6);
+    }
+
+    // Rzuca std::runtime_error przy niepoprawnym pliku lub modelu innej
+    // wersji silnika.
+    static SurrogateModel read(std::istream &in) {
+        SurrogateModel model;
+        std::string magic;
+        unsigned int version = 0;
+        size_t fields = 0;
+        in >> magic >> version >> model.rounds >> model.minPlayers >>
+            model.maxPlayers >> model.games >> model.minWeight >>
+            model.maxWeight >> fields;
+        if (!in || magic != "surrogate" || model.minPlayers < 2 ||
+            model.minPlayers > model.maxPlayers ||
+            model.maxPlayers > WorldCup2022::maxPlayers || model.games == 0 ||
+            !(model.minWeight < model.maxWeight)) {
+            throw std::runtime_error("not a surrogate model");
+        }
+        if (version != engineVersion) {
+            throw std::runtime_error("surrogate model from engine version " +
+                                     std::to_string(version));
+        }
+        // Liczby pól i współczynników pochodzą z pliku, więc elementy
+        // dokładamy po jednym i przerywamy przy pierwszym błędzie odczytu:
+        // pamięć rośnie tylko z danymi, które faktycznie są w strumieniu.
+        auto readValues = [&in](std::vector<double> &values, size_t count) {
+            for (double value; values.size() < count && in >> value;) {
+                values.push_back(value);
+            }
+        };
+        for (size_t field = 0; field < fields && in; field++) {
+            FieldSpec &spec = model.layout.emplace_back();
+            int type;
+            in >> type >> spec.value >> spec.weight >> std::quoted(spec.name);
+            spec.type = static_cast<FieldType>(type);
+        }
+        model.findMatches();
+        size_t n = model.parameters();
+        for (unsigned int players = model.minPlayers;
+             players <= model.maxPlayers && in; players++) {
+            Fit fit;
+            readValues(fit.inverse, n * n);
+            for (unsigned int seat = 0; seat < players && in; seat++) {
+                double variance;
+                double crossValidation;
+                in >> variance >> crossValidation;
+                std::vector<double> coefficients;
+                readValues(coefficients, n);
+                fit.residualVariance.push_back(variance);
+                fit.crossValidation.push_back(crossValidation);
+                fit.coefficients.push_back(std::move(coefficients));
+            }
+            model.fits.push_back(std::move(fit));
+        }
+        if (!in) {
+            throw std::runtime_error("truncated surrogate model");
+        }
+        return model;
+    }
+};
+
+#endif
@@ -1,5 +1,31 @@
-#include "worldcup2022.h"
+// Test 717 sprawdza księgę przepływów pieniędzy, która istnieje tylko
+// w kompilacji z WORLDCUP_LEDGER.
+#if TEST_NUM == 717
+#define WORLDCUP_LEDGER
+#endif
 
+#include "worldcup2022.h"
+#include "worldcup_cache.h"
+#include "worldcup_cashflow.h"
+#include "worldcup_codec.h"
+#include "worldcup_compactboard.h"
+#include "worldcup_fairness.h"
+#include "worldcup_fuzz.h"
+#include "worldcup_golden.h"
+#include "worldcup_hugeboard.h"
+#include "worldcup_hugepages.h"
+#include "worldcup_loadgen.h"
+#include "worldcup_markov.h"
+#include "worldcup_profiler.h"
+#include "worldcup_protocol.h"
+#include "worldcup_recording.h"
+#include "worldcup_resimulation.h"
+#include "worldcup_surrogate.h"
+#include "worldcup_tournament.h"
+#include "worldcup_trace.h"
+#include "worldcup_tracesink.h"
+
+#include <deque>
 #include <sstream>
 #include <memory>
 #include <string>
@@ -709,4 +735,2063 @@ int main() {
             "=== Zwycięzca: Player-1\n"
             "=== Zwycięzca: Player-2\n");
 #endif
+
+// 7xx Testy narzędzi wokół silnika
+
+// Profilowanie nie zmienia przebiegu gry
+#if TEST_NUM == 700
+    PlayProfiler profiler(1);
+    std::shared_ptr<text::TextScoreBoard> scoreboard = std::make_shared<text::TextScoreBoard>();
+
+    std::shared_ptr<WorldCup> worldCup2022 = std::make_shared<WorldCup2022>();
+    worldCup2022->addDie(profiler.wrap(std::make_shared<dice::FixedDie>()));
+    worldCup2022->addDie(profiler.wrap(std::make_shared<dice::FixedDie>()));
+    worldCup2022->addPlayer("Lewandowski");
+    worldCup2022->addPlayer("Messi");
+    worldCup2022->addPlayer("Ronaldo");
+    worldCup2022->setScoreBoard(profiler.wrap(scoreboard));
+
+    profiler.play(*worldCup2022, 100);
+
+    scoreboard->result().lastRound().equals("Lewandowski [w grze] [315] - Początek sezonu\n"
+                                            "Messi [*** bankrut ***] [0] - Żółta kartka\n"
+                                            "=== Zwycięzca: Lewandowski\n");
+    assert(profiler.diceProfile().callCount() == 26);
+    assert(profiler.diceProfile().latencies().count() == 26);
+    assert(profiler.scoreBoardProfile().callCount() == 6 + 17 + 1);
+    assert(profiler.playLatencies().count() == 1);
+
+    // Profilowana jest tylko co gameEvery-ta gra; pozostałe dostają
+    // oryginalne kostki i tablicę wyników.
+    std::shared_ptr<Die> die = std::make_shared<dice::FixedDie>();
+    std::shared_ptr<WorldCup> next = std::make_shared<WorldCup2022>();
+    assert(profiler.wrap(die) == die && profiler.wrap(scoreboard) == scoreboard);
+    next->addDie(profiler.wrap(die));
+    next->addDie(profiler.wrap(die));
+    next->addPlayer("Lewandowski");
+    next->addPlayer("Messi");
+    next->setScoreBoard(profiler.wrap(scoreboard));
+    profiler.play(*next, 10);
+    assert(profiler.gameCount() == 2 && profiler.playLatencies().count() == 1);
+    assert(profiler.diceProfile().callCount() == 26);
+#endif
+
+// Łańcuch Markowa z deterministyczną kostką odtwarza przebieg gry
+#if TEST_NUM == 701
+    std::shared_ptr<text::TextScoreBoard> scoreboard = std::make_shared<text::TextScoreBoard>();
+    std::shared_ptr<WorldCup> worldCup2022 = std::make_shared<WorldCup2022>();
+    worldCup2022->addDie(std::make_shared<dice::FixedDie>(dice::rolls_t{1}));
+    worldCup2022->addDie(std::make_shared<dice::FixedDie>(dice::rolls_t{1}));
+    worldCup2022->addPlayer("Player-1");
+    worldCup2022->addPlayer("Player-2");
+    worldCup2022->setScoreBoard(scoreboard);
+    worldCup2022->play(100);
+
+    std::string log = scoreboard->str();
+    std::string lastRound = log.substr(log.rfind("=== Runda: ") + 11);
+    unsigned int endRound = std::stoul(lastRound);
+
+    auto result = GameLengthSolver({0.0, 1.0}, 2).solve(100);
+    assert(result.endsInRound.size() == endRound + 1);
+    assert(result.endsInRound[endRound] == 1.0);
+    assert(result.unfinished == 0.0 && result.errorBound == 0.0 && result.exact);
+
+    // Przycięty rozkład: prawdziwe wartości leżą w [wynik, wynik + errorBound].
+    std::vector<FieldSpec> layout = defaultLayout();
+    layout.resize(7);
+    GameLengthSolver::Result exact = GameLengthSolver({0.0, 0.5, 0.5}, 2, 1 << 20, 1, layout).solve(8);
+    GameLengthSolver::Result cut = GameLengthSolver({0.0, 0.5, 0.5}, 3, 40, 1, layout).solve(8);
+    assert(exact.exact && exact.errorBound == 0.0);
+    assert(!cut.exact && cut.errorBound > 0.0);
+    double error = 0.0;
+    for (size_t r = 0; r < exact.endsInRound.size(); r++) {
+        assert(cut.endsInRound[r] <= exact.endsInRound[r] + 1e-12);
+        assert(exact.endsInRound[r] <= cut.endsInRound[r] + cut.errorBound + 1e-12);
+        error += exact.endsInRound[r] - cut.endsInRound[r];
+    }
+    error += exact.unfinished - cut.unfinished;
+    assert(error <= cut.errorBound + 1e-12);
+#endif
+
+// Analiza miejsc: gry są powtarzalne, a wygrane sumują się do liczby gier
+#if TEST_NUM == 702
+    GameOutcome first = simulateGame(3, 100, 42);
+    GameOutcome second = simulateGame(3, 100, 42);
+    assert(first.winnerSeat == second.winnerSeat && first.rounds == second.rounds);
+    assert(first.winnerSeat < 3);
+
+    FairnessAnalyzer analyzer(200, 100, 2);
+    analyzer.run();
+    for (unsigned int n = FairnessAnalyzer::minPlayers; n <= FairnessAnalyzer::maxPlayers; n++) {
+        double total = 0;
+        for (unsigned int seat = 0; seat < n; seat++) {
+            auto cell = analyzer.cell(n, seat);
+            assert(cell.lower <= cell.probability &&
+                   cell.probability <= cell.upper);
+            assert(cell.upper > cell.lower && cell.upper - cell.lower < 0.2);
+        }
+        for (unsigned int seat = 0; seat < n; seat++) {
+            total += analyzer.cell(n, seat).probability;
+        }
+        assert(total > 0.8 && total < 1.2);
+    }
+#endif
+
+// Przeliczenie przyrostowe daje ten sam wynik co gra od początku
+#if TEST_NUM == 703
+    std::vector<FieldSpec> changed = defaultLayout();
+    changed[11].value = 500;
+    for (std::uint64_t seed = 0; seed < 200; seed++) {
+        IncrementalGame incremental(defaultLayout(), 3, 50, seed);
+        IncrementalGame fresh(changed, 3, 50, seed);
+        assert(fresh.getOutcome().winnerSeat ==
+               simulateGame(changed, 3, 50, seed).winnerSeat);
+        std::uint64_t before = incremental.getSimulatedRounds();
+        GameOutcome const &outcome = incremental.retune(11, changed[11]);
+        assert(outcome.winnerSeat == fresh.getOutcome().winnerSeat);
+        assert(outcome.rounds == fresh.getOutcome().rounds);
+        assert(incremental.divergenceRound(11) == fresh.divergenceRound(11));
+        int divergence = incremental.divergenceRound(11);
+        std::uint64_t replayed = incremental.getSimulatedRounds() - before;
+        assert(divergence < 0 ? replayed == 0 : replayed == outcome.rounds - divergence);
+    }
+
+    // Gra bez rund kończy się jak play(0): zwycięzca jest wybrany.
+    IncrementalRunner empty(defaultLayout(), 3, 0, 0, 4, 1);
+    std::vector<std::uint64_t> emptyWins = empty.wins();
+    assert(emptyWins.size() == 3);
+    assert(emptyWins[simulateGame(3, 0, 0).winnerSeat] == 4);
+    try {
+        IncrementalGame alone(defaultLayout(), 1, 10, 0);
+        assert(false);
+    } catch (TooFewPlayersException const &) {
+    }
+#endif
+
+// Pamięć podręczna wyników liczy tylko brakujące zakresy ziaren
+#if TEST_NUM == 704
+    auto directory = std::filesystem::temp_directory_path() / "worldcup_cache_test";
+    std::filesystem::remove_all(directory);
+    SimulationCache cache(directory, 2, 32);
+    SimulationConfig config{defaultLayout(), 3, 100, 0, 100};
+
+    SimulationAggregate first = cache.run(config);
+    assert(first.games == 100 && cache.getStatistics().computedGames == 100);
+
+    config.firstSeed = 50;
+    config.lastSeed = 150;
+    SimulationAggregate second = cache.run(config);
+    SimulationAggregate direct = runSimulation(config, 1);
+    assert(second.games == 100 && second.totalRounds == direct.totalRounds);
+    assert(second.wins == direct.wins);
+    assert(cache.getStatistics().cachedGames == 36);
+    assert(cache.getStatistics().computedGames == 164);
+
+    SimulationCache reopened(directory, 1, 32);
+    assert(reopened.run(config).wins == direct.wins);
+    assert(reopened.getStatistics().computedGames == 0);
+
+    config.rounds = 99;
+    reopened.run(config);
+    assert(reopened.getStatistics().computedGames == 100);
+
+    // Urwane i niespójne wiersze są pomijane, a ich zakresy liczone od nowa.
+    config.rounds = 100;
+    std::filesystem::path file =
+        directory / (SimulationCache::key(SimulationCache::canonicalDescription(config)) + ".cache");
+    {
+        std::ofstream out(file, std::ios::app);
+        out << "200 232 32 900 10 10\n";
+        out << "232 264 32 900 10 10 11\n";
+        out << "264 296 31 900 10 10 11\n";
+        out << "296 328 32 900 10 10 12 1\n";
+    }
+    SimulationCache checked(directory, 1, 32);
+    config.firstSeed = 200;
+    config.lastSeed = 328;
+    SimulationAggregate repaired = checked.run(config);
+    assert(checked.getStatistics().cachedGames == 0);
+    assert(repaired.wins == runSimulation(config, 1).wins);
+    std::filesystem::remove_all(directory);
+#endif
+
+// Duża plansza rozlicza ruchy tak samo jak zwykła
+#if TEST_NUM == 705
+    std::mt19937_64 random(7);
+    for (int layoutNo = 0; layoutNo < 300; layoutNo++) {
+        size_t size = 2 + random() % 40;
+        std::vector<FieldSpec> layout;
+        layout.push_back({FieldType::Beginning, "start", static_cast<unsigned int>(random() % 400), 0.0});
+        for (size_t i = 1; i < size; i++) {
+            auto type = static_cast<FieldType>(1 + random() % 6);
+            unsigned int value = type == FieldType::YellowCard ? random() % 4 : random() % 300;
+            layout.push_back({type, "field-" + std::to_string(i), value, 0.5 * (random() % 8)});
+        }
+        Board board(layout);
+        HugeBoard huge(layout);
+        std::vector<Player> expected(3, Player("p"));
+        std::vector<Player> actual(3, Player("p"));
+        for (int move = 0; move < 200; move++) {
+            size_t who = random() % expected.size();
+            if (expected[who].bankrupt()) continue;
+            unsigned int roll = random() % (move % 10 == 0 ? 10 * size : 13);
+            board.playerMove(&expected[who], roll);
+            huge.playerMove(&actual[who], roll);
+            assert(expected[who].getState() == actual[who].getState());
+            assert(board.getState() == huge.getState());
+        }
+    }
+
+    // Hojny Początek nie ratuje gracza, którego nie stać na pierwsze okrążenie.
+    for (unsigned int roll : {3u, 4u, 5u, 7u, 11u}) {
+        std::vector<FieldSpec> generous{{FieldType::Beginning, "start", 2000, 0.0},
+                                        {FieldType::Match, "mecz", 1500, 1.0},
+                                        {FieldType::Empty, "pusty", 0, 0.0}};
+        Board board(generous);
+        HugeBoard huge(generous);
+        Player expected("p");
+        Player actual("p");
+        board.playerMove(&expected, roll);
+        huge.playerMove(&actual, roll);
+        assert(expected.getState() == actual.getState());
+        assert(board.getState() == huge.getState());
+        board.playerMove(&expected, roll);
+        huge.playerMove(&actual, roll);
+        assert(expected.getState() == actual.getState());
+        assert(board.getState() == huge.getState());
+    }
+
+    for (std::uint64_t seed = 0; seed < 100; seed++) {
+        std::shared_ptr<text::TextScoreBoard> reference = std::make_shared<text::TextScoreBoard>();
+        std::shared_ptr<text::TextScoreBoard> scoreboard = std::make_shared<text::TextScoreBoard>();
+        WorldCup2022 regular;
+        WorldCup2022 hugeGame(std::make_shared<HugeBoard>(defaultLayout()));
+        for (WorldCup2022 *game : {&regular, &hugeGame}) {
+            auto engine = std::make_shared<std::mt19937_64>(seed);
+            game->addDie(std::make_shared<RandomDie>(engine));
+            game->addDie(std::make_shared<RandomDie>(engine));
+            for (unsigned int seat = 0; seat < 4; seat++) {
+                game->addPlayer(seatName(seat));
+            }
+        }
+        regular.setScoreBoard(reference);
+        hugeGame.setScoreBoard(scoreboard);
+        regular.play(100);
+        hugeGame.play(100);
+        assert(reference->str() == scoreboard->str());
+    }
+#endif
+
+// Zwarta plansza zachowuje się jak zwykła i zajmuje mniej niż 16 bajtów na pole
+#if TEST_NUM == 706
+    std::mt19937_64 random(11);
+    for (int layoutNo = 0; layoutNo < 300; layoutNo++) {
+        size_t size = 1 + random() % 40;
+        std::vector<FieldSpec> layout;
+        for (size_t i = 0; i < size; i++) {
+            auto type = static_cast<FieldType>(random() % 7);
+            unsigned int value = type == FieldType::YellowCard ? random() % 4 : random() % 300;
+            layout.push_back({type, "field-" + std::to_string(i % 5), value, 0.5 * (random() % 8)});
+        }
+        Board board(layout);
+        CompactBoard compact(layout);
+        std::vector<Player> expected(3, Player("p"));
+        std::vector<Player> actual(3, Player("p"));
+        for (int move = 0; move < 200; move++) {
+            size_t who = random() % expected.size();
+            unsigned int roll = random() % (move % 10 == 0 ? 3 * size : 13);
+            board.playerMove(&expected[who], roll);
+            compact.playerMove(&actual[who], roll);
+            assert(expected[who].getState() == actual[who].getState());
+            assert(board.getState() == compact.getState());
+            assert(board.getFieldName(expected[who].getField()) ==
+                   compact.getFieldName(actual[who].getField()));
+        }
+    }
+
+    std::vector<FieldSpec> layout = defaultLayout();
+    FieldTable table;
+    table.reserve(1000000);
+    for (size_t i = 0; i < 1000000; i++) {
+        FieldSpec spec = layout[i % layout.size()];
+        if (i > 0 && spec.type == FieldType::Beginning) {
+            spec.type = FieldType::Empty;
+        }
+        table.add(spec);
+    }
+    CompactBoard compact(table);
+    assert(compact.memoryUsage().fields == 1000000);
+    assert(compact.memoryUsage().bytesPerField() < 16);
+    assert(HugeBoard(table).memoryUsage().bytesPerField() < 16 + 24 + 1);
+    assert(Board(layout).memoryUsage().bytesPerField() > 50);
+#endif
+
+// Zbankrutowany gracz znika ze stanu gry od razu, także dla tablicy wyników
+// pytającej o stan w trakcie rozgrywki
+#if TEST_NUM == 707
+    class StateScoreBoard : public ScoreBoard {
+       public:
+        WorldCup2022 const *game = nullptr;
+        unsigned int bankruptcies = 0;
+
+        void onRound(unsigned int roundNo) override { (void)roundNo; }
+
+        void onTurn(std::string const &playerName,
+                    std::string const &playerStatus,
+                    std::string const &squareName,
+                    unsigned int money) override {
+            (void)squareName;
+            (void)money;
+            bankruptcies += playerStatus == "*** bankrut ***";
+            // Gracz, który właśnie zbankrutował, jest usuwany po swojej turze.
+            for (auto const &[name, state] : game->getState().players) {
+                assert(!state.bankrupted || name == playerName);
+            }
+        }
+
+        void onWin(std::string const &playerName) override {
+            (void)playerName;
+        }
+    };
+
+    unsigned int bankruptcies = 0;
+    for (unsigned int players = 2; players <= 11; players++) {
+        for (std::uint64_t seed = 0; seed < 20; seed++) {
+            auto engine = std::make_shared<std::mt19937_64>(seed);
+            auto scoreboard = std::make_shared<StateScoreBoard>();
+            WorldCup2022 worldCup;
+            scoreboard->game = &worldCup;
+            worldCup.addDie(std::make_shared<RandomDie>(engine));
+            worldCup.addDie(std::make_shared<RandomDie>(engine));
+            for (unsigned int seat = 0; seat < players; seat++) {
+                worldCup.addPlayer(seatName(seat));
+            }
+            worldCup.setScoreBoard(scoreboard);
+            worldCup.play(200);
+            bankruptcies += scoreboard->bankruptcies;
+        }
+    }
+    assert(bankruptcies > 0);
+#endif
+
+// Przygotowana gra rozgrywana wielokrotnie zaczyna zawsze od stanu początkowego
+#if TEST_NUM == 708
+    auto engine = std::make_shared<std::mt19937_64>(5);
+    auto scoreboard = std::make_shared<text::TextScoreBoard>();
+    WorldCup2022 worldCup;
+    worldCup.addDie(std::make_shared<RandomDie>(engine));
+    worldCup.addDie(std::make_shared<RandomDie>(engine));
+    for (unsigned int seat = 0; seat < 4; seat++) {
+        worldCup.addPlayer(seatName(seat));
+    }
+    worldCup.setScoreBoard(scoreboard);
+
+    PreparedGame prepared = worldCup.prepare();
+    std::string first;
+    for (int repetition = 0; repetition < 3; repetition++) {
+        *engine = std::mt19937_64(5);
+        size_t before = scoreboard->str().size();
+        prepared.play(100);
+        std::string log = scoreboard->str().substr(before);
+        if (repetition == 0) {
+            first = log;
+        }
+        assert(log == first);
+    }
+
+    *engine = std::mt19937_64(5);
+    size_t before = scoreboard->str().size();
+    worldCup.play(100);
+    assert(scoreboard->str().substr(before) == first);
+
+    // Przygotowana gra nie dzieli graczy z grą źródłową.
+    auto sourceState = worldCup.getState();
+    prepared.play(100);
+    auto after = worldCup.getState();
+    for (size_t seat = 0; seat < after.players.size(); seat++) {
+        assert(after.players[seat].second == sourceState.players[seat].second);
+    }
+
+    // Błędna konfiguracja jest wykrywana przed pierwszą rundą.
+    auto empty = std::make_shared<text::TextScoreBoard>();
+    WorldCup2022 invalid;
+    invalid.addDie(std::make_shared<RandomDie>(engine));
+    invalid.addPlayer("A");
+    invalid.addPlayer("B");
+    invalid.setScoreBoard(empty);
+    try {
+        invalid.play(10);
+        assert(false);
+    } catch (TooFewDiceException const &) {
+    }
+    try {
+        invalid.prepare();
+        assert(false);
+    } catch (TooFewDiceException const &) {
+    }
+    assert(empty->str().empty());
+#endif
+
+// Przerwana rozgrywka kontynuowana kolejnym play() daje ten sam przebieg co
+// rozgrywka bez przerw
+#if TEST_NUM == 709
+    auto makeGame = [](std::shared_ptr<std::mt19937_64> engine,
+                       std::shared_ptr<ScoreBoard> scoreboard) {
+        auto worldCup = std::make_unique<WorldCup2022>();
+        worldCup->addDie(std::make_shared<RandomDie>(engine));
+        worldCup->addDie(std::make_shared<RandomDie>(engine));
+        for (unsigned int seat = 0; seat < 3; seat++) {
+            worldCup->addPlayer(seatName(seat));
+        }
+        worldCup->setScoreBoard(scoreboard);
+        return worldCup;
+    };
+
+    {
+        auto whole = std::make_shared<text::TextScoreBoard>();
+        auto game = makeGame(std::make_shared<std::mt19937_64>(3), whole);
+        game->play(60);
+
+        auto parts = std::make_shared<text::TextScoreBoard>();
+        auto resumed = makeGame(std::make_shared<std::mt19937_64>(3), parts);
+
+        // Zatrzymanie zgłoszone przed startem: żadna runda nie jest grana.
+        // (Źródło na stercie: dla std::stop_source na stosie GCC 12 z -O1
+        // fałszywie ostrzega o niezainicjalizowanej wartości.)
+        auto source = std::make_unique<std::stop_source>();
+        source->request_stop();
+        PlayResult result = resumed->play(60, source->get_token());
+        assert(result.stopped && result.rounds == 0);
+        assert(parts->str().empty());
+
+        // Termin, który już minął, przerywa grę przed pierwszą rundą.
+        result = resumed->play(60, {}, WorldCup2022::Deadline::min());
+        assert(result.stopped && result.rounds == 0);
+
+        result = resumed->play(60, {});
+        assert(!result.stopped);
+        assert(parts->str() == whole->str());
+    }
+
+    // Po upływie terminu gra rozgrywa co najwyżej clockTurns + maxPlayers - 1
+    // tur, niezależnie od liczby graczy. Obserwator po turze expireAt czeka,
+    // aż termin minie.
+    class ExpiringObserver : public TurnObserver {
+       public:
+        WorldCup2022::Deadline deadline;
+        unsigned int expireAt = 0;
+        unsigned int turns = 0;
+
+        void onTurnEnd(Player const &player, unsigned int roll) override {
+            (void)player;
+            (void)roll;
+            if (++turns == expireAt) {
+                while (std::chrono::steady_clock::now() < deadline) {
+                }
+            }
+        }
+    };
+    std::vector<FieldSpec> quietLayout{{FieldType::Beginning, "Start", 0, 0.0}};
+    for (int i = 0; i < 11; i++) {
+        quietLayout.push_back({FieldType::Empty, "Pusty", 0, 0.0});
+    }
+    for (unsigned int players : {2u, 5u, 11u}) {
+        for (unsigned int expireAt : {1u, 7u, 40u, 100u}) {
+            WorldCup2022 worldCup(quietLayout);
+            auto engine = std::make_shared<std::mt19937_64>(expireAt);
+            worldCup.addDie(std::make_shared<RandomDie>(engine));
+            worldCup.addDie(std::make_shared<RandomDie>(engine));
+            for (unsigned int seat = 0; seat < players; seat++) {
+                worldCup.addPlayer(seatName(seat));
+            }
+            ExpiringObserver observer;
+            observer.deadline = std::chrono::steady_clock::now() +
+                                std::chrono::milliseconds(2);
+            observer.expireAt = expireAt;
+            worldCup.setTurnObserver(&observer);
+            worldCup.setScoreBoard(std::make_shared<text::TextScoreBoard>());
+            PlayResult result = worldCup.play(1000000, {}, observer.deadline);
+            assert(result.stopped);
+            assert(observer.turns - expireAt <=
+                   PlayInterrupt::clockTurns + WorldCup2022::maxPlayers - 1);
+            assert(observer.turns == result.rounds * players);
+        }
+    }
+
+    // Zatrzymanie w trakcie gry: rundy są numerowane dalej, a suma rund
+    // z obu wywołań jest równa liczbie rund gry bez przerwy.
+    class StoppingScoreBoard : public text::TextScoreBoard {
+       public:
+        std::stop_source source;
+        unsigned int stopAt = 0;
+
+        void onRound(unsigned int roundNo) override {
+            text::TextScoreBoard::onRound(roundNo);
+            if (roundNo + 1 == stopAt) {
+                source.request_stop();
+            }
+        }
+    };
+
+    auto whole = std::make_shared<text::TextScoreBoard>();
+    makeGame(std::make_shared<std::mt19937_64>(8), whole)->play(40);
+    auto stopping = std::make_shared<StoppingScoreBoard>();
+    stopping->stopAt = 2;
+    auto game = makeGame(std::make_shared<std::mt19937_64>(8), stopping);
+    PlayResult first = game->play(40, stopping->source.get_token());
+    assert(first.stopped && first.rounds == 2);
+    PlayResult second = game->play(40 - first.rounds, {});
+    assert(!second.stopped);
+    assert(stopping->str() == whole->str());
+
+    // Asynchroniczna gra z zatrzymaniem z zewnątrz kończy się bez zwycięzcy,
+    // a gra z wystarczającym terminem rozgrywa wszystkie rundy.
+    std::stop_source cancel;
+    auto quiet = std::make_shared<text::TextScoreBoard>();
+    auto async = makeGame(std::make_shared<std::mt19937_64>(1), quiet);
+    cancel.request_stop();
+    std::future<PlayResult> pending =
+        async->playAsync(1000000, cancel.get_token());
+    assert(pending.get().stopped);
+    assert(quiet->str().find("Zwycięzca") == std::string::npos);
+    auto finished = async->playAsync(
+        30, {}, std::chrono::steady_clock::now() + std::chrono::hours(1));
+    assert(!finished.get().stopped);
+
+    // Błąd konfiguracji jest przekazywany przez future.
+    WorldCup2022 invalid;
+    invalid.addPlayer("A");
+    invalid.addPlayer("B");
+    try {
+        invalid.playAsync(10).get();
+        assert(false);
+    } catch (TooFewDiceException const &) {
+    }
+#endif
+
+// Turniej: zgodność sum w etapach, powtarzalność niezależna od liczby wątków
+// i odrzucanie niepoprawnych parametrów
+#if TEST_NUM == 710
+    TournamentConfig config;
+    config.groups = 4;
+    config.groupSize = 3;
+    config.advancing = 2;
+    config.rounds = 50;
+    TournamentSimulator simulator(config);
+    assert(simulator.stageCount() == 4);
+    assert(simulator.entrantCount() == 12);
+
+    TournamentAggregate single = simulator.run(100, 500, 1);
+    TournamentAggregate parallel = simulator.run(100, 500, 4);
+    assert(single.survived == parallel.survived);
+    assert(single.stageRounds == parallel.stageRounds);
+    assert(single.tournaments == 500);
+
+    unsigned int alive = 8;
+    for (size_t stage = 0; stage < simulator.stageCount(); stage++) {
+        std::uint64_t total = 0;
+        for (auto count : single.survived[stage]) {
+            total += count;
+        }
+        assert(total == 500u * alive);
+        assert(single.stageGames[stage] == 500u * (stage == 0 ? 4 : alive));
+        alive /= 2;
+    }
+
+    // Mistrz zwrócony przez play() jest zliczony w ostatnim etapie.
+    TournamentAggregate one(simulator.stageCount(), simulator.entrantCount());
+    unsigned int champion = simulator.play(7, one);
+    assert(one.champions()[champion] == 1);
+    assert(one.survived[0][champion] == 1);
+
+    // Zawodnik z grupy awansującej w całości zawsze przechodzi etap grupowy.
+    TournamentConfig everyone = config;
+    everyone.groups = 2;
+    everyone.groupSize = 4;
+    everyone.advancing = 4;
+    TournamentAggregate all = TournamentSimulator(everyone).run(0, 50, 2);
+    for (auto count : all.survived[0]) {
+        assert(count == 50);
+    }
+
+    for (auto broken : {TournamentConfig{defaultLayout(), 3, 4, 1, 10},
+                        TournamentConfig{defaultLayout(), 2, 12, 1, 10},
+                        TournamentConfig{defaultLayout(), 2, 4, 5, 10}}) {
+        try {
+            TournamentSimulator{broken};
+            assert(false);
+        } catch (std::invalid_argument const &) {
+        }
+    }
+#endif
+
+// Gry prowadzone przez GameHost krok po kroku przebiegają tak samo jak gra
+// rozegrana jednym play(); błędne żądania dostają kod błędu
+#if TEST_NUM == 711
+    GameHost host;
+    // Odpowiedzi muszą żyć dłużej niż czytające je ProtocolReader (deque nie
+    // przenosi elementów przy dopisywaniu).
+    std::deque<std::string> responses;
+    auto call = [&](ProtocolWriter const &request) -> std::string const & {
+        std::string buffer = request.frame();
+        std::string payload;
+        size_t offset = 0;
+        assert(takeFrame(buffer, payload, offset));
+        assert(offset == buffer.size());
+        responses.push_back(host.handle(payload));
+        return responses.back();
+    };
+
+    ProtocolReader created(call(ProtocolWriter().op(Opcode::Create).u64(8)));
+    assert(created.status() == Status::Ok);
+    std::uint32_t game = created.u32();
+    for (unsigned int seat = 0; seat < 3; seat++) {
+        ProtocolReader added(call(ProtocolWriter()
+                                      .op(Opcode::AddPlayer)
+                                      .u32(game)
+                                      .str(seatName(seat))));
+        assert(added.status() == Status::Ok);
+    }
+
+    unsigned int rounds = 0;
+    for (bool running = true; running;) {
+        ProtocolReader stepped(
+            call(ProtocolWriter().op(Opcode::Step).u32(game).u32(1)));
+        assert(stepped.status() == Status::Ok);
+        rounds += stepped.u32();
+        running = stepped.u8();
+    }
+    // Ta sama gra rozegrana jednym play() na kostkach o tym samym strumieniu.
+    auto stream = std::make_shared<CounterStream>(CounterStream{8, 0});
+    auto outcomeBoard = std::make_shared<OutcomeScoreBoard>();
+    WorldCup2022 direct;
+    direct.addDie(std::make_shared<CounterDie>(stream));
+    direct.addDie(std::make_shared<CounterDie>(stream));
+    for (unsigned int seat = 0; seat < 3; seat++) {
+        direct.addPlayer(seatName(seat));
+    }
+    direct.setScoreBoard(outcomeBoard);
+    direct.play(GameHost::maxStepRounds);
+    GameOutcome outcome{0, outcomeBoard->getRounds()};
+    while (seatName(outcome.winnerSeat) != outcomeBoard->getWinner()) {
+        outcome.winnerSeat++;
+    }
+    assert(rounds == outcome.rounds);
+
+    // Strumień kostek można ustawić w dowolnym miejscu bez odtwarzania.
+    CounterStream sequential{5, 0};
+    for (int i = 0; i < 1000; i++) {
+        sequential.next();
+    }
+    CounterStream jumped{5, 1000};
+    assert(jumped.next() == sequential.next());
+
+    ProtocolReader query(call(ProtocolWriter().op(Opcode::Query).u32(game)));
+    assert(query.status() == Status::Ok);
+    query.u32();
+    assert(query.u8() == 0);
+    assert(query.str() == seatName(outcome.winnerSeat));
+    assert(query.u16() == 1);
+
+    // Krok zakończonej gry nic nie robi.
+    ProtocolReader after(
+        call(ProtocolWriter().op(Opcode::Step).u32(game).u32(5)));
+    assert(after.status() == Status::Ok && after.u32() == 0);
+
+    // Gra z jednym graczem nie może ruszyć.
+    ProtocolReader lonely(call(ProtocolWriter().op(Opcode::Create).u64(1)));
+    lonely.status();
+    std::uint32_t single = lonely.u32();
+    call(ProtocolWriter().op(Opcode::AddPlayer).u32(single).str("A"));
+    ProtocolReader refused(
+        call(ProtocolWriter().op(Opcode::Step).u32(single).u32(1)));
+    assert(refused.status() == Status::GameError);
+
+    // Graczy nie może być więcej, niż przyjmie gra, a ich nazwy są tak
+    // krótkie, że odpowiedź na Query z kompletem graczy mieści się w ramce.
+    std::string longest(GameHost::maxNameLength, 'x');
+    for (size_t seat = 1; seat < WorldCup2022::maxPlayers; seat++) {
+        longest.back() = static_cast<char>('a' + seat);
+        assert(ProtocolReader(call(ProtocolWriter()
+                                       .op(Opcode::AddPlayer)
+                                       .u32(single)
+                                       .str(longest)))
+                   .status() == Status::Ok);
+    }
+    assert(ProtocolReader(call(ProtocolWriter()
+                                   .op(Opcode::AddPlayer)
+                                   .u32(single)
+                                   .str("B")))
+               .status() == Status::GameError);
+    assert(ProtocolReader(call(ProtocolWriter()
+                                   .op(Opcode::AddPlayer)
+                                   .u32(game)
+                                   .str(longest + "x")))
+               .status() == Status::BadRequest);
+    ProtocolReader stepFull(
+        call(ProtocolWriter().op(Opcode::Step).u32(single).u32(1)));
+    assert(stepFull.status() == Status::Ok);
+    std::string full = host.handle(
+        ProtocolWriter().op(Opcode::Query).u32(single).payload());
+    assert(full.size() <= maxFrame);
+    ProtocolReader fullQuery(full);
+    assert(fullQuery.status() == Status::Ok);
+    fullQuery.u32();
+    fullQuery.u8();
+    fullQuery.str();
+    assert(fullQuery.u16() <= WorldCup2022::maxPlayers);
+
+    assert(ProtocolReader(call(ProtocolWriter().op(Opcode::Close).u32(game)))
+               .status() == Status::Ok);
+    assert(ProtocolReader(call(ProtocolWriter().op(Opcode::Query).u32(game)))
+               .status() == Status::UnknownGame);
+    assert(ProtocolReader(call(ProtocolWriter().op(Opcode::Step).u32(single)))
+               .status() == Status::BadRequest);
+    std::string unknown = host.handle(std::string(1, '\x7f'));
+    assert(ProtocolReader(unknown).status() == Status::BadRequest);
+    assert(host.size() == 1);
+
+    // Ramka rozcięta na części jest składana dopiero po dotarciu całości.
+    std::string frame = ProtocolWriter().op(Opcode::Query).u32(1).frame();
+    std::string buffer = frame.substr(0, 6);
+    std::string payload;
+    size_t offset = 0;
+    assert(!takeFrame(buffer, payload, offset) && offset == 0);
+    buffer += frame.substr(6);
+    assert(takeFrame(buffer, payload, offset) && offset == frame.size());
+#endif
+
+// Gry zapisane w dzienniku (z migawką w trakcie i urwanym ostatnim rekordem)
+// są po odtworzeniu w tym samym stanie co gry prowadzone bez dziennika
+#if TEST_NUM == 712
+    auto directory =
+        std::filesystem::temp_directory_path() / "worldcup_journal_test";
+    std::filesystem::remove_all(directory);
+
+    GameHost reference;
+    std::deque<std::string> responses;
+    auto both = [&](GameHost &host, ProtocolWriter const &request) {
+        std::string expected = reference.handle(request.payload());
+        std::string actual = host.handle(request.payload());
+        assert(actual == expected);
+        responses.push_back(actual);
+        return ProtocolReader(responses.back());
+    };
+    auto queryAll = [&](GameHost &host) {
+        for (std::uint32_t game = 1; game <= 4; game++) {
+            both(host, ProtocolWriter().op(Opcode::Query).u32(game));
+        }
+    };
+
+    {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        GameHost host(&journal);
+        host.recover();
+        for (std::uint64_t seed = 0; seed < 4; seed++) {
+            std::uint32_t game =
+                both(host, ProtocolWriter().op(Opcode::Create).u64(seed + 40))
+                    .u32();
+            for (unsigned int seat = 0; seat < 3 + seed % 2; seat++) {
+                both(host, ProtocolWriter()
+                               .op(Opcode::AddPlayer)
+                               .u32(game)
+                               .str(seatName(seat)));
+            }
+            both(host, ProtocolWriter().op(Opcode::Step).u32(game).u32(1));
+            journal.commit();
+            if (seed == 1) {
+                host.snapshot();
+            }
+        }
+        both(host, ProtocolWriter().op(Opcode::Close).u32(2));
+        both(host, ProtocolWriter().op(Opcode::Step).u32(3).u32(1));
+        journal.commit();
+    }
+
+    // Urwany rekord na końcu dziennika (jak po awarii w trakcie zapisu).
+    {
+        std::ofstream wal(directory / "wal", std::ios::binary | std::ios::app);
+        std::uint32_t header[2] = {100, 0};
+        wal.write(reinterpret_cast<char const *>(header), sizeof(header));
+        wal.write("abc", 3);
+    }
+
+    for (int restart = 0; restart < 2; restart++) {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        GameHost host(&journal);
+        host.recover();
+        assert(host.size() == 3);
+        queryAll(host);
+        for (std::uint32_t game : {1, 3, 4}) {
+            both(host, ProtocolWriter().op(Opcode::Step).u32(game).u32(2));
+        }
+        queryAll(host);
+        journal.commit();
+    }
+
+    // Dziennik niezgodny z przebiegiem gry jest wykrywany.
+    std::filesystem::remove_all(directory);
+    {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        GameHost host(&journal);
+        std::string created =
+            host.handle(ProtocolWriter().op(Opcode::Create).u64(1).payload());
+        for (unsigned int seat = 0; seat < 2; seat++) {
+            host.handle(ProtocolWriter()
+                            .op(Opcode::AddPlayer)
+                            .u32(1)
+                            .str(seatName(seat))
+                            .payload());
+        }
+        host.handle(ProtocolWriter().op(Opcode::Step).u32(1).u32(3).payload());
+        // Ta sama gra z innym ziarnem: wpisy tur nie będą się zgadzać.
+        journal.append(ProtocolWriter().u8(4).u32(1).payload());
+        journal.append(ProtocolWriter().u8(1).u32(1).u64(2).payload());
+        journal.append(
+            ProtocolWriter().u8(2).u32(1).str(seatName(0)).payload());
+        journal.append(
+            ProtocolWriter().u8(2).u32(1).str(seatName(1)).payload());
+        journal.append(ProtocolWriter()
+                           .u8(3)
+                           .u32(1)
+                           .u32(1)
+                           .u8(7)
+                           .u32(1)
+                           .u32(1)
+                           .u32(0)
+                           .u8(0)
+                           .payload());
+    }
+    {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        GameHost host(&journal);
+        try {
+            host.recover();
+            assert(false);
+        } catch (std::runtime_error const &) {
+        }
+    }
+
+    // Rekord kroku największej możliwej długości (wszyscy gracze, pełna
+    // liczba rund) i rekordy po nim przetrwają odtwarzanie; za długi rekord
+    // jest odrzucany już przy dopisywaniu. Rekord składany w miejscu trafia
+    // do dziennika po endRecord(), a wycofany nie zostawia śladu.
+    std::filesystem::remove_all(directory);
+    std::string longest(9 + 16 * WorldCup2022::maxPlayers * GameHost::maxStepRounds, 'x');
+    {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        journal.append("before");
+        journal.beginRecord().append("dropped");
+        journal.dropRecord();
+        journal.append(longest);
+        journal.append("after");
+        try {
+            journal.append(std::string(GameJournal::maxRecord + 1, 'y'));
+            assert(false);
+        } catch (std::length_error const &) {
+        }
+        try {
+            journal.beginRecord().append(GameJournal::maxRecord + 1, 'y');
+            journal.endRecord();
+            assert(false);
+        } catch (std::length_error const &) {
+        }
+        journal.beginRecord().append("built");
+        journal.endRecord();
+        journal.commit();
+    }
+    {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        std::vector<std::string> records = journal.recover(0);
+        assert(records.size() == 4);
+        assert(records[0] == "before" && records[1] == longest && records[2] == "after");
+        assert(records[3] == "built");
+    }
+    std::filesystem::remove_all(directory);
+#endif
+
+// Gry pakowane przy limicie aktywnych gier zachowują się tak samo jak gry
+// trzymane w całości, również po odtworzeniu z migawki i dziennika
+#if TEST_NUM == 713
+    auto directory =
+        std::filesystem::temp_directory_path() / "worldcup_packing_test";
+    std::filesystem::remove_all(directory);
+
+    GameHost reference;
+    std::deque<std::string> responses;
+    auto both = [&](GameHost &host, ProtocolWriter const &request) {
+        std::string expected = reference.handle(request.payload());
+        std::string actual = host.handle(request.payload());
+        assert(actual == expected);
+        responses.push_back(actual);
+        return ProtocolReader(responses.back());
+    };
+
+    constexpr std::uint32_t games = 12;
+    std::mt19937 order(7);
+    {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        GameHost host(&journal, 2);
+        host.recover();
+        for (std::uint32_t game = 1; game <= games; game++) {
+            both(host, ProtocolWriter().op(Opcode::Create).u64(game * 13));
+            both(host, ProtocolWriter()
+                           .op(Opcode::AddPlayer)
+                           .u32(game)
+                           .str(seatName(game % 3)));
+            both(host, ProtocolWriter()
+                           .op(Opcode::AddPlayer)
+                           .u32(game)
+                           .str(game % 2 ? "Player-07" : "Zbigniew"));
+            assert(host.liveCount() <= 2);
+        }
+        for (int i = 0; i < 200; i++) {
+            std::uint32_t game = order() % games + 1;
+            Opcode opcode = order() % 3 ? Opcode::Step : Opcode::Query;
+            ProtocolWriter request;
+            request.op(opcode).u32(game);
+            if (opcode == Opcode::Step) {
+                request.u32(1);
+            }
+            both(host, request);
+            assert(host.liveCount() <= 2);
+            if (i == 100) {
+                host.snapshot();
+            }
+        }
+        both(host, ProtocolWriter().op(Opcode::Close).u32(5));
+        journal.commit();
+        assert(host.size() == games - 1);
+    }
+    {
+        GameJournal journal(directory, std::chrono::microseconds(0));
+        GameHost host(&journal, 3);
+        host.recover();
+        assert(host.size() == games - 1);
+        assert(host.liveCount() <= 3);
+        for (std::uint32_t game = 1; game <= games; game++) {
+            both(host, ProtocolWriter().op(Opcode::Query).u32(game));
+            both(host, ProtocolWriter().op(Opcode::Step).u32(game).u32(1));
+        }
+    }
+    std::filesystem::remove_all(directory);
+#endif
+
+// Ślad odczytany z dziennika tablicy wyników tekstowej odpowiada turom
+// zgłoszonym tablicy wyników i przechodzi przez format binarny bez zmian
+#if TEST_NUM == 714
+    struct Turn {
+        std::string name;
+        std::string status;
+        std::string field;
+        unsigned int money;
+    };
+    class RecordingScoreBoard : public ScoreBoard {
+       public:
+        std::vector<Turn> turns;
+        std::vector<std::string> winners;
+
+        void onRound(unsigned int roundNo) override { (void)roundNo; }
+
+        void onTurn(std::string const &playerName,
+                    std::string const &playerStatus,
+                    std::string const &squareName,
+                    unsigned int money) override {
+            turns.push_back({playerName, playerStatus, squareName, money});
+        }
+
+        void onWin(std::string const &playerName) override {
+            winners.push_back(playerName);
+        }
+    };
+
+    auto text = std::make_shared<text::TextScoreBoard>();
+    auto recording = std::make_shared<RecordingScoreBoard>();
+    std::vector<size_t> gameStarts;
+    for (std::uint64_t seed = 0; seed < 3; seed++) {
+        gameStarts.push_back(recording->turns.size());
+        for (std::shared_ptr<ScoreBoard> scoreboard :
+             {std::shared_ptr<ScoreBoard>(text),
+              std::shared_ptr<ScoreBoard>(recording)}) {
+            auto engine = std::make_shared<std::mt19937_64>(seed);
+            WorldCup2022 worldCup;
+            worldCup.addDie(std::make_shared<RandomDie>(engine));
+            worldCup.addDie(std::make_shared<RandomDie>(engine));
+            worldCup.addPlayer("Lewandowski");
+            worldCup.addPlayer(seed == 1 ? "Szczęsny" : "Messi");
+            worldCup.addPlayer(seatName(seed));
+            worldCup.setScoreBoard(scoreboard);
+            worldCup.play(100);
+        }
+    }
+
+    std::stringstream binary;
+    TextLogParser().parse(text->str()).write(binary);
+    LogTrace trace = LogTrace::read(binary);
+    assert(trace.turns() == recording->turns.size());
+    assert(trace.games() == 3);
+    for (size_t game = 0; game < 3; game++) {
+        assert(trace.gameStart[game] == gameStarts[game]);
+        assert(trace.playerNames[trace.winner[game]] ==
+               recording->winners[game]);
+    }
+    for (size_t i = 0; i < trace.turns(); i++) {
+        Turn const &turn = recording->turns[i];
+        PlayerState state{trace.money[i], 0, trace.wait[i], false};
+        if (trace.wait[i] == LogTrace::bankrupt) {
+            state = PlayerState{trace.money[i], 0, 0, true};
+        }
+        assert(trace.playerNames[trace.player[i]] == turn.name);
+        assert(trace.fieldNames[trace.field[i]] == turn.field);
+        assert(trace.money[i] == turn.money);
+        assert(Player("", state).getStatus() == turn.status);
+    }
+    assert(trace.fieldNames.size() == defaultLayout().size());
+
+    // Liczności słowników i kolumn większe niż reszta pliku są odrzucane
+    // przed przydziałem pamięci, a zbyt długa nazwa - przy zapisie.
+    LogTrace empty;
+    std::stringstream emptyBinary;
+    empty.write(emptyBinary);
+    for (size_t offset : {size_t(4), size_t(20)}) {
+        std::string corrupt = emptyBinary.str();
+        std::uint64_t huge = std::numeric_limits<std::uint32_t>::max();
+        std::memcpy(corrupt.data() + offset, &huge, sizeof(huge));
+        std::istringstream corruptIn(corrupt);
+        try {
+            LogTrace::read(corruptIn);
+            assert(false);
+        } catch (std::runtime_error const &e) {
+            assert(std::string(e.what()) == "truncated trace");
+        }
+    }
+    empty.playerNames.push_back(std::string(65536, 'x'));
+    std::stringstream tooLong;
+    try {
+        empty.write(tooLong);
+        assert(false);
+    } catch (std::invalid_argument const &) {
+        assert(tooLong.str().empty());
+    }
+
+    // Nieznane pole trafia do słownika, a niepoprawny wiersz jest odrzucany
+    // z numerem wiersza.
+    trace = TextLogParser().parse("=== Runda: 0\nA [w grze] [5] - Nowe pole");
+    assert(trace.fieldNames[trace.field[0]] == "Nowe pole");
+    assert(trace.winner[0] == LogTrace::noWinner);
+    try {
+        TextLogParser().parse("=== Runda: 0\nA [w grze] [x] - Gol\n");
+        assert(false);
+    } catch (std::runtime_error const &e) {
+        assert(std::string(e.what()) == "malformed log line 2");
+    }
+#endif
+
+// Silniki zoptymalizowane zgodne ze wzorcem na losowych przypadkach;
+// zmniejszanie przypadku do minimalnego przykładu
+#if TEST_NUM == 715
+    assert(fuzzEngines(0, 500, 2).empty());
+    for (FuzzCase const &regression : regressionCases()) {
+        assert(mismatchedEngines(regression).empty());
+    }
+
+    // Skrót rozróżnia przebiegi różnej długości.
+    FuzzCase fuzzCase = randomCase(7);
+    fuzzCase.players = 3;
+    fuzzCase.dice = 2;
+    fuzzCase.rounds = 5;
+    auto digest = [](FuzzCase const &c) {
+        auto result = std::make_shared<EventDigest>();
+        playCase(c, FuzzEngine::Generic, result);
+        return *result;
+    };
+    EventDigest shorter = digest(fuzzCase);
+    fuzzCase.rounds = 6;
+    assert(!(digest(fuzzCase) == shorter));
+    assert(digest(fuzzCase) == digest(fuzzCase));
+
+    // Sztuczny błąd: "pojawia się", gdy na planszy jest mecz o opłacie
+    // co najmniej 100 i gra trwa co najmniej 3 rundy.
+    fuzzCase = randomCase(11);
+    fuzzCase.rounds = 50;
+    fuzzCase.layout.push_back({FieldType::Match, "Mecz", 300, 4.0});
+    auto failing = [](FuzzCase const &c) {
+        bool match = false;
+        for (auto const &spec : c.layout) {
+            match = match ||
+                    (spec.type == FieldType::Match && spec.value >= 100);
+        }
+        return match && c.rounds >= 3;
+    };
+    FuzzCase reduced = shrinkCase(fuzzCase, failing);
+    assert(failing(reduced));
+    assert(reduced.rounds == 3);
+    assert(reduced.players == 0);
+    assert(reduced.layout.size() == 1);
+    assert(reduced.layout[0].type == FieldType::Match);
+    assert(reduced.layout[0].value < 200);
+    assert(reduced.layout[0].weight == 1.0);
+    assert(reduced.rolls.size() == 1 && reduced.rolls[0] == 0);
+
+    std::stringstream description;
+    describeCase(reduced, description);
+    assert(description.str().find("rounds=3") != std::string::npos);
+#endif
+
+// Skrót przebiegu niezależny od silnika i od przerywania gry; złoty korpus
+// wykrywa zmieniony przebieg
+#if TEST_NUM == 716
+    auto makeGame = [](std::uint64_t seed) {
+        auto engine = std::make_shared<std::mt19937_64>(seed);
+        auto game = std::make_unique<WorldCup2022>();
+        game->addDie(std::make_shared<RandomDie>(engine));
+        game->addDie(std::make_shared<RandomDie>(engine));
+        for (unsigned int seat = 0; seat < 5; seat++) {
+            game->addPlayer(seatName(seat));
+        }
+        game->setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+        game->hashTrajectory(true);
+        return game;
+    };
+    for (std::uint64_t seed = 0; seed < 20; seed++) {
+        auto played = makeGame(seed);
+        played->play(200);
+        std::uint64_t hash = played->getTrajectoryHash();
+        assert(hash == trajectoryHash(defaultLayout(), 5, 200, seed));
+        assert(hash != trajectoryHash(defaultLayout(), 5, 200, seed + 20));
+
+        // Skrót obejmuje całą grę rozgrywaną po kawałku.
+        auto stepped = makeGame(seed);
+        unsigned int rounds = 0;
+        while (rounds < 200 && stepped->step(8).stopped) {
+            rounds += 8;
+        }
+        assert(stepped->getTrajectoryHash() == hash);
+    }
+
+    auto plain = makeGame(1);
+    plain->hashTrajectory(false);
+    plain->play(50);
+    assert(plain->getTrajectoryHash() == TrajectoryHash().digest());
+
+    GoldenCorpus corpus = generateCorpus(3, 100, 1000, 300, 2);
+    assert(corpus.hashes[5] == trajectoryHash(defaultLayout(), 3, 100, 1005));
+    std::stringstream stream;
+    corpus.write(stream);
+    GoldenCorpus loaded = GoldenCorpus::read(stream);
+    assert(loaded.players == 3 && loaded.rounds == 100);
+    assert(loaded.firstSeed == 1000 && loaded.hashes == corpus.hashes);
+    assert(verifyCorpus(loaded, 2).empty());
+    loaded.hashes[17] ^= 1;
+    loaded.hashes[3] ^= 1;
+    assert((verifyCorpus(loaded, 2) == std::vector<std::uint64_t>{1003, 1017}));
+    std::stringstream garbage("WCG0");
+    try {
+        GoldenCorpus::read(garbage);
+        assert(false);
+    } catch (std::runtime_error const &) {
+    }
+    // Liczba skrótów większa niż reszta pliku jest odrzucana przed
+    // przydziałem pamięci.
+    for (std::uint64_t count : {std::uint64_t{301}, ~std::uint64_t{0} >> 4}) {
+        std::string bytes = stream.str();
+        std::memcpy(bytes.data() + 24, &count, sizeof(count));
+        std::stringstream corrupted(bytes);
+        try {
+            GoldenCorpus::read(corrupted);
+            assert(false);
+        } catch (std::runtime_error const &) {
+        }
+    }
+#endif
+
+// Księga przepływów pieniędzy - zasada zachowania spełniona na wszystkich
+// planszach, a przelew poza księgą jest wykrywany
+#if TEST_NUM == 717
+    for (std::uint64_t seed = 0; seed < 300; seed++) {
+        FuzzCase fuzzCase = randomCase(seed);
+        fuzzCase.players = 2 + seed % 10;
+        fuzzCase.dice = 2;
+        for (FuzzEngine engine :
+             {FuzzEngine::Generic, FuzzEngine::Resumed, FuzzEngine::Compact,
+              FuzzEngine::Huge}) {
+            if (supportsCase(engine, fuzzCase)) {
+                std::vector<std::string> events;
+                playCase(fuzzCase, engine,
+                         std::make_shared<EventDigest>(&events));
+                assert(events.back().rfind("!!!", 0) != 0);
+            }
+        }
+    }
+
+    // Plansza dopłacająca graczowi poza akcjami pól.
+    class LeakyBoard : public Board {
+       public:
+        void playerMove(Player *player, unsigned int i) override {
+            Board::playerMove(player, i);
+            player->take(1);
+        }
+    };
+    WorldCup2022 leaky(std::make_shared<LeakyBoard>());
+    leaky.addDie(std::make_shared<dice::FixedDie>(dice::rolls_t{2}));
+    leaky.addDie(std::make_shared<dice::FixedDie>(dice::rolls_t{2}));
+    leaky.addPlayer("A");
+    leaky.addPlayer("B");
+    leaky.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+    try {
+        leaky.play(10);
+        assert(false);
+    } catch (ledger::LedgerError const &e) {
+        assert(std::string(e.what()) ==
+               "ledger: before round 1, player 0: expected 620, actual 621");
+    }
+
+    // Księga trzyma tylko ostatnie pozycje; salda liczy ze wszystkich.
+    ledger::Ledger book;
+    book.open({100, 100}, {0});
+    for (std::uint32_t i = 1; i <= 1000; i++) {
+        book.transfer(ledger::playerAccount(i % 2), ledger::bank, i);
+    }
+    auto recent = book.recentEntries();
+    assert(book.entryCount() == 1000);
+    assert(recent.size() == ledger::Ledger::historySize);
+    assert(recent.front().amount == 1001 - ledger::Ledger::historySize);
+    assert(recent.back().amount == 1000);
+    assert(book.delta(ledger::bank) == 1000 * 1001 / 2);
+    book.check(0, {100 - 500 * 501, 100 - 500 * 500}, {0});
+#endif
+
+// Przepływy pieniędzy przypisane polom sumują się do zmiany stanu konta
+// gracza; wyniki równoległe są takie same jak sekwencyjne
+#if TEST_NUM == 718
+    for (std::uint64_t seed = 0; seed < 20; seed++) {
+        CashFlow flow(4, defaultLayout().size());
+        CashFlowObserver observer(
+            flow, {seatName(0), seatName(1), seatName(2), seatName(3)});
+        auto engine = std::make_shared<std::mt19937_64>(seed);
+        WorldCup2022 worldCup;
+        worldCup.addDie(std::make_shared<RandomDie>(engine));
+        worldCup.addDie(std::make_shared<RandomDie>(engine));
+        for (unsigned int seat = 0; seat < 4; seat++) {
+            worldCup.addPlayer(seatName(seat));
+        }
+        worldCup.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+        worldCup.setFieldObserver(&observer);
+        worldCup.play(60);
+
+        std::vector<std::int64_t> money(4, 0);
+        for (auto const &[name, state] : worldCup.getState().players) {
+            money[name.back() - '1'] = state.money;
+        }
+        for (size_t seat = 0; seat < 4; seat++) {
+            std::int64_t net = 0;
+            for (size_t field = 0; field < flow.getFields(); field++) {
+                net += flow.net(seat, field);
+            }
+            assert(net == money[seat] - 1000);
+        }
+        // Pola bez pieniędzy (dzień wolny, żółta kartka).
+        assert(flow.gained(0, 2) == 0 && flow.lost(0, 4) == 0);
+        assert(flow.unattributed(0) == 0 && flow.unattributed(3) == 0);
+    }
+
+    // Gracz spoza listy nazw obserwatora jest błędem, a nie cichym
+    // przypisaniem jego pieniędzy innemu miejscu.
+    {
+        CashFlow flow(2, defaultLayout().size());
+        CashFlowObserver observer(flow, {seatName(0), seatName(1)});
+        WorldCup2022 worldCup;
+        worldCup.addDie(std::make_shared<dice::FixedDie>(dice::rolls_t{3}));
+        worldCup.addDie(std::make_shared<dice::FixedDie>(dice::rolls_t{4}));
+        worldCup.addPlayer(seatName(0));
+        worldCup.addPlayer(seatName(2));
+        worldCup.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+        worldCup.setFieldObserver(&observer);
+        try {
+            worldCup.play(10);
+            assert(false);
+        } catch (std::invalid_argument const &) {
+        }
+    }
+
+    // HugeBoard nie powiadamia o przejściach: opłaty za przejście trafiają
+    // do salda nieprzypisanego, a suma z polami nadal zgadza się z kontem.
+    // Ten sam obserwator służy kolejnym grom (beginGame()).
+    CashFlow hugeFlow(4, defaultLayout().size());
+    CashFlowObserver hugeObserver(
+        hugeFlow, {seatName(0), seatName(1), seatName(2), seatName(3)});
+    std::vector<std::int64_t> hugeMoney(4, 0);
+    for (std::uint64_t seed = 0; seed < 20; seed++) {
+        auto engine = std::make_shared<std::mt19937_64>(seed);
+        WorldCup2022 worldCup(std::make_shared<HugeBoard>(defaultLayout()));
+        worldCup.addDie(std::make_shared<RandomDie>(engine));
+        worldCup.addDie(std::make_shared<RandomDie>(engine));
+        for (unsigned int seat = 0; seat < 4; seat++) {
+            worldCup.addPlayer(seatName(seat));
+        }
+        worldCup.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+        hugeObserver.beginGame();
+        hugeFlow.addGame();
+        worldCup.setFieldObserver(&hugeObserver);
+        worldCup.play(60);
+        // Zbankrutowanych nie ma w stanie gry; skończyli z zerem.
+        for (auto &money : hugeMoney) {
+            money -= Player::startingMoney;
+        }
+        for (auto const &[name, state] : worldCup.getState().players) {
+            hugeMoney[name.back() - '1'] += state.money;
+        }
+    }
+    bool unattributed = false;
+    for (size_t seat = 0; seat < 4; seat++) {
+        std::int64_t net = hugeFlow.unattributed(seat);
+        for (size_t field = 0; field < hugeFlow.getFields(); field++) {
+            net += hugeFlow.net(seat, field);
+        }
+        assert(net == hugeMoney[seat]);
+        unattributed = unattributed || hugeFlow.unattributed(seat) != 0;
+    }
+    assert(unattributed);
+    std::stringstream hugeMatrix;
+    hugeFlow.report(hugeMatrix, defaultLayout());
+    assert(hugeMatrix.str().find("(unattributed)") != std::string::npos);
+
+    SimulationConfig config{defaultLayout(), 3, 100, 0, 300};
+    CashFlow sequential(3, config.layout.size());
+    CashFlow parallel(3, config.layout.size());
+    SimulationAggregate outcome = runSimulation(config, 1, sequential);
+    assert(outcome.wins == runSimulation(config, 1).wins);
+    runSimulation(config, 3, parallel);
+    assert(sequential.getGames() == 300 && parallel.getGames() == 300);
+    for (size_t seat = 0; seat < 3; seat++) {
+        for (size_t field = 0; field < config.layout.size(); field++) {
+            assert(sequential.gained(seat, field) ==
+                   parallel.gained(seat, field));
+            assert(sequential.lost(seat, field) == parallel.lost(seat, field));
+        }
+    }
+    std::stringstream matrix;
+    sequential.report(matrix, config.layout);
+    std::string header;
+    std::getline(matrix, header);
+    assert(header == "field\tPlayer-1\tPlayer-2\tPlayer-3\tgained\tlost");
+    assert(matrix.str().find("(unattributed)") == std::string::npos);
+#endif
+
+// Duże bufory działają przy każdej polityce dużych stron (także bez puli
+// hugetlb), a liczniki wracają do zera po zwolnieniu
+#if TEST_NUM == 719
+    for (auto policy : {hugepages::Policy::Off, hugepages::Policy::Transparent,
+                        hugepages::Policy::Explicit}) {
+        hugepages::setPolicy(policy);
+        {
+            HugeVector<std::uint64_t> column(1 << 20);
+            for (size_t i = 0; i < column.size(); i++) {
+                column[i] = i * 3;
+            }
+            assert(reinterpret_cast<std::uintptr_t>(column.data()) %
+                       alignof(std::max_align_t) ==
+                   0);
+            assert(column.back() == ((1u << 20) - 1) * 3);
+            auto const &usage = hugepages::usage();
+            std::uint64_t mapped = usage.regularBytes + usage.transparentBytes +
+                                   usage.explicitBytes;
+            assert(mapped == hugepages::mappedLength((8 << 20) + 16));
+            assert((usage.regularBytes != 0) ==
+                   (policy == hugepages::Policy::Off));
+            // Flagi odwzorowania w /proc/self/smaps: nh (MADV_NOHUGEPAGE)
+            // przy Off, hg (MADV_HUGEPAGE) przy Transparent.
+            std::ifstream smaps("/proc/self/smaps");
+            auto address = reinterpret_cast<std::uintptr_t>(column.data());
+            bool inside = false;
+            std::string line;
+            while (std::getline(smaps, line)) {
+                std::uintptr_t from = 0, to = 0;
+                if (std::sscanf(line.c_str(), "%lx-%lx", &from, &to) == 2 &&
+                    line.find(':') > line.find(' ')) {
+                    inside = from <= address && address < to;
+                } else if (inside && line.starts_with("VmFlags:")) {
+                    if (policy == hugepages::Policy::Off) {
+                        assert(line.find(" nh") != std::string::npos);
+                    } else if (usage.transparentBytes != 0) {
+                        assert(line.find(" hg") != std::string::npos);
+                    }
+                }
+            }
+
+            HugeVector<char> small(100, 'x');
+            assert(small[99] == 'x');
+        }
+        auto const &usage = hugepages::usage();
+        assert(usage.regularBytes == 0 && usage.transparentBytes == 0 &&
+               usage.explicitBytes == 0);
+    }
+
+    // Plansza na dużych stronach gra tak samo jak na zwykłych.
+    std::vector<FieldSpec> layout{{FieldType::Beginning, "Start", 0, 0.0}};
+    for (size_t i = 1; i < 300000; i++) {
+        layout.push_back({FieldType::Match, "Mecz", 1, 1.0});
+    }
+    std::vector<std::string> states;
+    for (auto policy :
+         {hugepages::Policy::Off, hugepages::Policy::Transparent}) {
+        hugepages::setPolicy(policy);
+        WorldCup2022 worldCup(std::make_shared<HugeBoard>(layout));
+        worldCup.addDie(std::make_shared<dice::FixedDie>(
+            dice::rolls_t{6, 5, 4, 3, 2, 1}));
+        worldCup.addDie(std::make_shared<dice::FixedDie>(
+            dice::rolls_t{1, 2, 3, 4, 5, 6}));
+        worldCup.addPlayer("A");
+        worldCup.addPlayer("B");
+        worldCup.setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+        worldCup.play(500);
+        std::stringstream state;
+        for (auto const &[name, player] : worldCup.getState().players) {
+            state << name << ' ' << player.money << ' ' << player.field
+                  << '\n';
+        }
+        states.push_back(state.str());
+    }
+    assert(states[0] == states[1]);
+#endif
+
+// Ślad zapisany przez TraceSink z kilku wątków (io_uring i pwritev) zawiera
+// wszystkie rekordy każdego wątku w kolejności
+#if TEST_NUM == 720
+    auto path = std::filesystem::temp_directory_path() /
+                ("worldcup_test_720_" + std::to_string(::getpid()));
+    for (bool ioUring : {true, false}) {
+        TraceSink::Options options;
+        options.blockSize = 4096;
+        options.poolBlocks = 2;
+        options.queueDepth = 4;
+        options.useIoUring = ioUring;
+        TraceSink sink(path, options);
+        std::vector<std::thread> threads;
+        for (unsigned int id = 0; id < 3; id++) {
+            threads.emplace_back([&sink, id] {
+                auto writer = sink.writer();
+                for (std::uint32_t i = 0; i < 20000; i++) {
+                    writer.append(TurnRecord{id, i, i * 7, 0, 0});
+                }
+                writer.flush();
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        {
+            auto writer = sink.writer();
+            std::vector<char> record(5000);
+            try {
+                writer.append(record.data(), record.size());
+                assert(false);
+            } catch (std::length_error const &) {
+            }
+        }
+        sink.close();
+
+        std::vector<std::uint32_t> next(3, 0);
+        size_t blocks = 0;
+        readTraceBlocks(path, [&](std::uint32_t writer,
+                                  std::string_view payload) {
+            assert(writer < 3 && payload.size() % sizeof(TurnRecord) == 0);
+            blocks++;
+            for (size_t at = 0; at < payload.size();
+                 at += sizeof(TurnRecord)) {
+                TurnRecord record;
+                std::memcpy(&record, payload.data() + at, sizeof(record));
+                assert(record.game == writer);
+                assert(record.turn == next[writer]);
+                assert(record.money == record.turn * 7);
+                next[writer]++;
+            }
+        });
+        assert(next == std::vector<std::uint32_t>(3, 20000));
+        assert(sink.statistics().blocks == blocks);
+        assert(std::filesystem::file_size(path) == blocks * 4096);
+    }
+
+    // Obserwator tur zapisuje każdą turę gier symulacji.
+    {
+        TraceSink sink(path);
+        TurnTraceRecorder recorder(sink);
+        std::uint64_t turns = 0;
+        for (std::uint64_t seed = 0; seed < 50; seed++) {
+            recorder.beginGame(seed);
+            GameOutcome outcome =
+                simulateGame(defaultLayout(), 3, 20, seed, nullptr, &recorder);
+            turns += outcome.rounds * 3;
+        }
+        recorder.flush();
+        sink.close();
+        std::uint64_t records = 0;
+        readTraceBlocks(path, [&](std::uint32_t, std::string_view payload) {
+            records += payload.size() / sizeof(TurnRecord);
+        });
+        assert(records > 0 && records <= turns);
+    }
+
+    // Zamknięcie, gdy piszący ma nieprzekazane rekordy, zgubiłoby je; po
+    // zamknięciu nie można nic dopisać. Numer pola ma 32 bity.
+    {
+        TraceSink sink(path);
+        auto writer = sink.writer();
+        writer.append(TurnRecord{0, 0, 0, 5000000, 12});
+        try {
+            sink.close();
+            assert(false);
+        } catch (std::logic_error const &) {
+        }
+        writer.flush();
+        sink.close();
+        for (int attempt = 0; attempt < 2; attempt++) {
+            try {
+                if (attempt == 0) {
+                    writer.append(TurnRecord{0, 1, 0, 0, 0});
+                } else {
+                    sink.writer();
+                }
+                assert(false);
+            } catch (std::logic_error const &) {
+            }
+        }
+    }
+    readTraceBlocks(path, [](std::uint32_t, std::string_view payload) {
+        TurnRecord record;
+        std::memcpy(&record, payload.data(), sizeof(record));
+        assert(payload.size() == sizeof(record) && record.field == 5000000);
+    });
+
+    // Rozmiar bloku wyznacza pierwszy nagłówek: blok innego rozmiaru albo
+    // wychodzący poza plik jest błędem (bez wczytywania go).
+    std::string block;
+    {
+        std::ifstream in(path, std::ios::binary);
+        block.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    auto withSize = [&block](std::uint32_t blockSize) {
+        std::string changed = block;
+        std::memcpy(&changed[offsetof(TraceBlockHeader, blockSize)],
+                    &blockSize, sizeof(blockSize));
+        return changed;
+    };
+    for (std::string const &corrupted :
+         {withSize(UINT32_MAX), block + withSize(2 * block.size()) + block,
+          block + block.substr(0, block.size() / 2)}) {
+        std::ofstream(path, std::ios::binary) << corrupted;
+        try {
+            readTraceBlocks(path, [](std::uint32_t, std::string_view) {});
+            assert(false);
+        } catch (std::runtime_error const &) {
+        }
+    }
+    std::filesystem::remove(path);
+#endif
+
+// Kodek bloków rekordów tur odtwarza dane dokładnie (także wartości skrajne
+// i niepełne grupy), wykrywa ucięte bloki, a plik skompresowanego śladu
+// pozwala czytać dowolny blok
+#if TEST_NUM == 721
+    for (std::int32_t value : {0, 1, -1, 1000, -1000, INT32_MAX, INT32_MIN}) {
+        assert(codec::unzigzag(codec::zigzag(value)) == value);
+    }
+    assert(codec::zigzag(-1) == 1 && codec::zigzag(1) == 2);
+
+    std::mt19937 random(721);
+    for (size_t count : {0, 1, 127, 128, 129, 5000}) {
+        std::vector<TurnRecord> records(count);
+        for (size_t i = 0; i < count; i++) {
+            records[i] = {static_cast<std::uint32_t>(i / 40),
+                          static_cast<std::uint32_t>(i % 40),
+                          static_cast<std::uint32_t>(
+                              i % 7 == 0 ? random() : 1000 + random() % 50),
+                          static_cast<std::uint32_t>(random() % 12),
+                          static_cast<std::uint32_t>(2 + random() % 11)};
+        }
+        if (count > 1) {
+            records[count - 1].money = UINT32_MAX;
+            records[count - 2].field = 10000000;
+        }
+        std::string block = codec::encodeBlock(records.data(), count);
+        std::vector<TurnRecord> decoded = codec::decodeBlock(block);
+        assert(decoded.size() == count);
+        assert(std::memcmp(decoded.data(), records.data(),
+                           count * sizeof(TurnRecord)) == 0);
+        if (count >= 128) {
+            assert(block.size() < count * sizeof(TurnRecord) / 2);
+            try {
+                codec::decodeBlock(std::string_view(block).substr(
+                    0, block.size() - 3));
+                assert(false);
+            } catch (codec::CodecError const &) {
+            }
+        }
+        // Liczba rekordów lub długość kolumn niemożliwa dla tego bloku jest
+        // odrzucana przed przydziałem pamięci.
+        for (size_t offset : {size_t(0), size_t(5)}) {
+            if (count == 0 && offset == 0) {
+                continue;
+            }
+            std::string corrupted = block;
+            std::uint32_t huge = offset == 0 ? 0 : UINT32_MAX;
+            std::memcpy(corrupted.data() + offset, &huge, sizeof(huge));
+            try {
+                codec::decodeBlock(corrupted);
+                assert(false);
+            } catch (codec::CodecError const &) {
+            }
+        }
+    }
+
+    std::vector<std::string> samples{"", "abc", "aaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+                                     "abcabcabcabcabcabcabcabcabcabcabcX"};
+    std::string mixed;
+    for (int i = 0; i < 20000; i++) {
+        mixed += i % 3 == 0 ? std::to_string(random() % 100) : "turn;";
+    }
+    samples.push_back(mixed);
+    std::string noise(4096, '\0');
+    for (auto &c : noise) {
+        c = static_cast<char>(random());
+    }
+    samples.push_back(noise);
+    for (auto const &sample : samples) {
+        std::string compressed = codec::lzCompress(sample);
+        assert(codec::lzDecompress(compressed, sample.size()) == sample);
+    }
+    assert(codec::lzCompress(mixed).size() < mixed.size() / 3);
+
+    auto path = std::filesystem::temp_directory_path() /
+                ("worldcup_test_721_" + std::to_string(::getpid()));
+    auto packed = path;
+    packed += ".wcz";
+    std::vector<std::vector<TurnRecord>> original;
+    {
+        TraceSink::Options options;
+        options.blockSize = 8192;
+        TraceSink sink(path, options);
+        TurnTraceRecorder recorder(sink);
+        for (std::uint64_t seed = 0; seed < 400; seed++) {
+            recorder.beginGame(seed);
+            simulateGame(defaultLayout(), 4, 100, seed, nullptr, &recorder);
+        }
+        recorder.flush();
+        sink.close();
+    }
+    readTraceBlocks(path, [&](std::uint32_t, std::string_view payload) {
+        original.emplace_back(payload.size() / sizeof(TurnRecord));
+        std::memcpy(original.back().data(), payload.data(), payload.size());
+    });
+    std::uint64_t size = compressTrace(path, packed, 3);
+    assert(size == std::filesystem::file_size(packed));
+    assert(size < std::filesystem::file_size(path) / 2);
+    CompressedTrace trace(packed);
+    assert(trace.blocks() == original.size() && original.size() > 2);
+    assert(trace.traceBlockSize() == 8192);
+    for (size_t block : {original.size() - 1, size_t(0), original.size() / 2}) {
+        auto records = trace.readBlock(block);
+        assert(trace.entry(block).records == records.size());
+        assert(records.size() == original[block].size());
+        assert(std::memcmp(records.data(), original[block].data(),
+                           records.size() * sizeof(TurnRecord)) == 0);
+    }
+
+    // Uszkodzona stopka lub indeks są wykrywane przy otwarciu, zanim
+    // rozmiar z pliku posłuży do przydziału.
+    std::string file(size, '\0');
+    {
+        std::ifstream in(packed, std::ios::binary);
+        in.read(file.data(), file.size());
+    }
+    size_t footer = file.size() - 24;
+    size_t indexOffset = footer - trace.blocks() * 24;
+    auto expectCorrupted = [&](size_t offset, std::uint64_t value,
+                               size_t width) {
+        std::string corrupted = file;
+        std::memcpy(corrupted.data() + offset, &value, width);
+        std::ofstream(packed, std::ios::binary | std::ios::trunc)
+            .write(corrupted.data(), corrupted.size());
+        try {
+            CompressedTrace broken(packed);
+            assert(false);
+        } catch (std::runtime_error const &) {
+        }
+    };
+    expectCorrupted(footer + 8, std::uint64_t{1} << 56, 8);  // liczba bloków
+    expectCorrupted(footer, std::uint64_t{1} << 56, 8);      // indeks
+    expectCorrupted(indexOffset, std::uint64_t{1} << 56, 8);  // położenie
+    expectCorrupted(indexOffset + 12, UINT32_MAX, 4);         // rekordy
+
+    // Pusty ślad daje plik bez bloków, który da się otworzyć.
+    std::ofstream(path, std::ios::binary | std::ios::trunc);
+    compressTrace(path, packed, 3);
+    CompressedTrace empty(packed);
+    assert(empty.blocks() == 0 && empty.traceBlockSize() == 0);
+    std::filesystem::remove(path);
+    std::filesystem::remove(packed);
+#endif
+
+// Przewinięcie nagrania do dowolnej rundy daje ten sam stan co rozgrywka od
+// początku i odtwarza mniej rund niż odstęp między punktami kontrolnymi;
+// nagranie kończy grę jak play()
+#if TEST_NUM == 722
+    std::vector<FieldSpec> layout{
+        {FieldType::Beginning, "Start", 60, 0.0},
+        {FieldType::Match, "Mecz", 20, 1.0},
+        {FieldType::YellowCard, "Kartka", 2, 0.0},
+        {FieldType::Goal, "Gol", 30, 0.0},
+        {FieldType::Bookmaker, "Bukmacher", 20, 0.0},
+        {FieldType::Penalty, "Karny", 50, 0.0},
+        {FieldType::Match, "Finał", 30, 2.0}};
+    auto newGame = [&layout](std::uint64_t seed) {
+        auto engine = std::make_shared<std::mt19937_64>(seed);
+        auto game = std::make_unique<WorldCup2022>(layout);
+        game->addDie(std::make_shared<RandomDie>(engine));
+        game->addDie(std::make_shared<RandomDie>(engine));
+        for (unsigned int seat = 0; seat < 3; seat++) {
+            game->addPlayer(seatName(seat));
+        }
+        return game;
+    };
+    auto path = std::filesystem::temp_directory_path() /
+                ("worldcup_test_722_" + std::to_string(::getpid()));
+
+    auto recorded = newGame(5);
+    auto scoreboard = std::make_shared<OutcomeScoreBoard>();
+    recorded->setScoreBoard(scoreboard);
+    {
+        std::ofstream out(path, std::ios::binary);
+        assert(recordGame(*recorded, layout, 300, 7, out) == 300);
+    }
+    auto reference = newGame(5);
+    auto referenceScoreboard = std::make_shared<OutcomeScoreBoard>();
+    reference->setScoreBoard(referenceScoreboard);
+    reference->play(300);
+    assert(scoreboard->getWinner() == referenceScoreboard->getWinner());
+
+    GameRecording recording(path);
+    assert(recording.firstRound() == 0 && recording.lastRound() == 300);
+    assert(recording.getInterval() == 7);
+    assert(recording.checkpoints() == 44);
+    assert(recording.getLayout().size() == layout.size());
+    assert(recording.getLayout()[6].weight == 2.0);
+    auto stepped = newGame(5);
+    stepped->setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+    for (unsigned int round = 0; round <= 300; round++) {
+        GameState expected = stepped->getState();
+        GameState actual = recording.seek(round);
+        assert(actual.round == round && expected.round == round);
+        assert(actual.players == expected.players);
+        assert(actual.board == expected.board);
+        assert(recording.replayedRounds() == round % 7 ||
+               round == 300);
+        if (round < 300) {
+            stepped->step(1);
+        }
+    }
+    for (unsigned int round : {250u, 3u, 299u, 0u}) {
+        assert(recording.seek(round).round == round);
+    }
+    try {
+        recording.seek(301);
+        assert(false);
+    } catch (std::out_of_range const &) {
+    }
+
+    // Gra zakończona bankructwem przed limitem rund i nagranie gry
+    // wznowionej (numery rund liczone dalej).
+    auto resumed = newGame(9);
+    resumed->setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+    resumed->step(10);
+    {
+        std::ofstream out(path, std::ios::binary);
+        recordGame(*resumed, layout, 20, 4, out);
+    }
+    GameRecording second(path);
+    assert(second.firstRound() == 10 && second.lastRound() == 30);
+    auto check = newGame(9);
+    check->setScoreBoard(std::make_shared<OutcomeScoreBoard>());
+    check->step(23);
+    assert(second.seek(23).players == check->getState().players);
+    assert(second.replayedRounds() == 1);
+
+    std::vector<FieldSpec> harsh = defaultLayout();
+    auto engine = std::make_shared<std::mt19937_64>(1);
+    WorldCup2022 shortGame(harsh);
+    shortGame.addDie(std::make_shared<RandomDie>(engine));
+    shortGame.addDie(std::make_shared<RandomDie>(engine));
+    shortGame.addPlayer("A");
+    shortGame.addPlayer("B");
+    auto shortScoreboard = std::make_shared<OutcomeScoreBoard>();
+    shortGame.setScoreBoard(shortScoreboard);
+    unsigned int played;
+    {
+        std::ofstream out(path, std::ios::binary);
+        played = recordGame(shortGame, harsh, 1000, 5, out);
+    }
+    assert(played < 1000 && !shortScoreboard->getWinner().empty());
+    GameRecording finished(path);
+    assert(finished.lastRound() == played);
+    assert(finished.seek(played).players.size() == 1);
+
+    // Liczby i długości z uszkodzonego nagrania są sprawdzane z rozmiarem
+    // pliku, zanim posłużą do przydziału.
+    std::string file(std::filesystem::file_size(path), '\0');
+    {
+        std::ifstream in(path, std::ios::binary);
+        in.read(file.data(), file.size());
+    }
+    auto expectCorrupted = [&](size_t offset, std::uint64_t value,
+                               size_t width) {
+        std::string corrupted = file;
+        std::memcpy(corrupted.data() + offset, &value, width);
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+            .write(corrupted.data(), corrupted.size());
+        try {
+            GameRecording broken(path);
+            broken.seek(broken.lastRound());
+            assert(false);
+        } catch (std::runtime_error const &) {
+        }
+    };
+    expectCorrupted(file.size() - 12, UINT32_MAX, 4);  // liczba wpisów
+    expectCorrupted(file.size() - 20, 1, 8);           // położenie indeksu
+    expectCorrupted(4, UINT32_MAX, 4);                 // długość nagłówka
+    // Położenie ostatniej ramki i długość tej ramki.
+    expectCorrupted(file.size() - 28, file.size(), 8);
+    std::uint64_t last;
+    std::memcpy(&last, file.data() + file.size() - 28, 8);
+    expectCorrupted(last, UINT32_MAX - 1, 4);
+    std::filesystem::remove(path);
+#endif
+
+// Model zastępczy przewiduje w obszarze uczenia wynik zgodny z symulacją na
+// nowych ziarnach (w granicach przedziału błędu), poza nim liczy symulację,
+// a zapisany i wczytany daje te same odpowiedzi
+#if TEST_NUM == 723
+    SurrogateConfig config;
+    config.minPlayers = 2;
+    config.maxPlayers = 3;
+    config.minWeight = 1.0;
+    config.maxWeight = 4.0;
+    config.points = 30;
+    config.games = 2000;
+    SurrogateModel model = SurrogateModel::train(config, 2);
+    assert(model.weights() == 6);
+    model.setFallback(2000, 2);
+
+    std::vector<double> weights{1.5, 3.0, 2.0, 3.5, 2.5, 1.2};
+    std::vector<FieldSpec> layout = config.layout;
+    for (size_t field = 0, next = 0; field < layout.size(); field++) {
+        if (layout[field].type == FieldType::Match) {
+            layout[field].weight = weights[next++];
+        }
+    }
+    WinRateEstimate estimate = model.predict(3, weights);
+    assert(!estimate.simulated && estimate.probability.size() == 3);
+    SimulationAggregate fresh =
+        runSimulation({layout, 3, config.rounds, 100000, 120000}, 2);
+    double sum = 0;
+    for (unsigned int seat = 0; seat < 3; seat++) {
+        double p = static_cast<double>(fresh.wins[seat]) / fresh.games;
+        double freshHalfWidth =
+            SurrogateModel::z * std::sqrt(p * (1 - p) / fresh.games);
+        assert(estimate.halfWidth[seat] > 0);
+        assert(std::abs(estimate.probability[seat] - p) <=
+               estimate.halfWidth[seat] + freshHalfWidth);
+        assert(model.crossValidation(3, seat) < 0.05);
+        sum += estimate.probability[seat];
+    }
+    assert(std::abs(sum - 1) < 1e-6);
+
+    WinRateEstimate outside = model.predict(4, weights);
+    assert(outside.simulated && outside.probability.size() == 4);
+    std::vector<double> heavy = weights;
+    heavy[5] = 8.0;
+    assert(!model.covers(3, heavy) && model.covers(2, weights));
+    for (size_t field = 0, next = 0; field < layout.size(); field++) {
+        if (layout[field].type == FieldType::Match) {
+            layout[field].weight = heavy[next++];
+        }
+    }
+    WinRateEstimate simulated = model.predict(3, heavy);
+    SimulationAggregate direct =
+        runSimulation({layout, 3, config.rounds, 0, 2000}, 1);
+    assert(simulated.simulated);
+    for (unsigned int seat = 0; seat < 3; seat++) {
+        assert(simulated.probability[seat] ==
+               static_cast<double>(direct.wins[seat]) / direct.games);
+    }
+
+    try {
+        model.predict(3, {1.0, 2.0});
+        assert(false);
+    } catch (std::invalid_argument const &) {
+    }
+    // Liczby graczy spoza zakresu gry są odrzucane, zanim trafią do
+    // symulacji zastępczej lub planu uczenia.
+    for (unsigned int wrong :
+         {1u, static_cast<unsigned int>(WorldCup2022::maxPlayers) + 1}) {
+        try {
+            model.predict(wrong, weights);
+            assert(false);
+        } catch (std::invalid_argument const &) {
+        }
+        SurrogateConfig tooMany = config;
+        tooMany.minPlayers = std::min(wrong, tooMany.minPlayers);
+        tooMany.maxPlayers = wrong;
+        try {
+            SurrogateModel::train(tooMany, 1);
+            assert(false);
+        } catch (std::invalid_argument const &) {
+        }
+    }
+
+    std::stringstream file;
+    model.write(file);
+    SurrogateModel loaded = SurrogateModel::read(file);
+    WinRateEstimate again = loaded.predict(3, weights);
+    for (unsigned int seat = 0; seat < 3; seat++) {
+        assert(std::abs(again.probability[seat] -
+                        estimate.probability[seat]) < 1e-12);
+        assert(std::abs(again.halfWidth[seat] - estimate.halfWidth[seat]) <
+               1e-12);
+    }
+
+    // Liczby z uszkodzonego pliku nie wymuszają ogromnych przydziałów:
+    // tysiące pól meczów (n^2 współczynników) lub miliard graczy.
+    std::string text = file.str();
+    std::string header = text.substr(0, text.find('\n') + 1);
+    std::string matches = header;
+    matches.replace(matches.rfind(' '), std::string::npos, " 100000\n");
+    for (int field = 0; field < 3000; field++) {
+        matches += "5 10 1 \"Mecz\"\n";
+    }
+    std::string players = header;
+    size_t maxPlayersAt = 0;
+    for (int space = 0; space < 4; space++) {
+        maxPlayersAt = players.find(' ', maxPlayersAt) + 1;
+    }
+    players.replace(maxPlayersAt, players.find(' ', maxPlayersAt) - maxPlayersAt,
+                    "1000000000");
+    // Obszar wag z minWeight >= maxWeight jest pusty.
+    std::istringstream headerIn(header);
+    std::vector<std::string> tokens;
+    for (std::string token; headerIn >> token;) {
+        tokens.push_back(token);
+    }
+    std::swap(tokens[6], tokens[7]);
+    std::string swapped;
+    for (auto const &token : tokens) {
+        swapped += token + ' ';
+    }
+    swapped += '\n' + text.substr(header.size());
+    for (auto const &corrupted :
+         {matches, players, swapped, text.substr(0, 200)}) {
+        std::stringstream broken(corrupted);
+        try {
+            SurrogateModel::read(broken);
+            assert(false);
+        } catch (std::runtime_error const &) {
+        }
+    }
+#endif
+
+// Histogram opóźnień trzyma percentyle z błędem najwyżej 1/8; plan
+// generatora obciążenia jest otwarty, opóźnienie kroku liczy się od
+// planowanej chwili wysłania, a kroki zakończone błędem nie trafiają do
+// percentyli udanych
+#if TEST_NUM == 724
+    {
+        LatencyHistogram small, low, high, all;
+        for (std::uint64_t value = 0; value < 8; value++) {
+            small.record(value);
+        }
+        assert(small.percentile(0) == 0 && small.percentile(100) == 7);
+        for (std::uint64_t value = 1; value <= 1000; value++) {
+            (value <= 500 ? low : high).record(value);
+            all.record(value);
+        }
+        low.merge(high);
+        assert(low.count() == 1000 && low.max() == 1000 &&
+               low.mean() == all.mean());
+        for (double p = 0; p <= 100; p += 0.5) {
+            std::uint64_t exact = static_cast<std::uint64_t>(p / 100 * 999) + 1;
+            assert(all.percentile(p) <= exact);
+            assert(exact - all.percentile(p) <= exact / 8);
+            assert(low.percentile(p) == all.percentile(p));
+        }
+    }
+
+    using loadgen::Clock;
+    using std::chrono::milliseconds;
+    Clock::time_point start{};
+    {
+        // Stałe odstępy: 4 klientów, łącznie 1000 kroków na sekundę, więc
+        // każdy co 4 ms, a kolejni przesunięci o 1 ms.
+        loadgen::OpenLoopSchedule fixed(4, 1000, false, start);
+        for (int i = 0; i < 400; i++) {
+            auto [due, id] = fixed.advance();
+            assert(id == static_cast<size_t>(i % 4));
+            // Odstęp jest zaokrąglany do rozdzielczości zegara.
+            assert(std::chrono::abs(due - (start + milliseconds(i))) <
+                   std::chrono::microseconds(1));
+        }
+        // Proces Poissona: średnia liczba kroków na sekundę jest zadana.
+        loadgen::OpenLoopSchedule poisson(10, 1000, true, start);
+        Clock::time_point last = start;
+        for (int i = 0; i < 20000; i++) {
+            auto [due, id] = poisson.advance();
+            assert(due >= last && id < 10);
+            last = due;
+        }
+        double rate = 20000 / std::chrono::duration<double>(last - start).count();
+        assert(rate > 970 && rate < 1030);
+    }
+    {
+        // Usługa stoi przez 10 ms: kroki zaplanowane co 1 ms wychodzą
+        // dopiero po przestoju i każdy jest obsłużony w 100 us. Opóźnienie
+        // liczone od planu obejmuje czekanie, czas obsługi - nie.
+        loadgen::StepLatencies latencies;
+        Clock::time_point sent = start + milliseconds(10);
+        Clock::time_point answered = sent + std::chrono::microseconds(100);
+        for (int i = 0; i < 10; i++) {
+            latencies.record({loadgen::Kind::Step, start + milliseconds(i), sent},
+                             answered, true);
+        }
+        assert(latencies.response.count() == 10 &&
+               latencies.window.count() == 10 &&
+               latencies.service.count() == 10);
+        assert(latencies.response.max() == 10100000);
+        assert(latencies.response.percentile(50) <= 5100000 &&
+               latencies.response.percentile(50) >= 5100000 / 8 * 7);
+        assert(latencies.service.max() == 100000);
+        // Krok zakończony błędem ma własny histogram.
+        latencies.record({loadgen::Kind::Step, start, sent},
+                         start + milliseconds(50), false);
+        assert(latencies.failed.count() == 1 &&
+               latencies.failed.max() == 50000000);
+        assert(latencies.response.count() == 10 &&
+               latencies.service.count() == 10 &&
+               latencies.response.max() == 10100000);
+    }
+    {
+        // Gry w procesie: liczba kroków wynika z planu, nie z tempa obsługi.
+        loadgen::Options options;
+        options.path = "-";
+        options.clients = 4;
+        options.rate = 5000;
+        options.seconds = 0.2;
+        options.poisson = false;
+        loadgen::LoadGenerator generator(options);
+        std::ostringstream out;
+        assert(generator.run(out));
+        generator.report(out);
+        auto const &latencies = generator.stepLatencies();
+        assert(latencies.response.count() <= 1000 &&
+               latencies.response.count() >= 900);
+        assert(latencies.failed.count() == 0 && generator.errorCount() == 0);
+    }
+#endif
 }
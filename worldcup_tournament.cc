@@ -0,0 +1,30 @@
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "worldcup_tournament.h"
+
+// Narzędzie: worldcup_tournament [liczba turniejów] [liczba grup]
+//            [wielkość grupy] [awansujący z grupy] [liczba rund]
+//            [liczba wątków]
+// Wypisuje prawdopodobieństwa przejścia kolejnych etapów i tytułu dla
+// każdego zawodnika oraz średnią długość gier w etapach.
+int main(int argc, char *argv[]) {
+    std::uint64_t tournaments = argc > 1 ? std::stoull(argv[1]) : 100000;
+    TournamentConfig config;
+    if (argc > 2) config.groups = std::stoul(argv[2]);
+    if (argc > 3) config.groupSize = std::stoul(argv[3]);
+    if (argc > 4) config.advancing = std::stoul(argv[4]);
+    if (argc > 5) config.rounds = std::stoul(argv[5]);
+    unsigned int threads =
+        argc > 6 ? std::stoul(argv[6]) : std::thread::hardware_concurrency();
+
+    try {
+        TournamentSimulator simulator(config);
+        simulator.report(simulator.run(0, tournaments, threads), std::cout);
+    } catch (std::invalid_argument const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,260 @@
+#ifndef WORLDCUP_TOURNAMENT_H
+#define WORLDCUP_TOURNAMENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "worldcup_simulation.h"
+
+// Parametry turnieju: groups grup po groupSize zawodników, z każdej grupy
+// awansuje advancing najlepszych, a dalej gra się systemem pucharowym
+// (pojedyncze gry dwóch zawodników). Liczba awansujących z grup musi być
+// potęgą dwójki.
+struct TournamentConfig {
+    std::vector<FieldSpec> layout = defaultLayout();
+    unsigned int groups = 8;
+    unsigned int groupSize = 4;
+    unsigned int advancing = 2;
+    unsigned int rounds = 100;
+};
+
+// Wyniki serii turniejów. Etap 0 to faza grupowa, etapy 1.. to kolejne
+// rundy pucharowe; survived[stage][entrant] to liczba turniejów, w których
+// zawodnik przeszedł dany etap, więc ostatni wiersz to liczba tytułów.
+// Wszystkie pola są sumami, więc wyniki rozłącznych serii można łączyć.
+struct TournamentAggregate {
+    std::uint64_t tournaments = 0;
+    std::vector<std::vector<std::uint64_t>> survived;
+    std::vector<std::uint64_t> stageGames;
+    std::vector<std::uint64_t> stageRounds;
+
+    TournamentAggregate() = default;
+
+    TournamentAggregate(size_t stages, size_t entrants)
+        : survived(stages, std::vector<std::uint64_t>(entrants, 0)),
+          stageGames(stages, 0),
+          stageRounds(stages, 0) {}
+
+    std::vector<std::uint64_t> const &champions() const {
+        return survived.back();
+    }
+
+    void merge(TournamentAggregate const &other) {
+        tournaments += other.tournaments;
+        for (size_t stage = 0; stage < other.survived.size(); stage++) {
+            for (size_t entrant = 0; entrant < other.survived[stage].size();
+                 entrant++) {
+                survived[stage][entrant] += other.survived[stage][entrant];
+            }
+            stageGames[stage] += other.stageGames[stage];
+            stageRounds[stage] += other.stageRounds[stage];
+        }
+    }
+};
+
+// Tablica wyników zapamiętująca kolejność bankructw i liczbę rund - tyle
+// potrzeba, żeby ustalić pełną klasyfikację gry.
+class RankingScoreBoard : public ScoreBoard {
+   private:
+    std::string const bankruptStatus =
+        Player("", PlayerState{0, 0, 0, true}).getStatus();
+    std::vector<std::string> bankrupts;
+    unsigned int rounds = 0;
+
+   public:
+    void onRound(unsigned int roundNo) override { rounds = roundNo + 1; }
+
+    void onTurn(std::string const &playerName, std::string const &playerStatus,
+                std::string const &squareName, unsigned int money) override {
+        (void)squareName;
+        (void)money;
+        if (playerStatus == bankruptStatus) {
+            bankrupts.push_back(playerName);
+        }
+    }
+
+    void onWin(std::string const &playerName) override { (void)playerName; }
+
+    std::vector<std::string> const &getBankrupts() const { return bankrupts; }
+
+    unsigned int getRounds() const { return rounds; }
+};
+
+// Symulator turniejów. Jeden turniej to ciąg zależnych od siebie etapów, a
+// pojedyncza gra trwa mikrosekundy, więc równolegle rozgrywamy całe
+// turnieje (po jednym ziarnie na turniej), a nie gry w obrębie etapu.
+// Wszystkie gry turnieju losują z jednego generatora, więc turniej o danym
+// ziarnie jest powtarzalny niezależnie od liczby wątków.
+class TournamentSimulator {
+   private:
+    TournamentConfig config;
+    size_t stages;
+
+    static bool powerOfTwo(unsigned int n) {
+        return n > 0 && (n & (n - 1)) == 0;
+    }
+
+    // Rozgrywa jedną grę i zwraca zawodników od zwycięzcy do gracza, który
+    // zbankrutował pierwszy. Gracze w grze są uporządkowani malejąco według
+    // pieniędzy (przy remisie decyduje kolejność ruchów, jak przy wyborze
+    // zwycięzcy w WorldCup2022).
+    std::vector<unsigned int> rankGame(
+        std::vector<unsigned int> const &entrants,
+        std::shared_ptr<std::mt19937_64> engine, unsigned int &rounds) const {
+        auto scoreboard = std::make_shared<RankingScoreBoard>();
+        WorldCup2022 worldCup(config.layout);
+        worldCup.addDie(std::make_shared<RandomDie>(engine));
+        worldCup.addDie(std::make_shared<RandomDie>(engine));
+        for (unsigned int entrant : entrants) {
+            worldCup.addPlayer(seatName(entrant));
+        }
+        worldCup.setScoreBoard(scoreboard);
+        worldCup.play(config.rounds);
+        rounds = scoreboard->getRounds();
+
+        auto entrantOf = [&](std::string const &name) {
+            return *std::find_if(entrants.begin(), entrants.end(),
+                                 [&](unsigned int entrant) {
+                                     return seatName(entrant) == name;
+                                 });
+        };
+        auto survivors = worldCup.getState().players;
+        std::stable_sort(survivors.begin(), survivors.end(),
+                         [](auto const &a, auto const &b) {
+                             return a.second.money > b.second.money;
+                         });
+        std::vector<unsigned int> ranking;
+        for (auto const &[name, state] : survivors) {
+            ranking.push_back(entrantOf(name));
+        }
+        auto const &bankrupts = scoreboard->getBankrupts();
+        for (auto it = bankrupts.rbegin(); it != bankrupts.rend(); ++it) {
+            ranking.push_back(entrantOf(*it));
+        }
+        return ranking;
+    }
+
+   public:
+    // Rzuca std::invalid_argument przy niepoprawnych parametrach.
+    explicit TournamentSimulator(TournamentConfig config)
+        : config(std::move(config)), stages(1) {
+        if (this->config.groups == 0 || this->config.groupSize < 2 ||
+            this->config.groupSize > 11) {
+            throw std::invalid_argument("group size must be in [2, 11]");
+        }
+        if (this->config.advancing == 0 ||
+            this->config.advancing > this->config.groupSize) {
+            throw std::invalid_argument("invalid number of advancing players");
+        }
+        unsigned int bracket = this->config.groups * this->config.advancing;
+        if (!powerOfTwo(bracket)) {
+            throw std::invalid_argument("bracket size must be a power of two");
+        }
+        for (; bracket > 1; bracket /= 2) {
+            stages++;
+        }
+    }
+
+    size_t stageCount() const { return stages; }
+
+    unsigned int entrantCount() const {
+        return config.groups * config.groupSize;
+    }
+
+    // Rozgrywa jeden turniej, dopisuje jego wyniki do aggregate i zwraca
+    // numer mistrza. Zawodnik o numerze e występuje jako seatName(e).
+    unsigned int play(std::uint64_t seed,
+                      TournamentAggregate &aggregate) const {
+        auto engine = std::make_shared<std::mt19937_64>(seed);
+        unsigned int rounds;
+
+        // Awansujący w kolejności rozstawienia: najpierw zwycięzcy grup,
+        // potem drudzy itd.
+        std::vector<unsigned int> bracket(config.groups * config.advancing);
+        for (unsigned int group = 0; group < config.groups; group++) {
+            std::vector<unsigned int> entrants(config.groupSize);
+            for (unsigned int i = 0; i < config.groupSize; i++) {
+                entrants[i] = group * config.groupSize + i;
+            }
+            std::vector<unsigned int> ranking =
+                rankGame(entrants, engine, rounds);
+            aggregate.stageGames[0]++;
+            aggregate.stageRounds[0] += rounds;
+            for (unsigned int place = 0; place < config.advancing; place++) {
+                bracket[place * config.groups + group] = ranking[place];
+                aggregate.survived[0][ranking[place]]++;
+            }
+        }
+
+        // Rozstawienie klasyczne: najwyżej rozstawiony z najniżej
+        // rozstawionym, wyżej rozstawiony rusza się pierwszy.
+        for (size_t stage = 1; stage < stages; stage++) {
+            size_t half = bracket.size() / 2;
+            std::vector<unsigned int> next(half);
+            for (size_t i = 0; i < half; i++) {
+                std::vector<unsigned int> pair{bracket[i],
+                                               bracket[bracket.size() - 1 - i]};
+                next[i] = rankGame(pair, engine, rounds)[0];
+                aggregate.stageGames[stage]++;
+                aggregate.stageRounds[stage] += rounds;
+                aggregate.survived[stage][next[i]]++;
+            }
+            bracket = std::move(next);
+        }
+        aggregate.tournaments++;
+        return bracket[0];
+    }
+
+    // Rozgrywa turnieje o ziarnach z [firstSeed, firstSeed + count) na
+    // threads wątkach.
+    TournamentAggregate run(std::uint64_t firstSeed, std::uint64_t count,
+                            unsigned int threads) const {
+        std::vector<TournamentAggregate> local(
+            std::max(1u, threads), TournamentAggregate(stages, entrantCount()));
+        parallelForSeeds(firstSeed, count, threads,
+                         [&](unsigned int id, std::uint64_t seed) {
+                             play(seed, local[id]);
+                         });
+        TournamentAggregate result(stages, entrantCount());
+        for (auto const &aggregate : local) {
+            result.merge(aggregate);
+        }
+        return result;
+    }
+
+    // Tabela: dla każdego zawodnika prawdopodobieństwo przejścia kolejnych
+    // etapów (ostatnia kolumna - tytuł), a pod nią średnia długość gier
+    // w każdym etapie.
+    void report(TournamentAggregate const &aggregate,
+                std::ostream &out) const {
+        double tournaments = std::max<std::uint64_t>(1, aggregate.tournaments);
+        out << "entrant";
+        for (size_t stage = 0; stage < stages; stage++) {
+            out << "\tstage" << stage;
+        }
+        out << '\n' << std::fixed << std::setprecision(4);
+        for (unsigned int entrant = 0; entrant < entrantCount(); entrant++) {
+            out << seatName(entrant);
+            for (size_t stage = 0; stage < stages; stage++) {
+                out << '\t' << aggregate.survived[stage][entrant] / tournaments;
+            }
+            out << '\n';
+        }
+        out << "rounds/game";
+        for (size_t stage = 0; stage < stages; stage++) {
+            out << '\t'
+                << static_cast<double>(aggregate.stageRounds[stage]) /
+                       std::max<std::uint64_t>(1, aggregate.stageGames[stage]);
+        }
+        out << '\n' << std::defaultfloat;
+    }
+};
+
+#endif
@@ -0,0 +1,539 @@
+#ifndef WORLDCUP_TRACE_H
+#define WORLDCUP_TRACE_H
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "worldcup_hugepages.h"
+#include "worldcup_simulation.h"
+
+// Kolumnowy zapis przebiegu gier odczytanych z dziennika tablicy wyników
+// tekstowej (wiersze "=== Runda: N", "Nazwa [status] [pieniądze] - pole",
+// "=== Zwycięzca: Nazwa"). Nazwy graczy i pól są zastąpione numerami
+// w słownikach, a każda tura zajmuje po jednej pozycji w kolumnach.
+struct LogTrace {
+    // Wartości kolumny wait poza liczbą tur czekania.
+    static constexpr std::uint32_t playing = 0;
+    static constexpr std::uint32_t bankrupt =
+        std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::int32_t noWinner = -1;
+
+    std::vector<std::string> playerNames;
+    std::vector<std::string> fieldNames;
+
+    // Kolumny mogą mieć miliardy pozycji, więc leżą na dużych stronach.
+    HugeVector<std::uint32_t> round;
+    HugeVector<std::uint16_t> player;
+    HugeVector<std::uint16_t> field;
+    HugeVector<std::uint32_t> money;
+    HugeVector<std::uint32_t> wait;
+
+    // Dla każdej gry: numer jej pierwszej tury i zwycięzca.
+    HugeVector<std::uint32_t> gameStart;
+    HugeVector<std::int32_t> winner;
+
+    size_t turns() const { return round.size(); }
+
+    size_t games() const { return gameStart.size(); }
+
+    // Format binarny: znacznik "WCT1", liczności, słowniki (napisy
+    // poprzedzone długością u16), a po nich kolumny w porządku bajtów
+    // komputera. Rzuca std::invalid_argument, zanim cokolwiek zapisze,
+    // gdy któraś nazwa nie mieści się w długości u16.
+    void write(std::ostream &out) const {
+        for (auto const *names : {&playerNames, &fieldNames}) {
+            for (auto const &name : *names) {
+                if (name.size() > std::numeric_limits<std::uint16_t>::max()) {
+                    throw std::invalid_argument("trace name too long");
+                }
+            }
+        }
+        out.write(magic, sizeof(magic));
+        auto putCount = [&out](size_t count) {
+            auto value = static_cast<std::uint64_t>(count);
+            out.write(reinterpret_cast<char const *>(&value), sizeof(value));
+        };
+        for (auto const *names : {&playerNames, &fieldNames}) {
+            putCount(names->size());
+            for (auto const &name : *names) {
+                auto length = static_cast<std::uint16_t>(name.size());
+                out.write(reinterpret_cast<char const *>(&length),
+                          sizeof(length));
+                out.write(name.data(), length);
+            }
+        }
+        putCount(turns());
+        putCount(games());
+        auto putColumn = [&out](auto const &column) {
+            out.write(reinterpret_cast<char const *>(column.data()),
+                      column.size() * sizeof(column[0]));
+        };
+        putColumn(round);
+        putColumn(player);
+        putColumn(field);
+        putColumn(money);
+        putColumn(wait);
+        putColumn(gameStart);
+        putColumn(winner);
+    }
+
+    // Rzuca std::runtime_error przy niepoprawnym lub uciętym pliku.
+    static LogTrace read(std::istream &in) {
+        auto check = [&in] {
+            if (!in) {
+                throw std::runtime_error("truncated trace");
+            }
+        };
+        char header[sizeof(magic)];
+        in.read(header, sizeof(header));
+        check();
+        if (std::memcmp(header, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("not a trace file");
+        }
+        auto getCount = [&] {
+            std::uint64_t value;
+            in.read(reinterpret_cast<char *>(&value), sizeof(value));
+            check();
+            if (value > std::numeric_limits<std::uint32_t>::max()) {
+                throw std::runtime_error("trace too large");
+            }
+            return static_cast<size_t>(value);
+        };
+        // Liczności z pliku sprawdzamy z resztą strumienia przed
+        // przydziałem, żeby uszkodzony plik nie wymusił ogromnych buforów.
+        // Strumień bez pozycjonowania (np. potok) czytamy porcjami.
+        auto bytesLeft = [&in]() -> std::streamoff {
+            auto position = in.tellg();
+            if (position == std::istream::pos_type(-1)) {
+                return -1;
+            }
+            in.seekg(0, std::ios::end);
+            std::streamoff left = in.tellg() - position;
+            in.seekg(position);
+            return left;
+        };
+        auto fits = [](std::streamoff left, std::uint64_t bytes) {
+            return left < 0 || bytes <= static_cast<std::uint64_t>(left);
+        };
+        LogTrace trace;
+        for (auto *names : {&trace.playerNames, &trace.fieldNames}) {
+            size_t count = getCount();
+            if (!fits(bytesLeft(), count * sizeof(std::uint16_t))) {
+                throw std::runtime_error("truncated trace");
+            }
+            for (size_t i = 0; i < count; i++) {
+                std::uint16_t length;
+                in.read(reinterpret_cast<char *>(&length), sizeof(length));
+                check();
+                auto &name = names->emplace_back(length, '\0');
+                in.read(name.data(), length);
+                check();
+            }
+        }
+        size_t turns = getCount();
+        size_t games = getCount();
+        std::streamoff left = bytesLeft();
+        constexpr std::uint64_t turnBytes =
+            sizeof(trace.round[0]) + sizeof(trace.player[0]) +
+            sizeof(trace.field[0]) + sizeof(trace.money[0]) +
+            sizeof(trace.wait[0]);
+        constexpr std::uint64_t gameBytes =
+            sizeof(trace.gameStart[0]) + sizeof(trace.winner[0]);
+        if (!fits(left, turns * turnBytes + games * gameBytes)) {
+            throw std::runtime_error("truncated trace");
+        }
+        constexpr size_t chunk = size_t(1) << 20;
+        auto getColumn = [&](auto &column, size_t size) {
+            for (size_t done = 0; done < size;) {
+                size_t part = left >= 0 ? size : std::min(chunk, size - done);
+                column.resize(done + part);
+                in.read(reinterpret_cast<char *>(column.data() + done),
+                        part * sizeof(column[0]));
+                check();
+                done += part;
+            }
+        };
+        getColumn(trace.round, turns);
+        getColumn(trace.player, turns);
+        getColumn(trace.field, turns);
+        getColumn(trace.money, turns);
+        getColumn(trace.wait, turns);
+        getColumn(trace.gameStart, games);
+        getColumn(trace.winner, games);
+        return trace;
+    }
+
+   private:
+    static constexpr char magic[4] = {'W', 'C', 'T', '1'};
+};
+
+// Parser dziennika tablicy wyników tekstowej. Tekst jest przeglądany
+// blokami po 64 bajty: dla każdego bloku powstaje maska bitowa pozycji
+// znaków '\n', '[' i ']' (SSE2, jeśli jest dostępne), a parser przechodzi
+// tylko po ustawionych bitach. Nazwy pól planszy są wyszukiwane w tablicy
+// z haszowaniem doskonałym zbudowanej dla znanego układu, nazwy graczy -
+// najpierw jako gracz, który ostatnio ruszał się po poprzednim (gracze
+// ruszają się po kolei), a liczby są czytane przez std::from_chars.
+// Pozostałe nazwy trafiają do zwykłej tablicy haszującej.
+//
+// Nazwy graczy i pól nie mogą zawierać nawiasów kwadratowych. Nowa gra
+// zaczyna się po wierszu ze zwycięzcą albo gdy numer rundy nie rośnie.
+class TextLogParser {
+   private:
+    std::vector<std::string> layoutNames;
+    std::vector<std::uint16_t> slots;
+    std::uint64_t hashSeed = 0;
+    unsigned int hashShift = 64;
+
+    static constexpr std::uint16_t emptySlot =
+        std::numeric_limits<std::uint16_t>::max();
+
+    static std::uint64_t hash(std::string_view name, std::uint64_t seed) {
+        std::uint64_t head = 0;
+        std::uint64_t tail = 0;
+        std::memcpy(&head, name.data(), std::min<size_t>(8, name.size()));
+        if (name.size() > 8) {
+            std::memcpy(&tail, name.data() + name.size() - 8, 8);
+        }
+        std::uint64_t mixed = ((head ^ seed) * 0x9e3779b97f4a7c15u) ^ tail;
+        return (mixed + name.size()) * 0xc2b2ae3d27d4eb4fu;
+    }
+
+    // Maska pozycji znaków '\n', '[' i ']' w 64 bajtach od data.
+    static std::uint64_t structural(char const *data) {
+#ifdef __SSE2__
+        __m128i const newline = _mm_set1_epi8('\n');
+        __m128i const open = _mm_set1_epi8('[');
+        __m128i const close = _mm_set1_epi8(']');
+        std::uint64_t mask = 0;
+        for (unsigned int i = 0; i < 4; i++) {
+            __m128i chunk = _mm_loadu_si128(
+                reinterpret_cast<__m128i const *>(data + 16 * i));
+            __m128i hit =
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline),
+                                          _mm_cmpeq_epi8(chunk, open)),
+                             _mm_cmpeq_epi8(chunk, close));
+            mask |= static_cast<std::uint64_t>(
+                        static_cast<std::uint16_t>(_mm_movemask_epi8(hit)))
+                    << (16 * i);
+        }
+        return mask;
+#else
+        std::uint64_t mask = 0;
+        for (unsigned int i = 0; i < 64; i++) {
+            char c = data[i];
+            mask |= static_cast<std::uint64_t>(c == '\n' || c == '[' ||
+                                               c == ']')
+                    << i;
+        }
+        return mask;
+#endif
+    }
+
+    template <typename T>
+    static bool parseNumber(std::string_view text, T &value) {
+        auto [end, error] =
+            std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    // Stan jednego przebiegu parsera.
+    class Builder {
+       private:
+        TextLogParser const &parser;
+        LogTrace trace;
+        std::unordered_map<std::string_view, std::uint16_t> players;
+        std::unordered_map<std::string_view, std::uint16_t> fields;
+        // Gracz, który ostatnio ruszał się po danym graczu.
+        std::vector<std::uint16_t> successor;
+        std::uint16_t previous = emptySlot;
+        std::uint32_t currentRound = 0;
+        bool finished = true;
+
+        static std::uint16_t add(std::vector<std::string> &names,
+                                 std::string_view name) {
+            if (names.size() >= emptySlot) {
+                throw std::runtime_error("too many distinct names");
+            }
+            names.emplace_back(name);
+            return names.size() - 1;
+        }
+
+        std::uint16_t playerId(std::string_view name) {
+            if (previous != emptySlot) {
+                std::uint16_t predicted = successor[previous];
+                if (predicted != emptySlot &&
+                    trace.playerNames[predicted] == name) {
+                    return predicted;
+                }
+            }
+            auto [it, inserted] = players.try_emplace(name, 0);
+            if (inserted) {
+                it->second = add(trace.playerNames, name);
+                successor.push_back(emptySlot);
+            }
+            return it->second;
+        }
+
+        std::uint16_t fieldId(std::string_view name) {
+            std::uint16_t id =
+                parser.slots[hash(name, parser.hashSeed) >> parser.hashShift];
+            if (id != emptySlot && trace.fieldNames[id] == name) {
+                return id;
+            }
+            auto [it, inserted] = fields.try_emplace(name, 0);
+            if (inserted) {
+                it->second = add(trace.fieldNames, name);
+            }
+            return it->second;
+        }
+
+        void startGame() {
+            trace.gameStart.push_back(trace.turns());
+            trace.winner.push_back(LogTrace::noWinner);
+            finished = false;
+        }
+
+       public:
+        Builder(TextLogParser const &parser, size_t expectedTurns)
+            : parser(parser) {
+            trace.fieldNames = parser.layoutNames;
+            trace.round.reserve(expectedTurns);
+            trace.player.reserve(expectedTurns);
+            trace.field.reserve(expectedTurns);
+            trace.money.reserve(expectedTurns);
+            trace.wait.reserve(expectedTurns);
+        }
+
+        void round(std::uint32_t number) {
+            if (finished || number <= currentRound) {
+                startGame();
+            }
+            currentRound = number;
+        }
+
+        void turn(std::string_view name, std::uint32_t wait,
+                  std::uint32_t money, std::string_view field) {
+            if (finished) {
+                startGame();
+            }
+            std::uint16_t id = playerId(name);
+            if (previous != emptySlot) {
+                successor[previous] = id;
+            }
+            previous = id;
+            trace.round.push_back(currentRound);
+            trace.player.push_back(id);
+            trace.field.push_back(fieldId(field));
+            trace.money.push_back(money);
+            trace.wait.push_back(wait);
+        }
+
+        void win(std::string_view name) {
+            if (finished) {
+                startGame();
+            }
+            trace.winner.back() = playerId(name);
+            finished = true;
+            currentRound = 0;
+        }
+
+        LogTrace take() { return std::move(trace); }
+    };
+
+    // Wiersz bez znaku końca; brackets to pozycje nawiasów w wierszu.
+    static bool parseLine(Builder &builder, std::string_view line,
+                          size_t const *brackets, unsigned int count) {
+        constexpr std::string_view roundPrefix = "=== Runda: ";
+        constexpr std::string_view winnerPrefix = "=== Zwycięzca: ";
+        constexpr std::string_view waitingPrefix = "*** czekanie: ";
+        constexpr std::string_view waitingSuffix = " ***";
+        if (line.empty()) {
+            return true;
+        }
+        if (line.starts_with(roundPrefix)) {
+            std::uint32_t number;
+            if (!parseNumber(line.substr(roundPrefix.size()), number)) {
+                return false;
+            }
+            builder.round(number);
+            return true;
+        }
+        if (line.starts_with(winnerPrefix)) {
+            builder.win(line.substr(winnerPrefix.size()));
+            return true;
+        }
+        if (count != 4 || line[brackets[0]] != '[' ||
+            line[brackets[1]] != ']' || line[brackets[2]] != '[' ||
+            line[brackets[3]] != ']' || brackets[0] == 0 ||
+            line[brackets[0] - 1] != ' ' || brackets[2] != brackets[1] + 2 ||
+            line.substr(brackets[3] + 1, 3) != " - ") {
+            return false;
+        }
+        std::string_view status =
+            line.substr(brackets[0] + 1, brackets[1] - brackets[0] - 1);
+        std::uint32_t wait = LogTrace::playing;
+        if (status == "*** bankrut ***") {
+            wait = LogTrace::bankrupt;
+        } else if (status.starts_with(waitingPrefix) &&
+                   status.ends_with(waitingSuffix)) {
+            status.remove_prefix(waitingPrefix.size());
+            status.remove_suffix(waitingSuffix.size());
+            if (!parseNumber(status, wait) || wait == 0 ||
+                wait == LogTrace::bankrupt) {
+                return false;
+            }
+        } else if (status != "w grze") {
+            return false;
+        }
+        std::uint32_t money;
+        if (!parseNumber(line.substr(brackets[2] + 1,
+                                     brackets[3] - brackets[2] - 1),
+                         money)) {
+            return false;
+        }
+        builder.turn(line.substr(0, brackets[0] - 1), wait, money,
+                     line.substr(brackets[3] + 4));
+        return true;
+    }
+
+   public:
+    // Słownik pól zaczyna się od nazw pól układu (bez powtórzeń), w tej
+    // kolejności; inne nazwy w dzienniku są dopisywane za nimi.
+    explicit TextLogParser(
+        std::vector<FieldSpec> const &layout = defaultLayout()) {
+        for (auto const &spec : layout) {
+            if (std::find(layoutNames.begin(), layoutNames.end(),
+                          spec.name) == layoutNames.end()) {
+                layoutNames.push_back(spec.name);
+            }
+        }
+        if (layoutNames.size() >= emptySlot) {
+            throw std::invalid_argument("too many fields");
+        }
+        // Szukamy ziarna, dla którego nazwy trafiają do różnych miejsc;
+        // co 64 nieudane próby tablica rośnie dwukrotnie.
+        unsigned int bits = std::bit_width(2 * layoutNames.size());
+        for (std::uint64_t seed = 1;; seed++) {
+            if (seed % 64 == 0) {
+                bits++;
+            }
+            slots.assign(size_t(1) << bits, emptySlot);
+            bool perfect = true;
+            for (size_t id = 0; id < layoutNames.size() && perfect; id++) {
+                auto &slot = slots[hash(layoutNames[id], seed) >> (64 - bits)];
+                perfect = slot == emptySlot;
+                slot = id;
+            }
+            if (perfect) {
+                hashSeed = seed;
+                hashShift = 64 - bits;
+                return;
+            }
+        }
+    }
+
+    // Rzuca std::runtime_error z numerem wiersza przy niepoprawnym wierszu.
+    LogTrace parse(std::string_view text) const {
+        // Wiersz tury ma zwykle ponad 40 bajtów.
+        Builder builder(*this, text.size() / 40);
+        size_t lineStart = 0;
+        size_t lineNumber = 1;
+        size_t brackets[4];
+        unsigned int count = 0;
+        auto line = [&](size_t end) {
+            if (!parseLine(builder, text.substr(lineStart, end - lineStart),
+                           brackets, count)) {
+                throw std::runtime_error("malformed log line " +
+                                         std::to_string(lineNumber));
+            }
+            lineStart = end + 1;
+            lineNumber++;
+            count = 0;
+        };
+        for (size_t block = 0; block < text.size(); block += 64) {
+            std::uint64_t mask;
+            if (text.size() - block >= 64) {
+                mask = structural(text.data() + block);
+            } else {
+                char tail[64] = {};
+                std::memcpy(tail, text.data() + block, text.size() - block);
+                mask = structural(tail);
+            }
+            for (; mask != 0; mask &= mask - 1) {
+                size_t position = block + std::countr_zero(mask);
+                if (text[position] == '\n') {
+                    line(position);
+                } else if (count++ < 4) {
+                    brackets[count - 1] = position - lineStart;
+                }
+            }
+        }
+        if (lineStart < text.size()) {
+            line(text.size());
+        }
+        return builder.take();
+    }
+};
+
+// Zamienia dzienniki tekstowe na pliki śladów (ta sama nazwa z dopisanym
+// ".trace") na threads wątkach. Zwraca łączny rozmiar przetworzonych
+// dzienników; rzuca std::runtime_error z nazwą pliku przy pierwszym błędzie.
+inline std::uint64_t convertLogs(std::vector<std::filesystem::path> const &logs,
+                                 TextLogParser const &parser,
+                                 unsigned int threads) {
+    std::vector<std::string> errors(logs.size());
+    std::vector<std::uint64_t> sizes(logs.size(), 0);
+    parallelForSeeds(0, logs.size(), threads,
+                     [&](unsigned int, std::uint64_t index) {
+                         auto const &path = logs[index];
+                         try {
+                             std::ifstream in(path, std::ios::binary);
+                             std::string text(
+                                 std::filesystem::file_size(path), '\0');
+                             if (!in.read(text.data(), text.size())) {
+                                 throw std::runtime_error("cannot read");
+                             }
+                             LogTrace trace = parser.parse(text);
+                             std::filesystem::path output = path;
+                             output += ".trace";
+                             std::ofstream out(output, std::ios::binary);
+                             trace.write(out);
+                             if (!out.flush()) {
+                                 throw std::runtime_error("cannot write");
+                             }
+                             sizes[index] = text.size();
+                         } catch (std::exception const &e) {
+                             errors[index] = e.what();
+                         }
+                     });
+    for (size_t i = 0; i < logs.size(); i++) {
+        if (!errors[i].empty()) {
+            throw std::runtime_error(logs[i].string() + ": " + errors[i]);
+        }
+    }
+    std::uint64_t total = 0;
+    for (auto size : sizes) {
+        total += size;
+    }
+    return total;
+}
+
+#endif
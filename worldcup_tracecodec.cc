@@ -0,0 +1,70 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worldcup_codec.h"
+
+// Narzędzie: worldcup_tracecodec compress ślad wynik [liczba wątków]
+//            worldcup_tracecodec decode skompresowany [liczba wątków]
+// Kompresuje ślad tur zapisany przez TraceSink (np. worldcup_tracewrite)
+// albo dekoduje wszystkie bloki skompresowanego śladu, wypisując stopień
+// kompresji i przepustowość.
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0]
+                  << " compress trace output [threads]\n"
+                  << "       " << argv[0] << " decode compressed [threads]\n";
+        return 1;
+    }
+    std::string const mode = argv[1];
+    try {
+        auto start = std::chrono::steady_clock::now();
+        if (mode == "compress" && argc > 3) {
+            unsigned int threads = argc > 4
+                                       ? std::stoul(argv[4])
+                                       : std::thread::hardware_concurrency();
+            std::uint64_t size = compressTrace(argv[2], argv[3], threads);
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::uint64_t original = std::filesystem::file_size(argv[2]);
+            std::cout << original << " -> " << size << " bytes (ratio "
+                      << static_cast<double>(original) / size << ") in "
+                      << elapsed.count() << " s ("
+                      << original / 1e9 / elapsed.count() << " GB/s)\n";
+        } else if (mode == "decode") {
+            unsigned int threads = argc > 3
+                                       ? std::stoul(argv[3])
+                                       : std::thread::hardware_concurrency();
+            CompressedTrace trace(argv[2]);
+            std::vector<std::string> blocks;
+            for (size_t block = 0; block < trace.blocks(); block++) {
+                blocks.push_back(trace.readEncoded(block));
+            }
+            start = std::chrono::steady_clock::now();
+            std::atomic<std::uint64_t> records(0);
+            std::vector<std::vector<TurnRecord>> decoded(std::max(1u, threads));
+            parallelForSeeds(0, blocks.size(), threads,
+                             [&](unsigned int id, std::uint64_t block) {
+                                 codec::decodeBlock(blocks[block], decoded[id]);
+                                 records += decoded[id].size();
+                             });
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            double bytes = static_cast<double>(records) * sizeof(TurnRecord);
+            std::cout << records << " records decoded in " << elapsed.count()
+                      << " s (" << bytes / 1e9 / elapsed.count()
+                      << " GB/s)\n";
+        } else {
+            std::cerr << "unknown mode " << mode << '\n';
+            return 1;
+        }
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
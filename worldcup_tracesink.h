@@ -0,0 +1,729 @@
+#ifndef WORLDCUP_TRACESINK_H
+#define WORLDCUP_TRACESINK_H
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "worldcup_simulation.h"
+
+// Asynchroniczny zapis śladów binarnych z wielu wątków symulacji.
+//
+// Każdy wątek pisze przez własnego TraceSink::Writer do prywatnego bloku
+// (domyślnie 1 MiB, wyrównanego do 4 KiB). Pełny blok trafia do kolejki,
+// a wątek bierze wolny blok z puli - bez wywołań systemowych. Osobny wątek
+// zapisujący nadaje blokom kolejne przesunięcia w pliku i zapisuje je przez
+// io_uring (bezpośrednie wywołania systemowe, bez liburing), a gdy jądro
+// lub piaskownica go nie udostępnia - przez pwritev() kilku sąsiednich
+// bloków naraz. Wątek gry czeka tylko wtedy, gdy cała pula bloków czeka
+// na dysk.
+//
+// Plik jest ciągiem bloków o stałym rozmiarze. Blok zaczyna się nagłówkiem
+// TraceBlockHeader, po którym są rekordy jednego wątku (rekord nigdy nie
+// przechodzi przez granicę bloku); reszta bloku jest wyzerowana. Bloki
+// różnych wątków przeplatają się w kolejności zapełniania.
+struct TraceBlockHeader {
+    char magic[4];
+    std::uint32_t blockSize;
+    std::uint32_t writer;
+    // Bajty rekordów za nagłówkiem.
+    std::uint32_t used;
+};
+
+namespace tracesink_detail {
+    inline constexpr size_t pageSize = 4096;
+
+    // Zapisuje całe data od offset (dopisuje resztę po krótkim zapisie).
+    inline int writeFully(int fd, char const *data, size_t size,
+                          std::uint64_t offset) {
+        while (size > 0) {
+            ssize_t n = ::pwrite(fd, data, size, offset);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return n < 0 ? errno : EIO;
+            }
+            data += n;
+            size -= n;
+            offset += n;
+        }
+        return 0;
+    }
+
+    // Minimalna obsługa io_uring: kolejka zgłoszeń zapisów (IORING_OP_WRITEV)
+    // i odbiór zakończeń. Używana tylko przez wątek zapisujący.
+    class Ring {
+       private:
+        int fd = -1;
+        void *sqRing = MAP_FAILED;
+        void *cqRing = MAP_FAILED;
+        size_t sqRingSize = 0;
+        size_t cqRingSize = 0;
+        io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+        size_t sqesSize = 0;
+        unsigned *sqTail = nullptr;
+        unsigned sqMask = 0;
+        unsigned *sqArray = nullptr;
+        unsigned *cqHead = nullptr;
+        unsigned *cqTail = nullptr;
+        unsigned cqMask = 0;
+        io_uring_cqe *cqes = nullptr;
+        unsigned entries = 0;
+        unsigned prepared = 0;
+
+        Ring() = default;
+
+        template <class T>
+        static T *at(void *ring, unsigned offset) {
+            return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+        }
+
+       public:
+        // Pusty wskaźnik, jeśli io_uring jest niedostępny.
+        static std::unique_ptr<Ring> open(unsigned depth) {
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+            std::unique_ptr<Ring> ring(new Ring());
+            io_uring_params params{};
+            ring->fd = static_cast<int>(
+                ::syscall(__NR_io_uring_setup, depth, &params));
+            if (ring->fd < 0) {
+                return nullptr;
+            }
+            ring->entries = params.sq_entries;
+            ring->sqRingSize =
+                params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            ring->cqRingSize =
+                params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single) {
+                ring->sqRingSize = ring->cqRingSize =
+                    std::max(ring->sqRingSize, ring->cqRingSize);
+            }
+            ring->sqRing = ::mmap(nullptr, ring->sqRingSize,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ring->fd,
+                                  IORING_OFF_SQ_RING);
+            if (ring->sqRing == MAP_FAILED) {
+                return nullptr;
+            }
+            ring->cqRing =
+                single ? ring->sqRing
+                       : ::mmap(nullptr, ring->cqRingSize,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring->fd,
+                                IORING_OFF_CQ_RING);
+            if (ring->cqRing == MAP_FAILED) {
+                return nullptr;
+            }
+            ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void *sqes = ::mmap(nullptr, ring->sqesSize,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring->fd,
+                                IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) {
+                return nullptr;
+            }
+            ring->sqes = static_cast<io_uring_sqe *>(sqes);
+            ring->sqTail = at<unsigned>(ring->sqRing, params.sq_off.tail);
+            ring->sqMask = *at<unsigned>(ring->sqRing, params.sq_off.ring_mask);
+            ring->sqArray = at<unsigned>(ring->sqRing, params.sq_off.array);
+            ring->cqHead = at<unsigned>(ring->cqRing, params.cq_off.head);
+            ring->cqTail = at<unsigned>(ring->cqRing, params.cq_off.tail);
+            ring->cqMask = *at<unsigned>(ring->cqRing, params.cq_off.ring_mask);
+            ring->cqes = at<io_uring_cqe>(ring->cqRing, params.cq_off.cqes);
+            return ring;
+#else
+            (void)depth;
+            return nullptr;
+#endif
+        }
+
+        Ring(Ring const &) = delete;
+        Ring &operator=(Ring const &) = delete;
+
+        ~Ring() {
+            if (sqes != MAP_FAILED) {
+                ::munmap(sqes, sqesSize);
+            }
+            if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                ::munmap(cqRing, cqRingSize);
+            }
+            if (sqRing != MAP_FAILED) {
+                ::munmap(sqRing, sqRingSize);
+            }
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        // Liczba zapisów, które mogą być jednocześnie w toku.
+        unsigned capacity() const { return entries; }
+
+        // Dodaje do kolejki zapis io pod offset; zakończenie przyjdzie
+        // z podanym znacznikiem.
+        void prepareWrite(int file, iovec const *io, std::uint64_t offset,
+                          std::uint64_t tag) {
+            unsigned tail = *sqTail;
+            unsigned index = tail & sqMask;
+            io_uring_sqe &sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_WRITEV;
+            sqe.fd = file;
+            sqe.addr = reinterpret_cast<std::uint64_t>(io);
+            sqe.len = 1;
+            sqe.off = offset;
+            sqe.user_data = tag;
+            sqArray[index] = index;
+            std::atomic_ref<unsigned>(*sqTail).store(
+                tail + 1, std::memory_order_release);
+            prepared++;
+        }
+
+        // Zgłasza przygotowane zapisy i czeka na co najmniej wait
+        // zakończeń. Zwraca 0 albo kod błędu.
+        int enter(unsigned wait) {
+#ifdef __NR_io_uring_enter
+            for (;;) {
+                long n = ::syscall(__NR_io_uring_enter, fd, prepared, wait,
+                                   wait > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                   nullptr, 0);
+                if (n >= 0) {
+                    prepared -= std::min<unsigned>(prepared, n);
+                    if (prepared == 0) {
+                        return 0;
+                    }
+                } else if (errno != EINTR && errno != EAGAIN &&
+                           errno != EBUSY) {
+                    return errno;
+                }
+            }
+#else
+            (void)wait;
+            return ENOSYS;
+#endif
+        }
+
+        // Wywołuje done(znacznik, wynik) dla każdego gotowego zakończenia.
+        template <class Done>
+        void reap(Done &&done) {
+            unsigned head = *cqHead;
+            unsigned tail = std::atomic_ref<unsigned>(*cqTail).load(
+                std::memory_order_acquire);
+            while (head != tail) {
+                io_uring_cqe const &cqe = cqes[head & cqMask];
+                done(cqe.user_data, cqe.res);
+                head++;
+            }
+            std::atomic_ref<unsigned>(*cqHead).store(head,
+                                                     std::memory_order_release);
+        }
+    };
+}  // namespace tracesink_detail
+
+class TraceSink {
+   public:
+    struct Options {
+        // Rozmiar bloku (wielokrotność 4 KiB).
+        size_t blockSize = size_t(1) << 20;
+        // Bloki w puli poza tymi, które trzymają wątki.
+        unsigned int poolBlocks = 64;
+        // Zapisy jednocześnie w toku (io_uring).
+        unsigned int queueDepth = 16;
+        bool useIoUring = true;
+        // O_DIRECT (z pominięciem pamięci podręcznej stron), jeśli system
+        // plików go obsługuje.
+        bool direct = false;
+    };
+
+    struct Statistics {
+        std::uint64_t blocks = 0;
+        std::uint64_t bytes = 0;
+        // Ile razy wątek gry czekał na wolny blok.
+        std::uint64_t stalls = 0;
+    };
+
+   private:
+    struct Block {
+        char *data;
+        std::uint64_t offset;
+        iovec io;
+    };
+
+    Options const options;
+    int fd;
+    std::unique_ptr<tracesink_detail::Ring> ring;
+
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable released;
+    std::vector<std::unique_ptr<Block, void (*)(Block *)>> blocks;
+    std::vector<Block *> freeBlocks;
+    std::vector<Block *> queue;
+    // Piszący: liczba istniejących i kolejny identyfikator.
+    unsigned int writers = 0;
+    // Piszący z niepustym blokiem.
+    unsigned int dirtyWriters = 0;
+    std::uint32_t nextWriter = 0;
+    bool closing = false;
+    std::uint64_t stalls = 0;
+
+    // Stan wątku zapisującego.
+    std::thread thread;
+    std::uint64_t nextOffset = 0;
+    unsigned int inFlight = 0;
+    std::atomic<int> error{0};
+    std::atomic<std::uint64_t> blocksWritten{0};
+
+    static void freeBlock(Block *block) {
+        ::operator delete(block->data,
+                          std::align_val_t(tracesink_detail::pageSize));
+        delete block;
+    }
+
+    static TraceBlockHeader &header(Block *block) {
+        return *reinterpret_cast<TraceBlockHeader *>(block->data);
+    }
+
+    // Wolny blok (wywoływane pod blokadą).
+    Block *acquire(std::unique_lock<std::mutex> &lock) {
+        if (freeBlocks.empty() &&
+            blocks.size() >= options.poolBlocks + writers) {
+            stalls++;
+            released.wait(lock, [this] { return !freeBlocks.empty(); });
+        }
+        if (!freeBlocks.empty()) {
+            Block *block = freeBlocks.back();
+            freeBlocks.pop_back();
+            return block;
+        }
+        auto *data = static_cast<char *>(::operator new(
+            options.blockSize, std::align_val_t(tracesink_detail::pageSize)));
+        blocks.emplace_back(new Block{data, 0, {}}, freeBlock);
+        return blocks.back().get();
+    }
+
+    // Piszący zaczyna zapełniać blok (raz na blok, więc blokada nie
+    // kosztuje wiele).
+    void beginBlock() {
+        std::lock_guard lock(mutex);
+        if (closing) {
+            throw std::logic_error("trace sink closed");
+        }
+        dirtyWriters++;
+    }
+
+    // Przekazuje blok do zapisu i zwraca nowy.
+    Block *exchange(Block *full, std::uint32_t writer, std::uint32_t used) {
+        TraceBlockHeader &head = header(full);
+        std::memcpy(head.magic, "WCB1", 4);
+        head.blockSize = static_cast<std::uint32_t>(options.blockSize);
+        head.writer = writer;
+        head.used = used;
+        size_t end = sizeof(TraceBlockHeader) + used;
+        std::memset(full->data + end, 0, options.blockSize - end);
+        std::unique_lock lock(mutex);
+        dirtyWriters--;
+        queue.push_back(full);
+        queued.notify_one();
+        return acquire(lock);
+    }
+
+    void recycle(Block *block) {
+        blocksWritten.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard lock(mutex);
+        freeBlocks.push_back(block);
+        released.notify_one();
+    }
+
+    void fail(int code) {
+        int expected = 0;
+        error.compare_exchange_strong(expected, code);
+    }
+
+    // Zapis pwritev(): sąsiednie bloki (kolejne przesunięcia) idą jednym
+    // wywołaniem, po kilkadziesiąt naraz.
+    void writeVectored(std::vector<Block *> const &batch) {
+        constexpr size_t maxVectors = 64;
+        for (size_t first = 0; first < batch.size(); first += maxVectors) {
+            size_t count = std::min(maxVectors, batch.size() - first);
+            iovec io[maxVectors];
+            for (size_t i = 0; i < count; i++) {
+                io[i] = {batch[first + i]->data, options.blockSize};
+            }
+            std::uint64_t offset = batch[first]->offset;
+            ssize_t n;
+            do {
+                n = error.load() == 0 ? ::pwritev(fd, io, count, offset)
+                                      : -1;
+            } while (n < 0 && errno == EINTR && error.load() == 0);
+            if (n < 0 && error.load() == 0) {
+                fail(errno);
+            }
+            size_t written = n < 0 ? 0 : n;
+            for (size_t i = 0; i < count; i++) {
+                Block *block = batch[first + i];
+                size_t done = std::min(written, options.blockSize);
+                written -= done;
+                if (done < options.blockSize && error.load() == 0) {
+                    int code = tracesink_detail::writeFully(
+                        fd, block->data + done, options.blockSize - done,
+                        block->offset + done);
+                    if (code != 0) {
+                        fail(code);
+                    }
+                }
+                recycle(block);
+            }
+        }
+    }
+
+    void completed(std::uint64_t tag, int result) {
+        inFlight--;
+        auto *block = reinterpret_cast<Block *>(tag);
+        if (result < 0) {
+            fail(-result);
+        } else if (static_cast<size_t>(result) < options.blockSize &&
+                   error.load() == 0) {
+            int code = tracesink_detail::writeFully(
+                fd, block->data + result, options.blockSize - result,
+                block->offset + result);
+            if (code != 0) {
+                fail(code);
+            }
+        }
+        recycle(block);
+    }
+
+    void wait(unsigned int completions) {
+        int code = ring->enter(completions);
+        if (code != 0) {
+            fail(code);
+        }
+        ring->reap([this](std::uint64_t tag, int result) {
+            completed(tag, result);
+        });
+    }
+
+    // Zapis io_uring: zgłoszenia całej porcji jednym io_uring_enter();
+    // odbiór zakończeń bez czekania, póki są miejsca w kolejce.
+    void writeAsync(std::vector<Block *> const &batch) {
+        for (Block *block : batch) {
+            if (error.load() != 0) {
+                recycle(block);
+                continue;
+            }
+            while (inFlight == ring->capacity()) {
+                wait(1);
+            }
+            block->io = {block->data, options.blockSize};
+            ring->prepareWrite(fd, &block->io, block->offset,
+                               reinterpret_cast<std::uint64_t>(block));
+            inFlight++;
+        }
+        wait(0);
+    }
+
+    void run() {
+        std::vector<Block *> batch;
+        for (;;) {
+            bool last;
+            {
+                std::unique_lock lock(mutex);
+                if (inFlight == 0) {
+                    queued.wait(lock,
+                                [this] { return !queue.empty() || closing; });
+                }
+                batch.swap(queue);
+                last = closing && batch.empty();
+            }
+            if (batch.empty()) {
+                if (last && inFlight == 0) {
+                    return;
+                }
+                // Nic nowego - czekamy na zakończenie któregoś zapisu.
+                wait(1);
+                continue;
+            }
+            for (Block *block : batch) {
+                block->offset = nextOffset;
+                nextOffset += options.blockSize;
+            }
+            if (ring) {
+                writeAsync(batch);
+            } else {
+                writeVectored(batch);
+            }
+            batch.clear();
+        }
+    }
+
+   public:
+    // Blok wątku gry. Rekord musi się zmieścić w bloku.
+    class Writer {
+       private:
+        TraceSink *sink;
+        Block *block;
+        std::uint32_t id;
+        std::uint32_t used;
+        std::uint32_t capacity;
+
+       public:
+        Writer(TraceSink &sink, std::uint32_t id)
+            : sink(&sink),
+              block(nullptr),
+              id(id),
+              used(0),
+              capacity(sink.options.blockSize - sizeof(TraceBlockHeader)) {
+            std::unique_lock lock(sink.mutex);
+            block = sink.acquire(lock);
+        }
+
+        Writer(Writer &&other) noexcept
+            : sink(other.sink),
+              block(std::exchange(other.block, nullptr)),
+              id(other.id),
+              used(other.used),
+              capacity(other.capacity) {}
+
+        Writer(Writer const &) = delete;
+        Writer &operator=(Writer const &) = delete;
+        Writer &operator=(Writer &&) = delete;
+
+        ~Writer() {
+            if (block != nullptr) {
+                flush();
+                std::lock_guard lock(sink->mutex);
+                sink->freeBlocks.push_back(block);
+                sink->writers--;
+                sink->released.notify_one();
+            }
+        }
+
+        // Rzuca std::logic_error po close() ujścia.
+        void append(void const *data, size_t size) {
+            if (used + size > capacity) {
+                if (size > capacity) {
+                    throw std::length_error("trace record exceeds block");
+                }
+                flush();
+            }
+            if (used == 0) {
+                sink->beginBlock();
+            }
+            std::memcpy(block->data + sizeof(TraceBlockHeader) + used, data,
+                        size);
+            used += size;
+        }
+
+        template <class Record>
+        void append(Record const &record) {
+            static_assert(std::is_trivially_copyable_v<Record>);
+            append(&record, sizeof(record));
+        }
+
+        // Przekazuje do zapisu niepełny blok.
+        void flush() {
+            if (used > 0) {
+                block = sink->exchange(block, id, used);
+                used = 0;
+            }
+        }
+    };
+
+    explicit TraceSink(std::filesystem::path const &path)
+        : TraceSink(path, Options()) {}
+
+    // Rzuca std::system_error, gdy nie da się otworzyć pliku.
+    TraceSink(std::filesystem::path const &path, Options options)
+        : options(options), fd(-1) {
+        if (options.blockSize % tracesink_detail::pageSize != 0 ||
+            options.blockSize <= sizeof(TraceBlockHeader)) {
+            throw std::invalid_argument("trace block size");
+        }
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+        if (options.direct) {
+            fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        }
+#endif
+        if (fd < 0) {
+            fd = ::open(path.c_str(), flags, 0644);
+        }
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "trace open");
+        }
+        if (options.useIoUring) {
+            ring = tracesink_detail::Ring::open(options.queueDepth);
+        }
+        thread = std::thread([this] { run(); });
+    }
+
+    TraceSink(TraceSink const &) = delete;
+    TraceSink &operator=(TraceSink const &) = delete;
+
+    // Zniszczenie ujścia, gdy piszący mają nieprzekazane rekordy, kończy
+    // program (std::logic_error z close() opuszcza destruktor).
+    ~TraceSink() {
+        try {
+            close();
+        } catch (std::system_error const &) {
+        }
+    }
+
+    // Czy bloki są zapisywane przez io_uring (a nie pwritev()).
+    bool usesIoUring() const { return ring != nullptr; }
+
+    // Nowy wątek piszący; jego identyfikator trafia do nagłówków bloków.
+    // Rzuca std::logic_error po close().
+    Writer writer() {
+        std::uint32_t id;
+        {
+            std::lock_guard lock(mutex);
+            if (closing) {
+                throw std::logic_error("trace sink closed");
+            }
+            writers++;
+            id = nextWriter++;
+        }
+        return Writer(*this, id);
+    }
+
+    // Czeka na zapis wszystkich przekazanych bloków i zamyka plik. Piszący
+    // muszą wcześniej przekazać swoje rekordy (flush() lub zniszczenie) -
+    // inaczej rzuca std::logic_error i nic nie zamyka, bo te rekordy
+    // zostałyby po cichu zgubione. Piszący mogą żyć dłużej niż close(),
+    // ale nie mogą już nic dopisać. Rzuca std::system_error z pierwszym
+    // błędem zapisu.
+    void close() {
+        if (fd < 0) {
+            return;
+        }
+        {
+            std::lock_guard lock(mutex);
+            if (dirtyWriters > 0) {
+                throw std::logic_error("trace writers hold unflushed records");
+            }
+            closing = true;
+            queued.notify_one();
+        }
+        thread.join();
+        ::close(fd);
+        fd = -1;
+        if (int code = error.load()) {
+            throw std::system_error(code, std::generic_category(),
+                                    "trace write");
+        }
+    }
+
+    Statistics statistics() {
+        std::lock_guard lock(mutex);
+        std::uint64_t written = blocksWritten.load();
+        return {written, written * options.blockSize, stalls};
+    }
+};
+
+// Czyta plik zapisany przez TraceSink: wywołuje visit(piszący, rekordy)
+// dla każdego bloku. Rozmiar bloku wyznacza pierwszy nagłówek i wszystkie
+// bloki muszą go mieć, a blok musi się mieścić w pliku, zanim zostanie
+// wczytany (uszkodzony nagłówek nie wymusza ogromnej alokacji). Rzuca
+// std::runtime_error przy uszkodzonym pliku.
+inline void readTraceBlocks(
+    std::filesystem::path const &path,
+    std::function<void(std::uint32_t, std::string_view)> const &visit) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open trace " + path.string());
+    }
+    std::uint64_t fileSize = std::filesystem::file_size(path);
+    std::uint64_t offset = 0;
+    std::uint32_t blockSize = 0;
+    std::vector<char> payload;
+    TraceBlockHeader header;
+    while (in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        if (blockSize == 0) {
+            blockSize = header.blockSize;
+        }
+        if (std::memcmp(header.magic, "WCB1", 4) != 0 ||
+            header.blockSize != blockSize ||
+            header.blockSize <= sizeof(header) ||
+            header.used > header.blockSize - sizeof(header)) {
+            throw std::runtime_error("not a trace block");
+        }
+        if (blockSize > fileSize - offset) {
+            throw std::runtime_error("truncated trace block");
+        }
+        offset += blockSize;
+        payload.resize(header.used);
+        in.read(payload.data(), header.used);
+        in.ignore(header.blockSize - sizeof(header) - header.used);
+        if (!in) {
+            throw std::runtime_error("truncated trace block");
+        }
+        visit(header.writer, {payload.data(), payload.size()});
+    }
+}
+
+// Rekord śladu tury (20 bajtów, bez wypełnienia). Numer pola ma 32 bity,
+// bo plansze HugeBoard mają miliony pól.
+struct TurnRecord {
+    std::uint32_t game;
+    std::uint32_t turn;
+    std::uint32_t money;
+    std::uint32_t field;
+    std::uint32_t roll;
+};
+
+static_assert(sizeof(TurnRecord) == 20);
+
+// Obserwator tur zapisujący stan gracza po każdej turze do śladu. Jeden na
+// wątek gry; numer gry ustawia beginGame().
+class TurnTraceRecorder : public TurnObserver {
+   private:
+    TraceSink::Writer writer;
+    std::uint32_t game;
+    std::uint32_t turn;
+
+   public:
+    explicit TurnTraceRecorder(TraceSink &sink)
+        : writer(sink.writer()), game(0), turn(0) {}
+
+    void beginGame(std::uint32_t number) {
+        game = number;
+        turn = 0;
+    }
+
+    void onTurnEnd(Player const &player, unsigned int roll) override {
+        writer.append(TurnRecord{game, turn++, player.getMoney(),
+                                 player.getField(), roll});
+    }
+
+    void flush() { writer.flush(); }
+};
+
+#endif
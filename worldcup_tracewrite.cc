@@ -0,0 +1,58 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worldcup_tracesink.h"
+
+// Narzędzie: worldcup_tracewrite plik [liczba gier] [liczba wątków]
+//            [io_uring|pwritev]
+// Rozgrywa gry (4 graczy, 100 rund, plansza domyślna) na podanej liczbie
+// wątków, zapisując stan gracza po każdej turze do śladu TraceSink,
+// i wypisuje przepustowość zapisu.
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " trace [games] [threads] [io_uring|pwritev]\n";
+        return 1;
+    }
+    std::uint64_t games = argc > 2 ? std::stoull(argv[2]) : 1000000;
+    unsigned int threads =
+        argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    threads = std::max(1u, threads);
+    TraceSink::Options options;
+    options.useIoUring = argc <= 4 || std::string(argv[4]) != "pwritev";
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        TraceSink sink(argv[1], options);
+        std::vector<TurnTraceRecorder> recorders;
+        recorders.reserve(threads);
+        for (unsigned int id = 0; id < threads; id++) {
+            recorders.emplace_back(sink);
+        }
+        auto const layout = defaultLayout();
+        parallelForSeeds(0, games, threads,
+                         [&](unsigned int id, std::uint64_t seed) {
+                             recorders[id].beginGame(seed);
+                             simulateGame(layout, 4, 100, seed, nullptr,
+                                          &recorders[id]);
+                         });
+        for (auto &recorder : recorders) {
+            recorder.flush();
+        }
+        sink.close();
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        TraceSink::Statistics statistics = sink.statistics();
+        std::cout << (sink.usesIoUring() ? "io_uring" : "pwritev") << ": "
+                  << statistics.bytes / 1e6 << " MB in " << elapsed.count()
+                  << " s (" << statistics.bytes / 1e9 / elapsed.count()
+                  << " GB/s), " << statistics.stalls << " stalls\n";
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}